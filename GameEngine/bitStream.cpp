@@ -0,0 +1,486 @@
+#include "bitStream.h"
+
+//=============================================================================
+// Return the number of bits needed for values min to max
+//=============================================================================
+int bitsRequired(Sint32 min, Sint32 max)
+{
+    Uint32 range = (Uint32)max - (Uint32)min;
+    int bits = 0;
+
+    while (range != 0)
+    {
+        bits++;
+        range >>= 1;
+    }
+
+    return bits;
+}
+
+static Uint32 quantise(float value, float min, float max, int bits)
+{
+    const Uint32 steps = (bits >= 32) ? 0xFFFFFFFF : ((1u << bits) - 1);
+    const double t = (SDL_clamp(value, min, max) - min) / (double)(max - min);
+
+    return (Uint32)(t * steps + 0.5);
+}
+
+static float dequantise(Uint32 value, float min, float max, int bits)
+{
+    const Uint32 steps = (bits >= 32) ? 0xFFFFFFFF : ((1u << bits) - 1);
+
+    return (float)(min + (max - min) * ((double)value / steps));
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+BitWriter::BitWriter(void* data, int size)
+{
+    this->data = (Uint8*)data;
+    this->size = (data != NULL && size > 0) ? size : 0;
+    bytes = 0;
+    scratch = 0;
+    scratchBits = 0;
+    overflow = false;
+}
+
+//=============================================================================
+// Write the low bits of value
+//=============================================================================
+void BitWriter::writeBits(Uint32 value, int bits)
+{
+    if (overflow || bits <= 0 || bits > 32 ||
+        getBitsWritten() + bits > size * 8)
+    {
+        overflow = true;
+        return;
+    }
+
+    const Uint64 mask = ((Uint64)1 << bits) - 1;
+
+    scratch |= ((Uint64)value & mask) << scratchBits;
+    scratchBits += bits;
+
+    while (scratchBits >= 8)
+    {
+        data[bytes++] = (Uint8)scratch;
+        scratch >>= 8;
+        scratchBits -= 8;
+    }
+}
+
+//=============================================================================
+// Write a bool in one bit
+//=============================================================================
+void BitWriter::writeBool(bool value)
+{
+    writeBits(value ? 1 : 0, 1);
+}
+
+//=============================================================================
+// Write an int in the bits needed for min to max
+//=============================================================================
+void BitWriter::writeInt(Sint32 value, Sint32 min, Sint32 max)
+{
+    const int bits = bitsRequired(min, max);
+
+    if (bits > 0)
+    {
+        value = SDL_clamp(value, min, max);
+        writeBits((Uint32)value - (Uint32)min, bits);
+    }
+}
+
+//=============================================================================
+// Write a float quantised to bits over min to max
+//=============================================================================
+void BitWriter::writeFloat(float value, float min, float max, int bits)
+{
+    writeBits(quantise(value, min, max, bits), bits);
+}
+
+//=============================================================================
+// Write 7 bits per byte, the top bit says more follow
+//=============================================================================
+void BitWriter::writeVarint(Uint32 value)
+{
+    while (value >= 0x80)
+    {
+        writeBits((value & 0x7F) | 0x80, 8);
+        value >>= 7;
+    }
+
+    writeBits(value, 8);
+}
+
+//=============================================================================
+// Zigzag encode: 0, -1, 1, -2 ... become 0, 1, 2, 3 ...
+//=============================================================================
+void BitWriter::writeSignedVarint(Sint32 value)
+{
+    writeVarint(((Uint32)value << 1) ^ (Uint32)(value >> 31));
+}
+
+//=============================================================================
+// Write up to maxLength characters of str with its length
+//=============================================================================
+void BitWriter::writeString(const char* str, int maxLength)
+{
+    int length = 0;
+
+    while (str != NULL && length < maxLength && str[length] != '\0')
+    {
+        length++;
+    }
+
+    writeInt(length, 0, maxLength);
+    writeBytes(str, length);
+}
+
+//=============================================================================
+// Write count bytes, 8 bits each
+//=============================================================================
+void BitWriter::writeBytes(const void* bytes, int count)
+{
+    const Uint8* p = (const Uint8*)bytes;
+
+    for (int i = 0; i < count; i++)
+    {
+        writeBits(p[i], 8);
+    }
+}
+
+//=============================================================================
+// Write the last partial byte
+//=============================================================================
+int BitWriter::flush()
+{
+    if (overflow)
+    {
+        return -1;
+    }
+
+    if (scratchBits > 0)
+    {
+        data[bytes++] = (Uint8)scratch;
+        scratch = 0;
+        scratchBits = 0;
+    }
+
+    return bytes;
+}
+
+//=============================================================================
+// Return the number of bits written
+//=============================================================================
+int BitWriter::getBitsWritten() const
+{
+    return bytes * 8 + scratchBits;
+}
+
+//=============================================================================
+// Return true if a write didn't fit
+//=============================================================================
+bool BitWriter::getOverflow() const
+{
+    return overflow;
+}
+
+//=============================================================================
+// Message schema calls, write the value
+//=============================================================================
+bool BitWriter::serializeBits(Uint32& value, int bits)
+{
+    writeBits(value, bits);
+    return !overflow;
+}
+
+bool BitWriter::serializeBool(bool& value)
+{
+    writeBool(value);
+    return !overflow;
+}
+
+bool BitWriter::serializeInt(Sint32& value, Sint32 min, Sint32 max)
+{
+    writeInt(value, min, max);
+    return !overflow;
+}
+
+bool BitWriter::serializeFloat(float& value, float min, float max, int bits)
+{
+    writeFloat(value, min, max, bits);
+    return !overflow;
+}
+
+bool BitWriter::serializeVarint(Uint32& value)
+{
+    writeVarint(value);
+    return !overflow;
+}
+
+bool BitWriter::serializeSignedVarint(Sint32& value)
+{
+    writeSignedVarint(value);
+    return !overflow;
+}
+
+bool BitWriter::serializeString(char* str, int maxLength)
+{
+    writeString(str, maxLength);
+    return !overflow;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+BitReader::BitReader(const void* data, int size)
+{
+    this->data = (const Uint8*)data;
+    this->size = (data != NULL && size > 0) ? size : 0;
+    bytes = 0;
+    scratch = 0;
+    scratchBits = 0;
+    error = false;
+}
+
+//=============================================================================
+// Read bits, 1 to 32
+//=============================================================================
+bool BitReader::readBits(Uint32& value, int bits)
+{
+    value = 0;
+
+    if (error || bits <= 0 || bits > 32 || getBitsRemaining() < bits)
+    {
+        error = true;
+        return false;
+    }
+
+    while (scratchBits < bits)
+    {
+        scratch |= (Uint64)data[bytes++] << scratchBits;
+        scratchBits += 8;
+    }
+
+    value = (Uint32)(scratch & (((Uint64)1 << bits) - 1));
+    scratch >>= bits;
+    scratchBits -= bits;
+
+    return true;
+}
+
+//=============================================================================
+// Read a bool from one bit
+//=============================================================================
+bool BitReader::readBool(bool& value)
+{
+    Uint32 bit = 0;
+    const bool ok = readBits(bit, 1);
+
+    value = (bit != 0);
+
+    return ok;
+}
+
+//=============================================================================
+// Read an int written with the same min and max
+//=============================================================================
+bool BitReader::readInt(Sint32& value, Sint32 min, Sint32 max)
+{
+    const int bits = bitsRequired(min, max);
+    Uint32 raw = 0;
+
+    value = min;
+
+    if (bits == 0)
+    {
+        return !error;
+    }
+
+    if (readBits(raw, bits) == false)
+    {
+        value = 0;
+        return false;
+    }
+
+    if (raw > (Uint32)max - (Uint32)min)
+    {
+        error = true;           // bits hold more than the range
+        value = 0;
+        return false;
+    }
+
+    value = (Sint32)((Uint32)min + raw);
+
+    return true;
+}
+
+//=============================================================================
+// Read a float written with the same range and bits
+//=============================================================================
+bool BitReader::readFloat(float& value, float min, float max, int bits)
+{
+    Uint32 raw = 0;
+
+    value = 0.0f;
+
+    if (readBits(raw, bits) == false)
+    {
+        return false;
+    }
+
+    value = dequantise(raw, min, max, bits);
+
+    return true;
+}
+
+//=============================================================================
+// Read a varint, rejecting ones longer than MAX_VARINT bytes
+//=============================================================================
+bool BitReader::readVarint(Uint32& value)
+{
+    Uint32 result = 0;
+
+    value = 0;
+
+    for (int i = 0; i < bitStreamNS::MAX_VARINT; i++)
+    {
+        Uint32 byte = 0;
+
+        if (readBits(byte, 8) == false)
+        {
+            return false;
+        }
+
+        result |= (byte & 0x7F) << (7 * i);
+
+        if ((byte & 0x80) == 0)
+        {
+            if (i == bitStreamNS::MAX_VARINT - 1 && byte > 0x0F)
+            {
+                break;          // more than 32 bits
+            }
+
+            value = result;
+            return true;
+        }
+    }
+
+    error = true;
+
+    return false;
+}
+
+//=============================================================================
+// Read a zigzag encoded varint
+//=============================================================================
+bool BitReader::readSignedVarint(Sint32& value)
+{
+    Uint32 raw = 0;
+    const bool ok = readVarint(raw);
+
+    value = (Sint32)(raw >> 1) ^ -(Sint32)(raw & 1);
+
+    return ok;
+}
+
+//=============================================================================
+// Read a string of up to maxLength characters
+//=============================================================================
+bool BitReader::readString(char* str, int maxLength)
+{
+    Sint32 length = 0;
+
+    str[0] = '\0';
+
+    if (readInt(length, 0, maxLength) == false ||
+        readBytes(str, length) == false)
+    {
+        str[0] = '\0';
+        return false;
+    }
+
+    str[length] = '\0';
+
+    return true;
+}
+
+//=============================================================================
+// Read count bytes, 8 bits each
+//=============================================================================
+bool BitReader::readBytes(void* bytes, int count)
+{
+    Uint8* p = (Uint8*)bytes;
+
+    if (count < 0 || getBitsRemaining() < count * 8)
+    {
+        error = true;
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        Uint32 byte = 0;
+
+        readBits(byte, 8);
+        p[i] = (Uint8)byte;
+    }
+
+    return !error;
+}
+
+//=============================================================================
+// Return the number of bits left
+//=============================================================================
+int BitReader::getBitsRemaining() const
+{
+    return (size - bytes) * 8 + scratchBits;
+}
+
+//=============================================================================
+// Return true if a read failed
+//=============================================================================
+bool BitReader::getError() const
+{
+    return error;
+}
+
+//=============================================================================
+// Message schema calls, read the value
+//=============================================================================
+bool BitReader::serializeBits(Uint32& value, int bits)
+{
+    return readBits(value, bits);
+}
+
+bool BitReader::serializeBool(bool& value)
+{
+    return readBool(value);
+}
+
+bool BitReader::serializeInt(Sint32& value, Sint32 min, Sint32 max)
+{
+    return readInt(value, min, max);
+}
+
+bool BitReader::serializeFloat(float& value, float min, float max, int bits)
+{
+    return readFloat(value, min, max, bits);
+}
+
+bool BitReader::serializeVarint(Uint32& value)
+{
+    return readVarint(value);
+}
+
+bool BitReader::serializeSignedVarint(Sint32& value)
+{
+    return readSignedVarint(value);
+}
+
+bool BitReader::serializeString(char* str, int maxLength)
+{
+    return readString(str, maxLength);
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <SDL3\SDL.h>
+
+//-----------------------------------------------------------------------------
+//
+// BIT STREAM
+//
+// BitWriter packs values into a caller's buffer using only the bits they
+// need, BitReader reads them back and fails instead of reading past the
+// end or accepting a value outside its declared range. Bits are packed low
+// bit first.
+//
+// Message schema: a struct with a serialize template that is compiled once
+// for writing and once for reading, for example
+//
+//     typedef struct _MOVE_MESSAGE
+//     {
+//         int id;
+//         float x;
+//
+//         template <typename Stream> bool serialize(Stream& stream)
+//         {
+//             return stream.serializeInt(id, 0, 255) &&
+//                 stream.serializeFloat(x, 0.0f, 1280.0f, 16);
+//         }
+//     } MOVE_MESSAGE;
+//
+// and sent with writeMessage() and received with readMessage().
+//
+//-----------------------------------------------------------------------------
+
+namespace bitStreamNS
+{
+    const int MAX_VARINT = 5;           // bytes in a 32 bit varint
+}
+
+class BitWriter
+{
+    // BitWriter properties
+private:
+    Uint8*  data;
+    int     size;           // bytes
+    int     bytes;          // whole bytes written
+    Uint64  scratch;            // bits not written to data yet
+    int     scratchBits;
+    bool    overflow;           // a write didn't fit
+
+public:
+    enum { IsWriting = 1, IsReading = 0 };
+
+    // Write to size bytes at data
+    BitWriter(void* data, int size);
+
+    // Write the low bits of value, 1 to 32 bits
+    void writeBits(Uint32 value, int bits);
+
+    void writeBool(bool value);
+
+    // Write value in the bits needed for min to max, clamped to the range
+    void writeInt(Sint32 value, Sint32 min, Sint32 max);
+
+    // Write value quantised to bits over min to max, clamped to the range
+    void writeFloat(float value, float min, float max, int bits);
+
+    // Write 7 bits per byte, small values take less space
+    void writeVarint(Uint32 value);
+
+    // Zigzag encoded, small negative values are small too
+    void writeSignedVarint(Sint32 value);
+
+    // Write up to maxLength characters of str with its length
+    void writeString(const char* str, int maxLength);
+
+    void writeBytes(const void* bytes, int count);
+
+    //=============================================================================
+    // Write the last partial byte. Returns the number of bytes used, -1 if
+    // anything didn't fit.
+    //=============================================================================
+    int flush();
+
+    // Return the number of bits written
+    int getBitsWritten() const;
+
+    // Return true if a write didn't fit
+    bool getOverflow() const;
+
+    // Message schema calls, see serialize() above
+    bool serializeBits(Uint32& value, int bits);
+    bool serializeBool(bool& value);
+    bool serializeInt(Sint32& value, Sint32 min, Sint32 max);
+    bool serializeFloat(float& value, float min, float max, int bits);
+    bool serializeVarint(Uint32& value);
+    bool serializeSignedVarint(Sint32& value);
+    bool serializeString(char* str, int maxLength);
+};
+
+class BitReader
+{
+    // BitReader properties
+private:
+    const Uint8* data;
+    int     size;           // bytes
+    int     bytes;          // whole bytes read into scratch
+    Uint64  scratch;            // bits read from data, not returned yet
+    int     scratchBits;
+    bool    error;          // read past the end or a value out of range
+
+public:
+    enum { IsWriting = 0, IsReading = 1 };
+
+    // Read from size bytes at data
+    BitReader(const void* data, int size);
+
+    //=============================================================================
+    // Each read returns false, sets value to 0 and the error flag if the
+    // data ends early or the value is outside its range. Reads after an
+    // error fail too.
+    //=============================================================================
+    bool readBits(Uint32& value, int bits);
+    bool readBool(bool& value);
+    bool readInt(Sint32& value, Sint32 min, Sint32 max);
+    bool readFloat(float& value, float min, float max, int bits);
+    bool readVarint(Uint32& value);
+    bool readSignedVarint(Sint32& value);
+
+    // str must hold maxLength + 1 characters, it is always terminated
+    bool readString(char* str, int maxLength);
+
+    bool readBytes(void* bytes, int count);
+
+    // Return the number of bits left
+    int getBitsRemaining() const;
+
+    // Return true if a read failed
+    bool getError() const;
+
+    // Message schema calls, see serialize() above
+    bool serializeBits(Uint32& value, int bits);
+    bool serializeBool(bool& value);
+    bool serializeInt(Sint32& value, Sint32 min, Sint32 max);
+    bool serializeFloat(float& value, float min, float max, int bits);
+    bool serializeVarint(Uint32& value);
+    bool serializeSignedVarint(Sint32& value);
+    bool serializeString(char* str, int maxLength);
+};
+
+// Return the number of bits needed for values min to max
+int bitsRequired(Sint32 min, Sint32 max);
+
+//=============================================================================
+// Write a message with its schema
+// Returns the number of bytes written, -1 if it doesn't fit in size.
+//=============================================================================
+template <typename T>
+int writeMessage(T& message, void* data, int size)
+{
+    BitWriter writer(data, size);
+
+    if (message.serialize(writer) == false)
+    {
+        return -1;
+    }
+
+    return writer.flush();
+}
+
+//=============================================================================
+// Read a message with its schema
+// Returns false if the data is malformed.
+//=============================================================================
+template <typename T>
+bool readMessage(T& message, const void* data, int size)
+{
+    BitReader reader(data, size);
+
+    return (message.serialize(reader) && reader.getError() == false);
+}
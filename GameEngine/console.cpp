@@ -27,8 +27,15 @@ Console::Console()
     SDL_memset(&vtx, 0, 4 * sizeof(vector4_t));
 
     textIn = "";
+    textHead = 0;
+    textUsed = 0;
+    lineHead = 0;
+    lineCount = 0;
     rows = 0;
     scrollAmount = 0;
+    cache = NULL;
+    cacheGeneration = 0;
+    dirty = true;
 }
 
 //=============================================================================
@@ -36,6 +43,11 @@ Console::Console()
 //=============================================================================
 Console::~Console()
 {
+    if (graphics != NULL && cache != NULL)
+    {
+        graphics->freeTexture(cache);
+    }
+
     font.deleteAll();
 }
 
@@ -73,7 +85,7 @@ bool Console::initialize(Graphics* pGraphics, Input* pInput)
     font.setFontColor(fontColor);
 
     // sets textRect bottom to height of 1 row
-    rowH = font.print("|", textRect, ALIGNMENT::CALCRECT);
+    rowH = font.measure("|", textRect, 0);
     rowH += 2;         // height of 1 row (+2 is row spacing)
 
     if (rowH <= 0)         // this should never be true
@@ -105,13 +117,51 @@ void Console::draw()
         return;
     }
 
-    graphics->drawQuad(vtx[0], vtx[1], vtx[2], vtx[3], backColor);            // draw backdrop
+    if (cache == NULL)
+    {
+        if (graphics->createRenderTarget((int)SDL_ceilf(w), (int)SDL_ceilf(h),
+            cache) == false)
+        {
+            drawConsole();          // no cache, draw every frame
+            return;
+        }
+
+        dirty = true;
+    }
 
-    if (text.size() == 0)
+    // redraw the cache only when the console changed or the target was lost
+    if (dirty || cacheGeneration != graphics->getTargetGeneration())
     {
-        return;
+        if (graphics->beginRenderTarget(cache, x, y) == false)
+        {
+            drawConsole();
+            return;
+        }
+
+        drawConsole();
+        graphics->endRenderTarget();
+
+        dirty = false;
+        cacheGeneration = graphics->getTargetGeneration();
     }
 
+    const vector3_t p0 = { x, y, 1 };
+    const vector3_t p1 = { x + SDL_ceilf(w), y, 1 };
+    const vector3_t p2 = { x + SDL_ceilf(w), y + SDL_ceilf(h), 1 };
+    const vector3_t p3 = { x, y + SDL_ceilf(h), 1 };
+
+    graphics->spriteBegin(SPRITE_ALPHABLEND);
+    graphics->batchSprite(cache, NULL, p0, p1, p2, p3, graphicsNS::WHITE);
+    graphics->spriteEnd();
+}
+
+//=============================================================================
+// draw backdrop, text rows and prompt
+//=============================================================================
+void Console::drawConsole()
+{
+    graphics->drawQuad(vtx[0], vtx[1], vtx[2], vtx[3], backColor);            // draw backdrop
+
     graphics->spriteBegin(SPRITE_ALPHABLEND);
 
     // display text on console
@@ -125,13 +175,16 @@ void Console::draw()
     textRect.max.y = (y + ((h - (2 * m)) - (2 * rowH)));
     textRect.min.y = (textRect.max.y - rowH);
 
-    // for all rows (max text.size()) from bottom to top
-    for (int r = scrollAmount; r < rows + scrollAmount && r < (int)(text.size()); r++)
+    // for all rows (max lineCount) from bottom to top
+    for (int r = scrollAmount; r < rows + scrollAmount && r < lineCount; r++)
     {
+        int length = 0;
+        const char* line = getLine(r, length);
+
         // set text display rect top for this row
         textRect.min.y = (textRect.max.y - rowH);
-        // display one row of text
-        font.print(text[r], textRect, ALIGNMENT::LEFT);
+        // display one row of text, straight from the ring
+        font.print(line, length, textRect, ALIGNMENT::LEFT);
         // adjust text display rect bottom for next row
         textRect.max.y -= rowH;
     }
@@ -157,6 +210,9 @@ void Console::update(float frameTime)
         return;
     }
 
+    const int prevScroll = scrollAmount;
+    const size_t prevLength = textIn.length();
+
     // check for console key
     if (input->wasKeyPressed(CONSOLE_KEY))
     {
@@ -199,9 +255,14 @@ void Console::update(float frameTime)
         scrollAmount = consoleNS::MAX_LINES - 1;
     }
 
-    if (scrollAmount > (int)(text.size()) - 1)
+    if (scrollAmount > lineCount - 1)
     {
-        scrollAmount = (int)(text.size()) - 1;
+        scrollAmount = lineCount - 1;
+    }
+
+    if (scrollAmount < 0)
+    {
+        scrollAmount = 0;
     }
 
     if (input->wasKeyPressed(BACKSPACE_KEY) == true)            // backspace
@@ -221,6 +282,11 @@ void Console::update(float frameTime)
         inputStr = textIn;
         textIn.clear();
     }
+
+    if (scrollAmount != prevScroll || textIn.length() != prevLength)
+    {
+        dirty = true;
+    }
 }
 
 //=============================================================================
@@ -235,6 +301,7 @@ void Console::showHide()
 
     visible = !visible;
     textIn.clear();
+    dirty = true;
 }
 
 //=============================================================================
@@ -251,6 +318,7 @@ bool Console::getVisible() const
 void Console::show()
 {
     visible = true;
+    dirty = true;
 }
 
 //=============================================================================
@@ -275,15 +343,15 @@ void Console::print(const char* fmt, ...)
     va_start(args, fmt);
     char str[256];
 
-    vsnprintf(str, 256, fmt, args);
+    int length = vsnprintf(str, 256, fmt, args);
     va_end(args);
 
-    text.push_front(str);           // add str to deque of text
-
-    if (text.size() > consoleNS::MAX_LINES)
+    if (length < 0)
     {
-        text.pop_back();            // delete oldest line
+        return;
     }
+
+    printLine(str, SDL_min(length, 255));
 }
 
 //=============================================================================
@@ -297,12 +365,85 @@ void Console::print(const std::string& str)
         return;
     }
 
-    text.push_front(str);           // add str to deque of text
+    printLine(str.c_str(), (int)str.length());
+}
+
+//=============================================================================
+// Add count characters of str to console
+// Lines are kept whole in the ring, a line that would wrap past the end
+// starts again at the beginning and the skipped characters count as its
+// padding. The oldest lines are dropped to make room.
+//=============================================================================
+void Console::printLine(const char* str, int count)
+{
+    if (!initialized || str == NULL || count < 0)
+    {
+        return;
+    }
 
-    if (text.size() > consoleNS::MAX_LINES)
+    if (count > consoleNS::MAX_LINE_LENGTH)
     {
-        text.pop_back();            // delete oldest line
+        count = consoleNS::MAX_LINE_LENGTH;
     }
+
+    int start = textHead;
+    int span = count;
+
+    if (start + count > consoleNS::TEXT_BUFFER_SIZE)
+    {
+        span += consoleNS::TEXT_BUFFER_SIZE - start;
+        start = 0;
+    }
+
+    // drop the oldest lines until the new one fits
+    while (lineCount > 0 && (lineCount == consoleNS::MAX_LINES ||
+        textUsed + span > consoleNS::TEXT_BUFFER_SIZE))
+    {
+        int oldest = lineHead - lineCount;
+
+        if (oldest < 0)
+        {
+            oldest += consoleNS::MAX_LINES;
+        }
+
+        textUsed -= lineSpan[oldest];
+        lineCount--;
+    }
+
+    SDL_memcpy(&textBuffer[start], str, count);
+
+    lineStart[lineHead] = start;
+    lineLength[lineHead] = count;
+    lineSpan[lineHead] = span;
+    lineHead = (lineHead + 1) % consoleNS::MAX_LINES;
+    lineCount++;
+
+    textUsed += span;
+    textHead = (start + count) % consoleNS::TEXT_BUFFER_SIZE;
+    dirty = true;
+}
+
+//=============================================================================
+// Return line n of the console, 0 is the newest
+//=============================================================================
+const char* Console::getLine(int n, int& length) const
+{
+    if (n < 0 || n >= lineCount)
+    {
+        length = 0;
+        return "";
+    }
+
+    int line = lineHead - 1 - n;
+
+    if (line < 0)
+    {
+        line += consoleNS::MAX_LINES;
+    }
+
+    length = lineLength[line];
+
+    return &textBuffer[lineStart[line]];
 }
 
 //=============================================================================
@@ -315,6 +456,7 @@ void Console::keyIn(unsigned int key)
         if (textIn.length() > 0)
         {
             textIn.erase(textIn.size() - 1);
+            dirty = true;
         }
     }
     else
@@ -328,6 +470,7 @@ void Console::keyIn(unsigned int key)
         if (textIn.length() + 1 < 256)
         {
             textIn.insert(textIn.length(), 1, (key & 0xFF));
+            dirty = true;
         }
     }
 }
@@ -366,4 +509,5 @@ std::string Console::getInput()
 void Console::clearInput()
 {
     textIn = "";
+    dirty = true;
 }
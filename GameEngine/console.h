@@ -1,6 +1,5 @@
 #pragma once
 #include <string>
-#include <deque>
 #include "constants.h"
 #include "gameError.h"
 #include "graphics.h"
@@ -20,6 +19,8 @@ namespace consoleNS
     const vector4_t FONT_COLOR = graphicsNS::WHITE;
     const vector4_t BACK_COLOR = SETCOLOR_ARGB(192, 128, 128, 128);            // backdrop color
     const int MAX_LINES = 256;          // maximun number of lines in text buffer
+    const int MAX_LINE_LENGTH = 255;            // longer lines are cut
+    const int TEXT_BUFFER_SIZE = 16384;         // characters shared by all lines
 }
 
 class Console
@@ -36,7 +37,15 @@ private:
     int         rows;           // number of rows of text that will fit on console
     std::string textIn;         // console command
     std::string inputStr;           // console text input
-    std::deque<std::string> text;           // console text
+    // console text, a ring of characters and a ring of lines into it
+    char        textBuffer[consoleNS::TEXT_BUFFER_SIZE];
+    int         textHead;           // next character written
+    int         textUsed;           // characters held by lines, with padding
+    int         lineStart[consoleNS::MAX_LINES];
+    int         lineLength[consoleNS::MAX_LINES];
+    int         lineSpan[consoleNS::MAX_LINES];         // length plus padding
+    int         lineHead;           // next line written
+    int         lineCount;
     rect_t      textRect;           // text rectangle
     vector4_t   fontColor;          // font color (a,r,g,b)
     vector4_t   backColor;          // background color (a,r,g,b)
@@ -44,6 +53,12 @@ private:
     int         scrollAmount;           // number of lines to scroll the display up
     bool        initialized;            // true when initialized successfully
     bool        visible;            // true to display
+    LP_TEXTURE  cache;          // the console as drawn by drawConsole()
+    unsigned int cacheGeneration;           // Graphics target generation of cache
+    bool        dirty;          // true when cache must be drawn again
+
+    // Draw backdrop, text rows and prompt.
+    void drawConsole();
 
 public:
     // Constructor
@@ -56,6 +71,8 @@ public:
     bool initialize(Graphics* pGraphics, Input* pInput);
 
     // Display the Console.
+    // The console is drawn into a texture when its text, scroll position or
+    // input changes and shown from there.
     void draw();
 
     // update the console
@@ -80,6 +97,13 @@ public:
     // Only the first line of text in str will be displayed.
     void print(const std::string& str);
 
+    // Add count characters of str to Console display.
+    void printLine(const char* str, int count);
+
+    // Return line n of the display, 0 is the newest, and its length.
+    // The text is not terminated and stays valid until the next print.
+    const char* getLine(int n, int& length) const;
+
     // Save the char just entered in textIn string
     void keyIn(unsigned int key);
 
@@ -95,6 +95,10 @@ const int GAME_HEIGHT = 480;               // height of game in pixels
 
 // game
 const bool VSYNC = false;                   // true locks display to vertical sync rate
+const bool TEXTURE_HOT_RELOAD = false;      // true reloads textures when their files change
+const bool PREMULTIPLIED_ALPHA = false;     // true premultiplies textures and blends with linear filtering
+const unsigned int TEXTURE_REDUCTION = 0;   // low-memory mode, 0 full, 1 half, 2 quarter resolution textures
+const bool SDF_FONTS = false;               // true draws every font size from one distance field per face
 const float FRAME_RATE = 240.0f;                // the target frame rate (frames/sec)
 const float MIN_FRAME_RATE = 10.0f;             // the minimum frame rate
 const float MIN_FRAME_TIME = 1.0f / FRAME_RATE;   // minimum desired time for 1 frame
@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <SDL3_ttf\SDL_ttf.h>
 #include "font.h"
+#include "fontManager.h"
+#include "pixelConvert.h"
 
 static const int GRID_C = 16;          // number of columns in font image
 static const int GRID_R = 14;          // number of rows in font image
@@ -7,24 +10,425 @@ static const int MAX_FONT_HEIGHT = 256;
 static const int MIN_CHAR = 0x0020;            // minimum character code
 static const int MAX_CHAR = 0x00FF;            // maximum character code
 static const int TAB_SIZE = 8;
+static const size_t MAX_LAYOUTS = 128;         // cached DrawText layouts per font
+static const size_t MAX_WRAPS = 16;            // line breaks shared by Measure and DrawText
+static const int ATLAS_SIZE = 512;             // width and height of a glyph atlas page
+static const size_t MAX_ATLAS_PAGES = 4;       // glyph atlas pages per font
+static const int SDF_REFERENCE_SIZE = 64;      // point size of the distance field
+static const int SDF_SPREAD = 8;               // distance range in reference pixels
+
+static std::vector<SDF_ATLAS*> sdfAtlases;     // one per face and style
+
+//=============================================================================
+// Decode the UTF-8 code point at p and move p past it. Bytes that are not
+// valid UTF-8 are taken as Latin-1 so single byte strings keep working.
+//=============================================================================
+static uint32_t DecodeCodePoint(const uint8_t*& p, const uint8_t* end)
+{
+    uint32_t cp = p[0];
+    int length = 1;
+
+    if (cp >= 0xC2 && cp <= 0xDF)
+    {
+        length = 2;
+        cp &= 0x1F;
+    }
+    else if (cp >= 0xE0 && cp <= 0xEF)
+    {
+        length = 3;
+        cp &= 0x0F;
+    }
+    else if (cp >= 0xF0 && cp <= 0xF4)
+    {
+        length = 4;
+        cp &= 0x07;
+    }
 
+    if (length > 1)
+    {
+        bool valid = (end - p >= length);
 
+        for (int i = 1; i < length && valid; i++)
+        {
+            valid = ((p[i] & 0xC0) == 0x80);
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
 
-bool Create(Graphics* pGraphics, int Height, bool Bold,
-    bool Italic, long Quality, const char* pFaceName, Font** ppFont)
+        // reject overlong forms, surrogates and values past U+10FFFF
+        if (valid == false || (length == 3 && cp < 0x800) ||
+            (length == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+            (cp >= 0xD800 && cp <= 0xDFFF))
+        {
+            cp = p[0];
+            length = 1;
+        }
+    }
+
+    p += length;
+
+    return cp;
+}
+
+//=============================================================================
+// Decode UTF-8 into code points
+//=============================================================================
+static void DecodeUTF8(const char* pString, int Count, std::u32string& str)
 {
-    if (pGraphics == NULL || Height > MAX_FONT_HEIGHT ||
-        pFaceName == "" || ppFont == NULL)
+    const uint8_t* p = (const uint8_t*)pString;
+    const uint8_t* end = p + Count;
+
+    str.clear();
+    str.reserve(Count);
+
+    while (p < end)
+    {
+        str += (char32_t)DecodeCodePoint(p, end);
+    }
+}
+
+//=============================================================================
+// Signed distance transform (8SSEDT).
+// Each cell holds the offset to the nearest seed pixel.
+//=============================================================================
+typedef struct _SDF_OFFSET
+{
+    int dx;
+    int dy;
+} SDF_OFFSET;
+
+static inline int OffsetLength2(const SDF_OFFSET& o)
+{
+    return o.dx * o.dx + o.dy * o.dy;
+}
+
+static inline void CompareOffset(SDF_OFFSET* grid, int w, int h, int x, int y,
+    int ox, int oy)
+{
+    if (x + ox < 0 || x + ox >= w || y + oy < 0 || y + oy >= h)
+    {
+        return;
+    }
+
+    SDF_OFFSET other = grid[(y + oy) * w + (x + ox)];
+
+    other.dx += ox;
+    other.dy += oy;
+
+    if (OffsetLength2(other) < OffsetLength2(grid[y * w + x]))
+    {
+        grid[y * w + x] = other;
+    }
+}
+
+static void DistanceTransform(SDF_OFFSET* grid, int w, int h)
+{
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            CompareOffset(grid, w, h, x, y, -1,  0);
+            CompareOffset(grid, w, h, x, y,  0, -1);
+            CompareOffset(grid, w, h, x, y, -1, -1);
+            CompareOffset(grid, w, h, x, y,  1, -1);
+        }
+
+        for (int x = w - 1; x >= 0; x--)
+        {
+            CompareOffset(grid, w, h, x, y, 1, 0);
+        }
+    }
+
+    for (int y = h - 1; y >= 0; y--)
+    {
+        for (int x = w - 1; x >= 0; x--)
+        {
+            CompareOffset(grid, w, h, x, y,  1,  0);
+            CompareOffset(grid, w, h, x, y,  0,  1);
+            CompareOffset(grid, w, h, x, y, -1,  1);
+            CompareOffset(grid, w, h, x, y,  1,  1);
+        }
+
+        for (int x = 0; x < w; x++)
+        {
+            CompareOffset(grid, w, h, x, y, -1, 0);
+        }
+    }
+}
+
+//=============================================================================
+// Rasterise the fixed grid at the reference size and convert it to a
+// distance field. Every size of the face and style is drawn from it.
+//=============================================================================
+static SDF_ATLAS* AcquireSDFAtlas(const char* pFaceName, int style)
+{
+    for (size_t i = 0; i < sdfAtlases.size(); i++)
+    {
+        if (sdfAtlases[i]->faceName == pFaceName && sdfAtlases[i]->style == style)
+        {
+            sdfAtlases[i]->refCount++;
+            return sdfAtlases[i];
+        }
+    }
+
+    TTF_Font* font = FontManager::acquireFont(pFaceName,
+        (float)SDF_REFERENCE_SIZE, style);
+
+    if (font == NULL)
+    {
+        return NULL;
+    }
+
+    SDF_ATLAS* atlas = new SDF_ATLAS();
+
+    atlas->faceName = pFaceName;
+    atlas->style = style;
+    atlas->proportional = !TTF_FontIsFixedWidth(font);
+    atlas->metrics = (SDL_Rect*)SDL_calloc(GRID_R * GRID_C, sizeof(SDL_Rect));
+    atlas->advance = (int*)SDL_calloc(GRID_R * GRID_C, sizeof(int));
+    atlas->refCount = 1;
+
+    int glyphW = 0;
+
+    for (int i = 0; i < GRID_R * GRID_C; i++)
+    {
+        SDL_Rect& m = atlas->metrics[i];
+
+        if (TTF_GetGlyphMetrics(font, i + MIN_CHAR, &m.x, &m.w, &m.y, &m.h,
+            &atlas->advance[i]) == true)
+        {
+            glyphW = SDL_max(glyphW, m.w - m.x);
+        }
+    }
+
+    // padding keeps the distance of one glyph out of its neighbours
+    atlas->cellW = glyphW + SDF_SPREAD * 2;
+    atlas->cellH = TTF_GetFontHeight(font) + SDF_SPREAD * 2;
+    atlas->width = atlas->cellW * GRID_C;
+    atlas->height = atlas->cellH * GRID_R;
+
+    const int w = atlas->width;
+    const int h = atlas->height;
+    SDL_Surface* coverage = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_ARGB8888);
+    SDF_OFFSET* inside = (SDF_OFFSET*)SDL_malloc(w * h * sizeof(SDF_OFFSET));
+    SDF_OFFSET* outside = (SDF_OFFSET*)SDL_malloc(w * h * sizeof(SDF_OFFSET));
+    atlas->distance = (uint8_t*)SDL_malloc(w * h);
+
+    if (coverage == NULL || inside == NULL || outside == NULL ||
+        atlas->distance == NULL || atlas->metrics == NULL || atlas->advance == NULL)
+    {
+        SDL_DestroySurface(coverage);
+        SDL_free(inside);
+        SDL_free(outside);
+        SDL_free(atlas->distance);
+        SDL_free(atlas->metrics);
+        SDL_free(atlas->advance);
+        delete atlas;
+        FontManager::releaseFont(font);
+
+        return NULL;
+    }
+
+    SDL_FillSurfaceRect(coverage, NULL, 0);
+
+    const SDL_Color fcolor = { 255, 255, 255, 255 };
+
+    for (int i = 0; i < GRID_R * GRID_C; i++)
+    {
+        SDL_Surface* glyph = TTF_RenderGlyph_Blended(font, i + MIN_CHAR, fcolor);
+
+        if (glyph != NULL)
+        {
+            SDL_Rect rect = {
+                (i % GRID_C) * atlas->cellW + SDF_SPREAD,
+                (i / GRID_C) * atlas->cellH + SDF_SPREAD,
+                atlas->cellW - SDF_SPREAD * 2,
+                atlas->cellH - SDF_SPREAD * 2
+            };
+
+            const SDL_Rect clip = {
+                0, 0, SDL_min(glyph->w, rect.w), SDL_min(glyph->h, rect.h)
+            };
+
+            SDL_SetSurfaceBlendMode(glyph, SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyph, &clip, coverage, &rect);
+            SDL_DestroySurface(glyph);
+        }
+    }
+
+    // keep the reference size open for the atlas's lifetime, releasing it
+    // would shut down SDL_ttf and free the face before the sized font opens
+    atlas->font = font;
+
+    // seed each transform with the pixels on one side of the outline
+    const SDF_OFFSET zero = { 0, 0 };
+    const SDF_OFFSET unset = { w, h };
+
+    for (int y = 0; y < h; y++)
+    {
+        const uint32_t* row = (const uint32_t*)((uint8_t*)coverage->pixels +
+            y * coverage->pitch);
+
+        for (int x = 0; x < w; x++)
+        {
+            const bool in = (row[x] >> 24) >= 128;
+
+            inside[y * w + x] = in ? zero : unset;
+            outside[y * w + x] = in ? unset : zero;
+        }
+    }
+
+    SDL_DestroySurface(coverage);
+
+    DistanceTransform(inside, w, h);
+    DistanceTransform(outside, w, h);
+
+    // 128 on the outline, SDF_SPREAD pixels inside maps to 255
+    for (int i = 0; i < w * h; i++)
+    {
+        const float d = SDL_sqrtf((float)OffsetLength2(outside[i])) -
+            SDL_sqrtf((float)OffsetLength2(inside[i]));
+        const float v = 128.0f + d * (128.0f / SDF_SPREAD);
+
+        atlas->distance[i] = (uint8_t)SDL_clamp(v, 0.0f, 255.0f);
+    }
+
+    SDL_free(inside);
+    SDL_free(outside);
+
+    sdfAtlases.push_back(atlas);
+
+    return atlas;
+}
+
+static void ReleaseSDFAtlas(SDF_ATLAS* atlas)
+{
+    if (atlas == NULL || --atlas->refCount > 0)
+    {
+        return;
+    }
+
+    sdfAtlases.erase(std::remove(sdfAtlases.begin(), sdfAtlases.end(), atlas),
+        sdfAtlases.end());
+
+    FontManager::releaseFont(atlas->font);
+    SDL_free(atlas->distance);
+    SDL_free(atlas->metrics);
+    SDL_free(atlas->advance);
+    delete atlas;
+}
+
+//=============================================================================
+// Create a font of any height from the shared distance field.
+// SDL_Renderer has no alpha test, so the outline is thresholded on the CPU
+// into a coverage grid for this height. No glyphs are rasterised by SDL_ttf.
+// Only the distance field and the face are shared: each height still owns a
+// grid texture, its CPU copy is freed once the texture is made.
+//=============================================================================
+static bool CreateSDF(Graphics* pGraphics, int Height, int style,
+    const char* pFaceName, Font** ppFont)
+{
+    SDF_ATLAS* atlas = AcquireSDFAtlas(pFaceName, style);
+
+    if (atlas == NULL)
+    {
+        return false;
+    }
+
+    // glyphs outside the grid are still rasterised at this height
+    TTF_Font* font = FontManager::acquireFont(pFaceName, (float)Height, style);
+
+    const float scale = (float)Height / SDF_REFERENCE_SIZE;
+    const int cellW = (int)SDL_ceilf((atlas->cellW - SDF_SPREAD * 2) * scale);
+    const int cellH = (int)SDL_ceilf((atlas->cellH - SDF_SPREAD * 2) * scale);
+
+    SDL_Rect* metrics = (SDL_Rect*)SDL_malloc(GRID_R * GRID_C * sizeof(SDL_Rect));
+    int* advance = (int*)SDL_malloc(GRID_R * GRID_C * sizeof(int));
+    SDL_Surface* surface = SDL_CreateSurface(cellW * GRID_C, cellH * GRID_R,
+        SDL_PIXELFORMAT_ARGB8888);
+
+    if (font == NULL || metrics == NULL || advance == NULL || surface == NULL)
     {
+        SDL_DestroySurface(surface);
+        SDL_free(metrics);
+        SDL_free(advance);
+        FontManager::releaseFont(font);
+        ReleaseSDFAtlas(atlas);
+
         return false;
     }
 
-    // Initialize the TTF library
-    if (TTF_Init() == false)
+    for (int i = 0; i < GRID_R * GRID_C; i++)
+    {
+        metrics[i].x = (int)SDL_floorf(atlas->metrics[i].x * scale);
+        metrics[i].w = (int)SDL_ceilf(atlas->metrics[i].w * scale);
+        metrics[i].y = (int)SDL_floorf(atlas->metrics[i].y * scale);
+        metrics[i].h = (int)SDL_ceilf(atlas->metrics[i].h * scale);
+        advance[i] = (int)SDL_roundf(atlas->advance[i] * scale);
+    }
+
+    // resample the distance field and cut at the outline, distances are
+    // converted to output pixels for a one pixel anti-aliased edge
+    const float toPixels = (SDF_SPREAD / 128.0f) * scale;
+    const bool premultiplied = pGraphics->getPremultipliedAlpha();
+
+    for (int y = 0; y < surface->h; y++)
     {
-        GameError(gameErrorNS::FATAL_ERROR,
-            "Couldn't initialize TTF: %s\n", SDL_GetError());
+        uint32_t* row = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
+        const int cellY = (y / cellH) * atlas->cellH + SDF_SPREAD;
+        const float sy = cellY + ((y % cellH) + 0.5f) / scale - 0.5f;
+        const int y0 = SDL_clamp((int)SDL_floorf(sy), 0, atlas->height - 2);
+        const float fy = SDL_clamp(sy - y0, 0.0f, 1.0f);
+
+        for (int x = 0; x < surface->w; x++)
+        {
+            const int cellX = (x / cellW) * atlas->cellW + SDF_SPREAD;
+            const float sx = cellX + ((x % cellW) + 0.5f) / scale - 0.5f;
+            const int x0 = SDL_clamp((int)SDL_floorf(sx), 0, atlas->width - 2);
+            const float fx = SDL_clamp(sx - x0, 0.0f, 1.0f);
+            const uint8_t* d = atlas->distance + y0 * atlas->width + x0;
+
+            const float top = d[0] + (d[1] - d[0]) * fx;
+            const float bottom = d[atlas->width] +
+                (d[atlas->width + 1] - d[atlas->width]) * fx;
+            const float dist = (top + (bottom - top) * fy - 128.0f) * toPixels;
+            const uint32_t alpha = (uint32_t)(SDL_clamp(dist + 0.5f, 0.0f, 1.0f) * 255.0f);
+
+            // white glyph, ARGB8888
+            row[x] = premultiplied ? (alpha * 0x01010101u) :
+                ((alpha << 24) | 0x00FFFFFFu);
+        }
+    }
+
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(pGraphics->get2DRenderer(),
+        surface);
+
+    if (texture == NULL)
+    {
+        SDL_DestroySurface(surface);
+        SDL_free(metrics);
+        SDL_free(advance);
+        FontManager::releaseFont(font);
+        ReleaseSDFAtlas(atlas);
+
+        return false;
+    }
+
+    pGraphics->setTextureBlendMode(texture);          // match the texture alpha mode
+    SDL_DestroySurface(surface);            // only the texture is drawn
+
+    *ppFont = new Font(pGraphics->get2DRenderer(), NULL, texture, metrics,
+        advance, cellW, cellH, TAB_SIZE, atlas->proportional, font, HIGH_QUALITY,
+        atlas);
 
+    return true;
+}
+
+bool Create(Graphics* pGraphics, int Height, bool Bold,
+    bool Italic, long Quality, const char* pFaceName, Font** ppFont)
+{
+    if (pGraphics == NULL || Height > MAX_FONT_HEIGHT ||
+        pFaceName == "" || ppFont == NULL)
+    {
         return false;
     }
 
@@ -40,33 +444,29 @@ bool Create(Graphics* pGraphics, int Height, bool Bold,
         weight |= TTF_STYLE_ITALIC;
     }
 
-    // create TTF font
-    TTF_Font* font = TTF_OpenFont(pFaceName, (float)Height);
+    if (Quality == SDF_QUALITY)
+    {
+        return CreateSDF(pGraphics, Height, weight, pFaceName, ppFont);
+    }
+
+    // sized TTF font, the face file is read once and shared
+    TTF_Font* font = FontManager::acquireFont(pFaceName, (float)Height, weight);
 
     if (font == NULL)
     {
-        TTF_Quit();         // Free the TTF library
-
         return false;
     }
 
-    TTF_SetFontStyle(font, weight);
     bool proportional = !TTF_FontIsFixedWidth(font);
 
     SDL_Rect* metrics = (SDL_Rect*)SDL_malloc(GRID_R * GRID_C * sizeof(SDL_Rect));
     int* advance = (int*)SDL_malloc(GRID_R * GRID_C * sizeof(int));
 
-    if (metrics == NULL)
-    {
-        TTF_Quit();         // Free the TTF library
-
-        return false;
-    }
-
-    if (advance == NULL)
+    if (metrics == NULL || advance == NULL)
     {
         SDL_free(metrics);
-        TTF_Quit();         // Free the TTF library
+        SDL_free(advance);
+        FontManager::releaseFont(font);
 
         return false;
     }
@@ -81,7 +481,7 @@ bool Create(Graphics* pGraphics, int Height, bool Bold,
     {
         for (int col = 0; col < GRID_C; col++)
         {
-            const char ch = (row * GRID_C) + col + MIN_CHAR;
+            const Uint32 ch = (row * GRID_C) + col + MIN_CHAR;
 
             if (ch >= MIN_CHAR && ch <= MAX_CHAR)
             {
@@ -125,17 +525,12 @@ bool Create(Graphics* pGraphics, int Height, bool Bold,
         SDL_GetSurfacePalette(surface), bcolor.r, bcolor.g, bcolor.b, bcolor.a);
     SDL_FillSurfaceRect(surface, NULL, surfaceRGBA);
 
-    SDL_SetSurfaceColorKey(surface, true,
-        SDL_MapRGBA(SDL_GetPixelFormatDetails(surface->format),
-            SDL_GetSurfacePalette(surface),
-            bcolor.r, bcolor.g, bcolor.b, bcolor.a));
-
     for (int row = 0; row < GRID_R; row++)
     {
         for (int col = 0; col < GRID_C; col++)
         {
             SDL_Rect rect = {};
-            const char ch = (row * GRID_C) + col + MIN_CHAR;
+            const Uint32 ch = (row * GRID_C) + col + MIN_CHAR;
 
             if (ch >= MIN_CHAR && ch <= MAX_CHAR)
             {
@@ -172,13 +567,23 @@ bool Create(Graphics* pGraphics, int Height, bool Bold,
         }
     }
 
-    if (font != NULL)
+    // background colour to alpha (ARGB8888, alpha is the top byte)
+    if (SDL_LockSurface(surface) == true)
     {
-        TTF_CloseFont(font);
-        font = NULL;
-    }
+        for (int y = 0; y < surface->h; y++)
+        {
+            uint32_t* row = (uint32_t*)((uint8_t*)surface->pixels + y * surface->pitch);
 
-    TTF_Quit();         // Free the TTF library
+            PixelColorKey(row, surface->w, surfaceRGBA, 0x00FFFFFF);
+
+            if (pGraphics->getPremultipliedAlpha() == true)
+            {
+                PixelPremultiplyAlpha((uint8_t*)row, surface->w);
+            }
+        }
+
+        SDL_UnlockSurface(surface);
+    }
 
     SDL_Texture* texture = SDL_CreateTextureFromSurface(pGraphics->get2DRenderer(), surface);
 
@@ -193,11 +598,16 @@ bool Create(Graphics* pGraphics, int Height, bool Bold,
         SDL_free(metrics);
         SDL_free(advance);
 
+        FontManager::releaseFont(font);
+
         return false;
     }
 
+    pGraphics->setTextureBlendMode(texture);          // match the texture alpha mode
+
+    // the font stays open to rasterise glyphs outside the fixed grid
     Font* pFont = new Font(pGraphics->get2DRenderer(), surface, texture, metrics,
-        advance, cellW, cellH, TAB_SIZE, proportional);
+        advance, cellW, cellH, TAB_SIZE, proportional, font, Quality);
     *ppFont = pFont;
 
     return true;
@@ -214,14 +624,23 @@ Font::Font() noexcept
     cellH = 0;
     proportional = false;
     tabSize = TAB_SIZE;
+    layoutHits = 0;
+    layoutMisses = 0;
+    wrapUses = 0;
+    ttfFont = NULL;
+    quality = DEFAULT_QUALITY;
+    useCount = 0;
+    sdf = NULL;
 }
 
 Font::Font(SDL_Renderer* pRenderer2d, SDL_Surface* pSurface,
     SDL_Texture* pTexture, SDL_Rect* pMetrics, int* pAdvance, int cellWidth,
-    int cellHeight, unsigned int tabSize, bool proportional) noexcept
+    int cellHeight, unsigned int tabSize, bool proportional, TTF_Font* pTTFFont,
+    long quality, SDF_ATLAS* pSDF) noexcept
     : renderer2d(pRenderer2d), surface(pSurface), texture(pTexture),
     metrics(pMetrics), advance(pAdvance), cellW(cellWidth), cellH(cellHeight),
-    tabSize(tabSize), proportional(proportional)
+    tabSize(tabSize), proportional(proportional), layoutHits(0), layoutMisses(0),
+    wrapUses(0), ttfFont(pTTFFont), quality(quality), useCount(0), sdf(pSDF)
 {
 }
 
@@ -241,6 +660,17 @@ Font::~Font()
 
     SDL_free(metrics);
     SDL_free(advance);
+
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        SDL_DestroyTexture(pages[i].texture);
+    }
+
+    FontManager::releaseFont(ttfFont);
+    ttfFont = NULL;
+
+    ReleaseSDFAtlas(sdf);
+    sdf = NULL;
 }
 
 void Font::SetTabSize(unsigned int Size)
@@ -251,24 +681,490 @@ void Font::SetTabSize(unsigned int Size)
     }
 
     tabSize = Size;
+
+    // cached layouts were measured with the old tab size
+    layouts.clear();
+    layoutMap.clear();
+
+    for (size_t i = 0; i < wraps.size(); i++)
+    {
+        wraps[i].count = 0;
+    }
 }
 
-int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
-    rect_t* pRect, unsigned int Format, COLOR_ARGB Color)
+void Font::GetLayoutStats(unsigned long* pHits, unsigned long* pMisses) const
 {
-    if (pGraphics == NULL || pString[0] == '\0' || Count == 0)
+    if (pHits != NULL)
+    {
+        *pHits = layoutHits;
+    }
+
+    if (pMisses != NULL)
+    {
+        *pMisses = layoutMisses;
+    }
+}
+
+int Font::GlyphWidth(Graphics* pGraphics, uint32_t ch)
+{
+    // fixed grid, same cost as before for ASCII and Latin-1
+    if (ch <= MAX_CHAR)
+    {
+        if (proportional == false)
+        {
+            return cellW;
+        }
+
+        const uint32_t chN = ch - MIN_CHAR;            // make min_char index 0
+        return advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
+    }
+
+    const ATLAS_GLYPH* pGlyph = FindGlyph(pGraphics, ch);
+
+    return (pGlyph != NULL) ? pGlyph->advance : 0;
+}
+
+int Font::GlyphAdvance(uint32_t ch) const
+{
+    if (ch <= MAX_CHAR)
+    {
+        if (proportional == false)
+        {
+            return cellW;
+        }
+
+        const uint32_t chN = ch - MIN_CHAR;            // make min_char index 0
+        return advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
+    }
+
+    std::unordered_map<uint32_t, ATLAS_GLYPH>::const_iterator iter =
+        glyphMap.find(ch);
+
+    if (iter != glyphMap.end())
+    {
+        return iter->second.advance;
+    }
+
+    // not drawn yet, ask SDL_ttf for the metrics AddGlyph would use
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, adv = 0;
+
+    if (ttfFont == NULL ||
+        TTF_GetGlyphMetrics(ttfFont, ch, &minX, &maxX, &minY, &maxY, &adv) == false)
     {
         return 0;
     }
 
-    std::string str2 = "";
-    std::string str = std::string(pString, Count);
-    rect_t sprRect = { 0 };
+    if (proportional == false)
+    {
+        return SDL_max(1, (adv + cellW - 1) / cellW) * cellW;
+    }
+
+    return adv + 1;
+}
+
+int Font::GetGlyph(Graphics* pGraphics, uint32_t ch, rect_t& rect,
+    SDL_Texture*& pTexture)
+{
+    if (ch <= MAX_CHAR)
+    {
+        const uint32_t chN = ch - MIN_CHAR;            // make min_char index 0
+        const int index = ((chN >> 4) * GRID_C) + (chN % GRID_C);
+
+        rect.min.y = (float)((chN >> 4) * cellH);
+        rect.max.y = (float)(rect.min.y + cellH);
+        pTexture = texture;
+
+        if (proportional)
+        {
+            rect.min.x = (float)((chN % GRID_C) * cellW) + metrics[index].x;
+            rect.max.x = (float)((chN % GRID_C) * cellW) + metrics[index].w + 1;
+
+            return advance[index] + 1;
+        }
+
+        // fixed pitch
+        rect.min.x = (float)((chN % GRID_C) * cellW);
+        rect.max.x = (float)(rect.min.x + cellW);
+
+        return cellW;
+    }
+
+    const ATLAS_GLYPH* pGlyph = FindGlyph(pGraphics, ch);
+
+    if (pGlyph == NULL || pGlyph->page < 0)
+    {
+        pTexture = NULL;
+
+        return (pGlyph != NULL) ? pGlyph->advance : 0;
+    }
+
+    rect = pGlyph->rect;
+    pTexture = pages[pGlyph->page].texture;
+
+    return pGlyph->advance;
+}
+
+const ATLAS_GLYPH* Font::FindGlyph(Graphics* pGraphics, uint32_t ch)
+{
+    std::unordered_map<uint32_t, ATLAS_GLYPH>::const_iterator iter =
+        glyphMap.find(ch);
+
+    if (iter == glyphMap.end())
+    {
+        ATLAS_GLYPH glyph = { 0 };
+
+        if (AddGlyph(pGraphics, ch, glyph) == false)
+        {
+            return NULL;
+        }
+
+        iter = glyphMap.insert(std::make_pair(ch, glyph)).first;
+    }
+
+    // pages used by the current DrawText call are not evicted
+    if (iter->second.page >= 0)
+    {
+        pages[iter->second.page].lastUse = useCount;
+    }
+
+    return &iter->second;
+}
+
+bool Font::AddGlyph(Graphics* pGraphics, uint32_t ch, ATLAS_GLYPH& glyph)
+{
+    if (ttfFont == NULL)
+    {
+        return false;
+    }
+
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, adv = 0;
+
+    glyph.page = -1;
+    glyph.advance = 0;
+
+    if (TTF_GetGlyphMetrics(ttfFont, ch, &minX, &maxX, &minY, &maxY, &adv) == false)
+    {
+        return true;            // not in the font, cached as an empty glyph
+    }
+
+    glyph.advance = adv + 1;
+
+    if (proportional == false)
+    {
+        // wide glyphs take whole cells
+        glyph.advance = SDL_max(1, (adv + cellW - 1) / cellW) * cellW;
+    }
+
+    const SDL_Color fcolor = { 255, 255, 255, 255 };
+    const SDL_Color bcolor = { 128, 128, 128, 255 };
+    SDL_Surface* rendered = NULL;
+
+    switch (quality)
+    {
+    case PRECISION_QUALITY:
+    {
+        rendered = TTF_RenderGlyph_LCD(ttfFont, ch, fcolor, bcolor);
+    } break;
+    case HIGH_QUALITY:
+    {
+        rendered = TTF_RenderGlyph_Shaded(ttfFont, ch, fcolor, bcolor);
+    } break;
+    case DEFAULT_QUALITY:
+    default:
+    {
+        rendered = TTF_RenderGlyph_Solid(ttfFont, ch, fcolor);
+    }
+    }
+
+    if (rendered == NULL)
+    {
+        return true;            // nothing to draw, keep the advance
+    }
+
+    // same layout as a grid cell: glyph at the left, full line height
+    SDL_Surface* cell = SDL_CreateSurface(SDL_min(SDL_max(rendered->w, maxX + 1),
+        ATLAS_SIZE), SDL_min(cellH, ATLAS_SIZE), SDL_PIXELFORMAT_ARGB8888);
+
+    if (cell == NULL)
+    {
+        SDL_DestroySurface(rendered);
+        return true;
+    }
+
+    const uint32_t cellRGBA = SDL_MapRGBA(SDL_GetPixelFormatDetails(cell->format),
+        NULL, bcolor.r, bcolor.g, bcolor.b, bcolor.a);
+
+    SDL_FillSurfaceRect(cell, NULL, cellRGBA);
+    SDL_BlitSurface(rendered, NULL, cell, NULL);
+    SDL_DestroySurface(rendered);
+
+    // background colour to alpha, as for the grid
+    for (int y = 0; y < cell->h; y++)
+    {
+        uint32_t* row = (uint32_t*)((uint8_t*)cell->pixels + y * cell->pitch);
+
+        PixelColorKey(row, cell->w, cellRGBA, 0x00FFFFFF);
+
+        if (pGraphics->getPremultipliedAlpha() == true)
+        {
+            PixelPremultiplyAlpha((uint8_t*)row, cell->w);
+        }
+    }
+
+    SDL_Rect dest = { 0, 0, cell->w, cell->h };
+    int page = PackGlyph(pGraphics, dest);
+
+    if (page >= 0)
+    {
+        SDL_UpdateTexture(pages[page].texture, &dest, cell->pixels, cell->pitch);
+
+        glyph.page = page;
+        glyph.rect.min.x = (float)(dest.x + SDL_max(minX, 0));
+        glyph.rect.max.x = (float)(dest.x + SDL_min(maxX + 1, dest.w));
+        glyph.rect.min.y = (float)dest.y;
+        glyph.rect.max.y = (float)(dest.y + dest.h);
+    }
+
+    SDL_DestroySurface(cell);
+
+    return true;
+}
+
+int Font::PackGlyph(Graphics* pGraphics, SDL_Rect& rect)
+{
+    // shelf packing, use the lowest shelf the glyph fits on
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        ATLAS_PAGE& page = pages[i];
+        int best = -1;
+
+        for (size_t j = 0; j < page.shelves.size(); j++)
+        {
+            const SDL_Rect& shelf = page.shelves[j];
+
+            if (shelf.h >= rect.h && shelf.x + rect.w <= ATLAS_SIZE &&
+                (best < 0 || shelf.h < page.shelves[best].h))
+            {
+                best = (int)j;
+            }
+        }
+
+        if (best < 0 && page.top + rect.h <= ATLAS_SIZE)
+        {
+            // open a new shelf
+            const SDL_Rect shelf = { 0, page.top, 0, rect.h };
+
+            page.shelves.push_back(shelf);
+            page.top += rect.h;
+            best = (int)page.shelves.size() - 1;
+        }
+
+        if (best >= 0)
+        {
+            rect.x = page.shelves[best].x;
+            rect.y = page.shelves[best].y;
+            page.shelves[best].x += rect.w;
+
+            return (int)i;
+        }
+    }
+
+    if (pages.size() < MAX_ATLAS_PAGES)
+    {
+        ATLAS_PAGE page;
+
+        page.texture = SDL_CreateTexture(renderer2d, SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STATIC, ATLAS_SIZE, ATLAS_SIZE);
+        page.top = 0;
+        page.lastUse = useCount;
+
+        if (page.texture == NULL)
+        {
+            return -1;
+        }
+
+        // new textures are undefined, start transparent
+        void* pClear = SDL_calloc(ATLAS_SIZE * ATLAS_SIZE, 4);
+
+        if (pClear != NULL)
+        {
+            SDL_UpdateTexture(page.texture, NULL, pClear, ATLAS_SIZE * 4);
+            SDL_free(pClear);
+        }
+
+        pGraphics->setTextureBlendMode(page.texture);
+        pages.push_back(page);
+    }
+    else if (EvictPage(pGraphics) == false)
+    {
+        return -1;          // every page is in use by this call
+    }
+
+    return PackGlyph(pGraphics, rect);
+}
+
+bool Font::EvictPage(Graphics* pGraphics)
+{
+    int oldest = -1;
+
+    // least recently used page not needed by the current DrawText call
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        if (pages[i].lastUse != useCount &&
+            (oldest < 0 || pages[i].lastUse < pages[oldest].lastUse))
+        {
+            oldest = (int)i;
+        }
+    }
+
+    if (oldest < 0)
+    {
+        return false;
+    }
+
+    // draw queued glyphs before their texture is reused
+    pGraphics->flushBatch();
+
+    std::unordered_map<uint32_t, ATLAS_GLYPH>::iterator iter = glyphMap.begin();
+
+    while (iter != glyphMap.end())
+    {
+        if (iter->second.page == oldest)
+        {
+            iter = glyphMap.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+
+    pages[oldest].shelves.clear();
+    pages[oldest].top = 0;
+    pages[oldest].lastUse = useCount;
+
+    // cached layouts may point at the evicted glyphs
+    layouts.clear();
+    layoutMap.clear();
+
+    return true;
+}
+
+void Font::DrawLayout(Graphics* pGraphics, const TEXT_LAYOUT& layout,
+    const rect_t* pRect, COLOR_ARGB Color)
+{
+    for (size_t i = 0; i < layout.glyphs.size(); i++)
+    {
+        const LAYOUT_GLYPH& glyph = layout.glyphs[i];
+        float x0 = pRect->min.x + glyph.x;
+        float y0 = pRect->min.y + glyph.y;
+        float x1 = x0 + (glyph.rect.max.x - glyph.rect.min.x);
+        float y1 = y0 + (glyph.rect.max.y - glyph.rect.min.y);
+        const vector3_t p0 = { x0, y0, 1 };
+        const vector3_t p1 = { x1, y0, 1 };
+        const vector3_t p2 = { x1, y1, 1 };
+        const vector3_t p3 = { x0, y1, 1 };
+        pGraphics->batchSprite(glyph.texture, &glyph.rect, p0, p1, p2, p3, Color);
+    }
+}
+
+void Font::SetLayoutKey(TEXT_LAYOUT& layout, const rect_t* pRect,
+    unsigned int Format)
+{
+    layout.rectW = (int)(pRect->max.x - pRect->min.x);
+    layout.rectH = (int)(pRect->max.y - pRect->min.y);
+    layout.format = Format;
+    layout.result = 0;
+    layout.key = layout.hash;
+    layout.key = (layout.key ^ (uint32_t)layout.count) * 0x100000001B3ULL;
+    layout.key = (layout.key ^ (uint32_t)layout.rectW) * 0x100000001B3ULL;
+    layout.key = (layout.key ^ (uint32_t)layout.rectH) * 0x100000001B3ULL;
+    layout.key = (layout.key ^ layout.format) * 0x100000001B3ULL;
+}
+
+void Font::AddLayout(TEXT_LAYOUT& layout)
+{
+    std::unordered_map<uint64_t, std::list<TEXT_LAYOUT>::iterator>::iterator
+        iter = layoutMap.find(layout.key);
+
+    // replace a colliding entry
+    if (iter != layoutMap.end())
+    {
+        layouts.erase(iter->second);
+        layoutMap.erase(iter);
+    }
+
+    // evict the least recently used layout
+    if (layouts.size() >= MAX_LAYOUTS)
+    {
+        layoutMap.erase(layouts.back().key);
+        layouts.pop_back();
+    }
+
+    layouts.push_front(std::move(layout));
+    layoutMap[layouts.front().key] = layouts.begin();
+}
+
+// Line breaks of a string in a rectangle rectW wide. Measure and DrawText
+// with the same string, width and wrapping format share one entry, widths
+// come from glyph advances so nothing is rasterised.
+const TEXT_WRAP& Font::WrapText(const char* pString, int Count, int rectW,
+    unsigned int Format)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;          // FNV-1a
+    for (int i = 0; i < Count; i++)
+    {
+        hash = (hash ^ (uint8_t)pString[i]) * 0x100000001B3ULL;
+    }
+
+    Format &= (WORDBOUNDS | BOTTOM | SINGLELINE | EXPANDTABS);
+
+    uint64_t key = hash;
+    key = (key ^ (uint32_t)Count) * 0x100000001B3ULL;
+    key = (key ^ (uint32_t)rectW) * 0x100000001B3ULL;
+    key = (key ^ Format) * 0x100000001B3ULL;
+
+    if (wraps.empty())
+    {
+        wraps.resize(MAX_WRAPS);            // the strings keep their capacity
+    }
+
+    wrapUses++;
+
+    size_t oldest = 0;
+
+    for (size_t i = 0; i < wraps.size(); i++)
+    {
+        TEXT_WRAP& cached = wraps[i];
+
+        if (cached.count != 0 && cached.key == key && cached.hash == hash &&
+            cached.count == Count && cached.rectW == rectW && cached.format == Format)
+        {
+            cached.lastUse = wrapUses;
+            return cached;
+        }
+
+        if (cached.lastUse < wraps[oldest].lastUse)
+        {
+            oldest = i;
+        }
+    }
+
+    TEXT_WRAP& wrap = wraps[oldest];
+
+    wrap.key = key;
+    wrap.hash = hash;
+    wrap.count = Count;
+    wrap.rectW = rectW;
+    wrap.format = Format;
+    wrap.lastUse = wrapUses;
+
+    // working strings keep their capacity between calls
+    std::u32string& str2 = wrap.text;
+    std::u32string& str = textBuffer;
     int offset = 0;
     int extent = 0;
-    int lineNum = (str != "") ? 1 : 0;
-    int rectW = (int)(pRect->max.x - pRect->min.x);
-    int rectH = (int)(pRect->max.y - pRect->min.y);
+    int lineNum = 0;
     int saveW = 0;
     int lineW = 0;
     int lineH = cellH;
@@ -277,25 +1173,18 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
     int charH = cellH;
     int strW = 0;
     int strH = 0;
-    float l = 0.0f;
-    float t = 0.0f;
-    float x = 0.0f;
-    float y = 0.0f;
-    unsigned char ch = 0, chN = 0;
-    unsigned char spaceW = 0;
+    uint32_t ch = 0;
+    int spaceW = 0;
 
-    if (proportional)
-    {
-        chN = ' ' - MIN_CHAR;
-        spaceW = advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
-    }
-    else            // fixed pitch
-    {
-        spaceW = cellW;
-    }
+    str2.clear();
+
+    DecodeUTF8(pString, Count, str);
+    lineNum = (str.empty() == false) ? 1 : 0;
+
+    spaceW = GlyphAdvance(' ');
 
     // newline count
-    for (std::string::const_iterator iter = str.begin(); iter != str.end(); iter++)
+    for (std::u32string::const_iterator iter = str.begin(); iter != str.end(); iter++)
     {
         if (*iter == '\n') lineNum++;
     }
@@ -310,28 +1199,21 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
     {
         // regular words
         while (extent < str.length() &&
-            (str.at(extent) > MIN_CHAR && str.at(extent) <= MAX_CHAR))
+            str.at(extent) > MIN_CHAR)
         {
             extent++;
         }
 
         // measure width in pixels
         wordW = 0;
-        std::string token = str.substr(offset, (extent - offset));
+        std::u32string& token = tokenBuffer;
+        token.assign(str, offset, (extent - offset));
         for (unsigned int i = 0; i < token.length(); i++)
         {
             ch = token.at(i);
-            if (ch > MIN_CHAR && ch <= MAX_CHAR)            // displayable character
+            if (ch > MIN_CHAR)            // displayable character
             {
-                if (proportional)
-                {
-                    chN = ch - MIN_CHAR;            // make min_char index 0
-                    charW = advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
-                }
-                else            // fixed pitch
-                {
-                    charW = cellW;
-                }
+                charW = GlyphAdvance(ch);
 
                 wordW += charW;
             }
@@ -346,9 +1228,9 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
                     (Format & SINGLELINE) != SINGLELINE)
                 {
                     strW = rectW;
-                    if (str2.at(str2.length()-1) != '\n')
+                    if (str2.empty() || str2.at(str2.length()-1) != '\n')
                     {
-                        if (str2.at(str2.length()-1) == ' ')
+                        if (str2.empty() == false && str2.at(str2.length()-1) == ' ')
                         {
                             str2.erase(str2.end()-1);
                         }
@@ -365,18 +1247,9 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
                     for (unsigned int i = 0; i < token.length(); i++)
                     {
                         ch = token.at(i);
-                        if (ch > MIN_CHAR && ch <= MAX_CHAR)
+                        if (ch > MIN_CHAR)
                         {
-                            if (proportional)
-                            {
-                                chN = ch - MIN_CHAR;
-                                charW = advance[((chN >> 4) * GRID_C) +
-                                    (chN % GRID_C)] + 1;
-                            }
-                            else            // fixed pitch
-                            {
-                                charW = cellW;
-                            }
+                            charW = GlyphAdvance(ch);
 
                             // rectangle bounds
                             if ((lineW + wordW + charW) > rectW && rectW > 0)
@@ -411,8 +1284,8 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
         }
         else            // everything else
         {
-            if ((lineNum == 1 || (wordW > rectW && rectW > 0)) &&
-                (Format & CALCRECT) == CALCRECT)
+            // CALCRECT widens to the word, drawing doesn't use strW
+            if (lineNum == 1 || (wordW > rectW && rectW > 0))
             {
                 if ((lineW + wordW) > rectW && rectW > 0)
                 {
@@ -437,7 +1310,7 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
         }
 
         wordW = 0;
-        token = str.substr(offset, (extent - offset));
+        token.assign(str, offset, (extent - offset));
         for (unsigned int i = 0; i < token.length(); i++)
         {
             ch = token.at(i);
@@ -451,19 +1324,11 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
                     str2.erase(str2.end() - 1);
                 }
 
-                if (ch > MIN_CHAR && ch <= MAX_CHAR)            // displayable character
+                if (ch > MIN_CHAR)            // displayable character
                 {
                     if (lineW > 0)
                     {
-                        if (proportional)
-                        {
-                            chN = ch - MIN_CHAR;            // make min_char index 0
-                            lineW -= advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
-                        }
-                        else            // fixed pitch
-                        {
-                            lineW -= cellW;
-                        }
+                        lineW -= GlyphAdvance(ch);
                     }
                 }
                 else
@@ -606,15 +1471,88 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
         offset = extent;
     }
 
-    // calculate rectangle
+    wrap.lineH = lineH;
+    wrap.strW = strW;
+    wrap.strH = strH;
+
+    return wrap;
+}
+
+int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
+    rect_t* pRect, unsigned int Format, COLOR_ARGB Color)
+{
+    if (pGraphics == NULL || pString[0] == '\0' || Count == 0)
+    {
+        return 0;
+    }
+
+    // the rectangle comes from the line breaks alone
     if ((Format & CALCRECT) == CALCRECT)
     {
-        pRect->max.x = pRect->min.x + strW;
-        pRect->max.y = pRect->min.y + strH;
+        return Measure(pGraphics, pString, Count, pRect, Format);
+    }
+
+    TEXT_LAYOUT layout;
 
-        return strH;
+    layout.hash = 0xCBF29CE484222325ULL;            // FNV-1a
+    for (int i = 0; i < Count; i++)
+    {
+        layout.hash = (layout.hash ^ (uint8_t)pString[i]) * 0x100000001B3ULL;
     }
 
+    layout.count = Count;
+    SetLayoutKey(layout, pRect, Format);
+
+    // glyphs are stored relative to the rectangle, alignment rounding only
+    // matches for whole pixel positions
+    const bool cacheable = (pRect->min.x == floorf(pRect->min.x) &&
+        pRect->min.y == floorf(pRect->min.y));
+
+    if (cacheable)
+    {
+        std::unordered_map<uint64_t, std::list<TEXT_LAYOUT>::iterator>::iterator
+            iter = layoutMap.find(layout.key);
+
+        if (iter != layoutMap.end() && iter->second->hash == layout.hash &&
+            iter->second->count == layout.count &&
+            iter->second->rectW == layout.rectW &&
+            iter->second->rectH == layout.rectH &&
+            iter->second->format == layout.format)
+        {
+            const TEXT_LAYOUT& cached = *iter->second;
+
+            layoutHits++;
+            layouts.splice(layouts.begin(), layouts, iter->second);
+            DrawLayout(pGraphics, cached, pRect, Color);
+
+            return cached.result;
+        }
+
+        layoutMisses++;
+    }
+
+    const TEXT_WRAP& wrap = WrapText(pString, Count,
+        (int)(pRect->max.x - pRect->min.x), Format);
+    const std::u32string& str2 = wrap.text;
+    rect_t sprRect = { 0 };
+    int offset = 0;
+    int extent = 0;
+    int lineW = 0;
+    int lineH = wrap.lineH;
+    int charW = cellW;
+    int charH = cellH;
+    float l = 0.0f;
+    float t = 0.0f;
+    float x = 0.0f;
+    float y = 0.0f;
+    uint32_t ch = 0;
+    const int spaceW = GlyphWidth(pGraphics, ' ');
+
+    useCount++;         // atlas pages used by this call are not evicted
+
+    layout.glyphs.swap(glyphBuffer);
+    layout.glyphs.clear();
+
     // alignment and draw
     offset = 0;
     extent = 0;
@@ -648,7 +1586,8 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
             }
         }
 
-        std::string line = str2.substr(offset, (extent - offset));
+        std::u32string& line = lineBuffer;
+        line.assign(str2, offset, (extent - offset));
         lineW = 0;
         lineH = cellH;
 
@@ -656,17 +1595,9 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
         for (unsigned int i = 0; i < line.length(); i++)
         {
             ch = line.at(i);
-            if (ch > MIN_CHAR && ch <= MAX_CHAR)            // displayable character
+            if (ch > MIN_CHAR)            // displayable character
             {
-                if (proportional)
-                {
-                    chN = ch - MIN_CHAR;            // make min_char index 0
-                    charW = advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
-                }
-                else            // fixed pitch
-                {
-                    charW = cellW;
-                }
+                charW = GlyphWidth(pGraphics, ch);
 
                 lineW += charW;
             }
@@ -725,39 +1656,23 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
         for (unsigned int i = 0; i < line.length(); i++)
         {
             ch = line.at(i);
-            if (ch > MIN_CHAR && ch <= MAX_CHAR)            // displayable character
+            if (ch > MIN_CHAR)            // displayable character
             {
-                chN = ch - MIN_CHAR;            // make min_char index 0
-                sprRect.min.y = (float)((chN >> 4) * cellH);
-                sprRect.max.y = (float)(sprRect.min.y + cellH);
+                SDL_Texture* glyphTexture = NULL;
 
-                if (proportional)
-                {
-                    sprRect.min.x = (float)((chN % GRID_C) * cellW) +
-                        metrics[((chN >> 4) * GRID_C) + (chN % GRID_C)].x;
-                    sprRect.max.x = (float)((chN % GRID_C) * cellW) +
-                        metrics[((chN >> 4) * GRID_C) + (chN % GRID_C)].w + 1;
-                    charW = advance[((chN >> 4) * GRID_C) + (chN % GRID_C)] + 1;
-                }
-                else            // fixed pitch
-                {
-                    charW = cellW;
-                    sprRect.min.x = (float)((chN % GRID_C) * cellW);
-                    sprRect.max.x = (float)(sprRect.min.x + cellW);
-                }
+                charW = GetGlyph(pGraphics, ch, sprRect, glyphTexture);
 
-                if (l + x >= pRect->min.x && l + x < pRect->max.x &&
+                if (glyphTexture != NULL &&
+                    l + x >= pRect->min.x && l + x < pRect->max.x &&
                     t + y >= pRect->min.y && t + y < pRect->max.y)
                 {
-                    float x0 = l + x;
-                    float y0 = t + y;
-                    float x1 = x0 + (sprRect.max.x - sprRect.min.x);
-                    float y1 = y0 + (sprRect.max.y - sprRect.min.y);
-                    const vector3_t p0 = { x0, y0, 1 };
-                    const vector3_t p1 = { x1, y0, 1 };
-                    const vector3_t p2 = { x1, y1, 1 };
-                    const vector3_t p3 = { x0, y1, 1 };
-                    pGraphics->drawSprite(texture, &sprRect, p0, p1, p2, p3, Color);
+                    LAYOUT_GLYPH glyph = { 0 };
+
+                    glyph.x = (l + x) - pRect->min.x;
+                    glyph.y = (t + y) - pRect->min.y;
+                    glyph.rect = sprRect;
+                    glyph.texture = glyphTexture;
+                    layout.glyphs.push_back(glyph);
                 }
 
                 x += charW;
@@ -815,5 +1730,37 @@ int Font::DrawText(Graphics* pGraphics, const char* pString, int Count,
         offset = extent;
     }
 
+    DrawLayout(pGraphics, layout, pRect, Color);
+
+    if (cacheable)
+    {
+        layout.result = lineH;
+        AddLayout(layout);
+    }
+    else
+    {
+        glyphBuffer.swap(layout.glyphs);            // keep the capacity
+    }
+
     return lineH;
 }
+
+// Same rectangle as DrawText with CALCRECT, from glyph advances only. No
+// glyph is rasterised, and the line breaks are kept so that printing the
+// string at the same width and format doesn't break it again.
+int Font::Measure(Graphics* pGraphics, const char* pString, int Count,
+    rect_t* pRect, unsigned int Format)
+{
+    if (pGraphics == NULL || pString[0] == '\0' || Count == 0)
+    {
+        return 0;
+    }
+
+    const TEXT_WRAP& wrap = WrapText(pString, Count,
+        (int)(pRect->max.x - pRect->min.x), Format);
+
+    pRect->max.x = pRect->min.x + wrap.strW;
+    pRect->max.y = pRect->min.y + wrap.strH;
+
+    return wrap.strH;
+}
@@ -1,4 +1,9 @@
 #pragma once
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <SDL3_ttf\SDL_ttf.h>
 #include "constants.h"
 #include "gameError.h"
 #include "graphics.h"
@@ -12,6 +17,7 @@
 #define DEFAULT_QUALITY         0
 #define HIGH_QUALITY            1
 #define PRECISION_QUALITY       2
+#define SDF_QUALITY             3           // drawn from a shared distance field
 
 enum ALIGNMENT
 {
@@ -32,6 +38,79 @@ enum ALIGNMENT
 typedef struct Font Font;
 typedef struct Font* LP_FONT;
 
+// Glyph position relative to the top left of the DrawText rectangle
+typedef struct _LAYOUT_GLYPH
+{
+    float x;
+    float y;
+    rect_t rect;            // glyph rectangle in texture
+    SDL_Texture* texture;   // fixed grid or atlas page
+} LAYOUT_GLYPH;
+
+// Glyph outside the fixed grid, rasterised on first use
+typedef struct _ATLAS_GLYPH
+{
+    int page;               // atlas page, -1 when there is nothing to draw
+    rect_t rect;            // glyph rectangle in the page
+    int advance;
+} ATLAS_GLYPH;
+
+// Glyph atlas page, filled with shelves of glyphs
+typedef struct _ATLAS_PAGE
+{
+    SDL_Texture* texture;
+    std::vector<SDL_Rect> shelves;  // x is the next free column
+    int top;                        // first row below the shelves
+    unsigned long lastUse;          // DrawText call that last used the page
+} ATLAS_PAGE;
+
+// Distance field of the fixed grid at a reference size, shared by every
+// SDF_QUALITY font of one face and style
+typedef struct _SDF_ATLAS
+{
+    std::string faceName;
+    int style;
+    uint8_t* distance;      // 128 on the outline, higher inside
+    int width;
+    int height;
+    int cellW;              // includes the padding around each glyph
+    int cellH;
+    SDL_Rect* metrics;      // reference size metrics
+    int* advance;
+    bool proportional;
+    TTF_Font* font;         // reference size, held so the face stays loaded
+    int refCount;
+} SDF_ATLAS;
+
+// Result of laying out one DrawText call
+typedef struct _TEXT_LAYOUT
+{
+    uint64_t key;
+    uint64_t hash;          // hash of the string
+    int count;
+    int rectW;
+    int rectH;
+    unsigned int format;
+    int result;             // DrawText return value
+    std::vector<LAYOUT_GLYPH> glyphs;
+} TEXT_LAYOUT;
+
+// Line breaks of one string at one width, shared by Measure and DrawText.
+// Alignment and the rectangle origin are applied when it is drawn.
+typedef struct _TEXT_WRAP
+{
+    uint64_t key;
+    uint64_t hash;          // hash of the string
+    int count;              // 0 when the slot is empty
+    int rectW;
+    unsigned int format;    // the format bits that change line breaks
+    int lineH;              // height of all lines
+    int strW;               // CALCRECT size
+    int strH;
+    unsigned long lastUse;
+    std::u32string text;    // the string with its line breaks and tabs expanded
+} TEXT_WRAP;
+
 bool Create(Graphics* pGraphics, int Height, bool Bold,
     bool Italic, long Quality, const char* pFaceName, Font** ppFont);
 
@@ -41,13 +120,33 @@ public:
     Font() noexcept;
     Font(SDL_Renderer* pRenderer, SDL_Surface* pSurface, SDL_Texture* pTexture,
         SDL_Rect* pMetrics, int* pAdvance, int cellWidth, int cellHeight,
-        unsigned int tabSize, bool proportional) noexcept;
+        unsigned int tabSize, bool proportional, TTF_Font* pTTFFont,
+        long quality, SDF_ATLAS* pSDF = NULL) noexcept;
     ~Font();
     int DrawText(Graphics* pGraphics, const char* pString, int Count,
         rect_t* pRect, unsigned int Format, COLOR_ARGB Color);
+    int Measure(Graphics* pGraphics, const char* pString, int Count,
+        rect_t* pRect, unsigned int Format);
     void SetTabSize(unsigned int Size);
+    void GetLayoutStats(unsigned long* pHits, unsigned long* pMisses) const;
 
 private:
+    void DrawLayout(Graphics* pGraphics, const TEXT_LAYOUT& layout,
+        const rect_t* pRect, COLOR_ARGB Color);
+    void SetLayoutKey(TEXT_LAYOUT& layout, const rect_t* pRect,
+        unsigned int Format);
+    void AddLayout(TEXT_LAYOUT& layout);
+    const TEXT_WRAP& WrapText(const char* pString, int Count, int rectW,
+        unsigned int Format);
+    int GlyphWidth(Graphics* pGraphics, uint32_t ch);
+    int GlyphAdvance(uint32_t ch) const;
+    int GetGlyph(Graphics* pGraphics, uint32_t ch, rect_t& rect,
+        SDL_Texture*& pTexture);
+    const ATLAS_GLYPH* FindGlyph(Graphics* pGraphics, uint32_t ch);
+    bool AddGlyph(Graphics* pGraphics, uint32_t ch, ATLAS_GLYPH& glyph);
+    int PackGlyph(Graphics* pGraphics, SDL_Rect& rect);
+    bool EvictPage(Graphics* pGraphics);
+
     SDL_Renderer* renderer2d;
     SDL_Surface* surface;
     SDL_Texture* texture;
@@ -57,4 +156,24 @@ private:
     int cellH;
     unsigned int tabSize;
     bool proportional;
+    // layout cache, most recently used first
+    std::list<TEXT_LAYOUT> layouts;
+    std::unordered_map<uint64_t, std::list<TEXT_LAYOUT>::iterator> layoutMap;
+    unsigned long layoutHits;
+    unsigned long layoutMisses;
+    // line breaks from Measure and DrawText, least recently used is reused
+    std::vector<TEXT_WRAP> wraps;
+    unsigned long wrapUses;
+    // DrawText working buffers, reused so layout does not allocate
+    std::u32string textBuffer;
+    std::u32string tokenBuffer;
+    std::u32string lineBuffer;
+    std::vector<LAYOUT_GLYPH> glyphBuffer;
+    // glyphs past the fixed grid (U+0100 and up)
+    TTF_Font* ttfFont;
+    long quality;
+    std::vector<ATLAS_PAGE> pages;
+    std::unordered_map<uint32_t, ATLAS_GLYPH> glyphMap;
+    unsigned long useCount;         // DrawText calls, for page eviction
+    SDF_ATLAS* sdf;                 // distance field this font was made from
 };
@@ -0,0 +1,160 @@
+#include "fontManager.h"
+#include "gameError.h"
+
+std::vector<FONT_FACE> FontManager::faces;
+std::vector<SIZED_FONT> FontManager::fonts;
+bool FontManager::initialized = false;
+
+//=============================================================================
+// Return the index of the face, loading the file if needed
+//=============================================================================
+bool FontManager::loadFace(const char* faceName, size_t& face)
+{
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        if (faces[i].name == faceName)
+        {
+            face = i;
+            return true;
+        }
+    }
+
+    FONT_FACE newFace = {};
+
+    newFace.data = SDL_LoadFile(faceName, &newFace.size);
+    if (newFace.data == NULL)
+    {
+        return false;
+    }
+
+    newFace.name = faceName;
+    faces.push_back(newFace);
+    face = faces.size() - 1;
+
+    return true;
+}
+
+//=============================================================================
+// Return a font for the face at size and style, opening it if needed
+//=============================================================================
+TTF_Font* FontManager::acquireFont(const char* faceName, float size, int style)
+{
+    if (faceName == NULL)
+    {
+        return NULL;
+    }
+
+    // Initialize the TTF library once
+    if (initialized == false)
+    {
+        if (TTF_Init() == false)
+        {
+            GameError(gameErrorNS::FATAL_ERROR,
+                "Couldn't initialize TTF: %s\n", SDL_GetError());
+
+            return NULL;
+        }
+
+        initialized = true;
+    }
+
+    size_t face = 0;
+
+    if (loadFace(faceName, face) == false)
+    {
+        if (fonts.empty())
+        {
+            releaseAll();
+        }
+
+        return NULL;
+    }
+
+    for (size_t i = 0; i < fonts.size(); i++)
+    {
+        if (fonts[i].face == face && fonts[i].size == size &&
+            fonts[i].style == style)
+        {
+            fonts[i].refCount++;
+            return fonts[i].font;
+        }
+    }
+
+    // open from the resident file, the stream is closed with the font
+    SDL_IOStream* stream = SDL_IOFromConstMem(faces[face].data, faces[face].size);
+    TTF_Font* font = TTF_OpenFontIO(stream, true, size);
+
+    if (font == NULL)
+    {
+        if (fonts.empty())
+        {
+            releaseAll();
+        }
+
+        return NULL;
+    }
+
+    TTF_SetFontStyle(font, style);
+
+    SIZED_FONT sized = {};
+
+    sized.font = font;
+    sized.face = face;
+    sized.size = size;
+    sized.style = style;
+    sized.refCount = 1;
+    fonts.push_back(sized);
+
+    return font;
+}
+
+//=============================================================================
+// Release a font returned by acquireFont()
+//=============================================================================
+void FontManager::releaseFont(TTF_Font* font)
+{
+    if (font == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < fonts.size(); i++)
+    {
+        if (fonts[i].font == font)
+        {
+            fonts[i].refCount--;
+
+            if (fonts[i].refCount <= 0)
+            {
+                TTF_CloseFont(fonts[i].font);
+                fonts.erase(fonts.begin() + i);
+            }
+
+            break;
+        }
+    }
+
+    if (fonts.empty())
+    {
+        releaseAll();
+    }
+}
+
+//=============================================================================
+// Free all faces and shut down SDL_ttf
+//=============================================================================
+void FontManager::releaseAll()
+{
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        SDL_free(faces[i].data);
+    }
+
+    faces.clear();
+
+    if (initialized == true)
+    {
+        TTF_Quit();         // Free the TTF library
+        initialized = false;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <SDL3_ttf\SDL_ttf.h>
+#include "constants.h"
+
+// Font file kept in memory so each size is opened without reading the file
+typedef struct _FONT_FACE
+{
+    std::string name;
+    void* data;
+    size_t size;
+} FONT_FACE;
+
+// TTF font opened at one size and style, shared by every Font that uses it
+typedef struct _SIZED_FONT
+{
+    TTF_Font* font;
+    size_t face;            // index into faces
+    float size;
+    int style;
+    int refCount;
+} SIZED_FONT;
+
+class FontManager
+{
+    // FontManager properties
+private:
+    static std::vector<FONT_FACE> faces;
+    static std::vector<SIZED_FONT> fonts;
+    static bool initialized;        // true while SDL_ttf is initialized
+
+    // (For internal use only. No user serviceable parts inside.)
+
+    // Return the index of the face, loading the file if needed
+    static bool loadFace(const char* faceName, size_t& face);
+
+    // Free all faces and shut down SDL_ttf
+    static void releaseAll();
+
+public:
+    // Return a font for the face at size and style, opening it if needed.
+    // Every call must be matched by releaseFont().
+    static TTF_Font* acquireFont(const char* faceName, float size, int style);
+
+    // Release a font returned by acquireFont(). SDL_ttf is shut down and the
+    // face files are freed when the last font is released.
+    static void releaseFont(TTF_Font* font);
+};
@@ -179,6 +179,12 @@ void Game::messageHandler(const SDL_Window* hwnd, const SDL_Event* msg)
             int wheely = static_cast<int>(msg->wheel.y);
             input->mouseWheelIn(wheely);
         } break;
+        case SDL_EVENT_RENDER_TARGETS_RESET:            // baked text is redrawn
+        case SDL_EVENT_RENDER_DEVICE_RESET:
+        {
+            graphics->onRenderTargetsReset();
+            return;
+        }
         case SDL_EVENT_GAMEPAD_ADDED:           // check for controller insert
         case SDL_EVENT_GAMEPAD_REMOVED:
         {
@@ -196,6 +202,9 @@ bool Game::initialize(SDL_Window* phwnd)
 {
     hwnd = phwnd;
 
+    // start the log writer, GameError messages are kept until it runs
+    Logger::initialize();
+
     // initialise graphics
     graphics = new Graphics();
 
@@ -272,8 +281,13 @@ void Game::renderGame()
         {
             // convert fps to string
             _snprintf_s(buffer, gameNS::BUF_SIZE, "fps %d ", (int)fps);
-            font.print(buffer, (int)(viewport3d.w - viewport3d.x) - 100,
-                (int)(viewport3d.h - viewport3d.y) - 28);
+
+            rect_t fpsRect = { 0 };
+            fpsRect.min.x = (viewport3d.w - viewport3d.x) - 100.0f;
+            fpsRect.min.y = (viewport3d.h - viewport3d.y) - 28.0f;
+            fpsRect.max.x = (viewport3d.w - viewport3d.x);
+            fpsRect.max.y = (viewport3d.h - viewport3d.y);
+            font.printBaked(fpsText, buffer, fpsRect, ALIGNMENT::TOP | ALIGNMENT::LEFT);
         }
 
         graphics->spriteEnd();
@@ -363,6 +377,9 @@ void Game::run(float frameTime)
         input->vibrateControllers(frameTime);           // handle controller vibration
     }
 
+    TextureManager::updateAll();            // swap in textures changed on disk
+    Logger::update(console);            // show new log lines on the console
+
     renderGame();           // draw all game items
 
     // toggle pause
@@ -454,6 +471,7 @@ void Game::consoleCommand()
     {
         console->print("Console Commands:");
         console->print("fps - toggle display of frames per second");
+        console->print("texmem - show texture memory, full vs. reduced");
 
         return;
     }
@@ -464,6 +482,16 @@ void Game::consoleCommand()
         {
             fpsOn = !fpsOn;
         }
+        else if (argv[0] == "texmem")
+        {
+            size_t fullBytes = 0;
+            size_t residentBytes = 0;
+
+            TextureManager::memoryReport(fullBytes, residentBytes);
+            console->print("textures: %u KB resident, %u KB full resolution (reduction %u)",
+                (unsigned int)(residentBytes >> 10), (unsigned int)(fullBytes >> 10),
+                graphics->getTextureReduction());
+        }
     }
     else
     {
@@ -493,6 +521,7 @@ void Game::deleteAll()
 {
     destroy();          // call destroy() in derived object
 
+    font.releaseBaked(fpsText);
     font.deleteAll();
     fontBig.deleteAll();
     fontScore.deleteAll();
@@ -503,6 +532,7 @@ void Game::deleteAll()
     SAFE_DELETE(audio);
     SAFE_DELETE(input);
     SAFE_DELETE(graphics);
+    Logger::shutdown();         // write the rest of the log
 
     initialized = false;
 }
@@ -48,6 +48,7 @@ protected:
     // Commands
     char    buffer[gameNS::BUF_SIZE];
     bool    fpsOn;         // true to display fps
+    BAKED_TEXT fpsText;         // fps display, baked until the number changes
     bool    paused;
     bool    initialized;
 
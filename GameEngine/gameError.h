@@ -1,6 +1,7 @@
 #pragma once
 #include <SDL3\SDL.h>
 #include <string>
+#include "logger.h"
 
 namespace gameErrorNS
 {
@@ -12,6 +13,7 @@ namespace gameErrorNS
 }
 
 // Game Error class. Thrown when an error is detected by the game engine.
+// The message goes to the log, which writes it to log.txt and the console.
 inline void GameError(int code, const char* format, ...)
 {
     va_list argptr;
@@ -25,11 +27,11 @@ inline void GameError(int code, const char* format, ...)
     {
     case gameErrorNS::FATAL_ERROR:
     {
-        SDL_LogError(SDL_LOG_PRIORITY_ERROR, text);
+        LOG_ERROR("%s", text);
     } break;
     case gameErrorNS::WARNING:
     {
-        SDL_LogWarn(SDL_LOG_PRIORITY_WARN, text);
+        LOG_WARNING("%s", text);
     } break;
     }
 }
\ No newline at end of file
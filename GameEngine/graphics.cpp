@@ -1,4 +1,5 @@
 #include "graphics.h"
+#include "pixelConvert.h"
 
 vector3_t Graphics::vertex0 = { 0 };
 vector3_t Graphics::vertex1 = { 0 };
@@ -8,62 +9,6 @@ SDL_FColor Graphics::colour0 = { 1, 1, 1, 1 };
 const int Graphics::ibuffer[6] = { 0, 1, 2, 2, 3, 0 };
 SDL_Vertex Graphics::vbuffer[4] = { 0 };
 
-static bool BlitBW(image_t* tex) noexcept
-{
-    void* pixels = NULL;
-    uint8_t* dst = NULL;
-    int src, src_pitch, dst_pitch, dst_bytes, src_bytes;
-    if (tex == NULL) {
-        return false;
-    }
-    if (tex->format != GEUL_LUMINANCE || tex->format != GEUL_LUMINANCE_ALPHA) {
-        return false;
-    }
-    src_bytes = (tex->format == GEUL_LUMINANCE ? 1 : 2);
-    dst_bytes = (tex->format == GEUL_LUMINANCE ? 3 : 4);
-    src_pitch = (tex->width * src_bytes);
-    dst_pitch = (tex->width * dst_bytes);
-    pixels = malloc(tex->height * dst_pitch);
-    if (pixels == NULL) {
-        return false;
-    }
-    switch (dst_bytes)
-    {
-    case 3:
-    {
-        for (uint32_t y = 0; y < tex->height; y++) {
-            src = y * src_pitch;
-            dst = ((uint8_t*)pixels + (y * dst_pitch));
-            for (uint32_t x = 0; x < tex->width; x++) {
-                dst[x*3+0] = tex->pixels[src];
-                dst[x*3+1] = tex->pixels[src];
-                dst[x*3+2] = tex->pixels[src];
-                src += src_bytes;
-            }
-        }
-    } break;
-    case 4:
-    {
-        for (uint32_t y = 0; y < tex->height; y++) {
-            src = y * src_pitch;
-            dst = ((uint8_t*)pixels + (y * dst_pitch));
-            for (uint32_t x = 0; x < tex->width; x++) {
-                dst[x*4+0] = tex->pixels[src+0];
-                dst[x*4+1] = tex->pixels[src+0];
-                dst[x*4+2] = tex->pixels[src+0];
-                dst[x*4+3] = tex->pixels[src+1];
-                src += src_bytes;
-            }
-        }
-    } break;
-    }
-    free(tex->pixels);
-    tex->pixels = (uint8_t*)pixels;
-    tex->depth = dst_bytes * 8;
-    tex->format = (tex->format == GEUL_LUMINANCE) ? GEUL_RGB : GEUL_RGBA;
-    return true;
-}
-
 //=============================================================================
 // Constructor
 //=============================================================================
@@ -105,6 +50,15 @@ Graphics::Graphics()
     width = 0;         // width & height are replaced in initialize()
     height = 0;
     backColor = graphicsNS::BACK_COLOR;
+    // Sprite batch
+    batchTexture = NULL;
+    // Render targets
+    targetGeneration = 0;
+    targetOrigin = Vector2();
+    // Texture loading
+    premultipliedAlpha = PREMULTIPLIED_ALPHA;
+    textureReduction = SDL_min(TEXTURE_REDUCTION, graphicsNS::MAX_TEXTURE_REDUCTION);
+    stagingLock = SDL_CreateMutex();
 }
 
 //=============================================================================
@@ -113,6 +67,7 @@ Graphics::Graphics()
 Graphics::~Graphics()
 {
     releaseAll();
+    SDL_DestroyMutex(stagingLock);
 }
 
 //=============================================================================
@@ -125,6 +80,17 @@ void Graphics::releaseAll()
         SDL_DestroyTexture(depthStencilBuffer);
         depthStencilBuffer = NULL;
     }
+
+    SDL_LockMutex(stagingLock);
+
+    for (size_t i = 0; i < stagingPool.size(); i++)
+    {
+        free(stagingPool[i].pBits);
+    }
+
+    stagingPool.clear();
+
+    SDL_UnlockMutex(stagingLock);
 }
 
 //=============================================================================
@@ -386,6 +352,8 @@ void Graphics::changeDisplayMode(graphicsNS::DISPLAY_MODE mode)
 //=============================================================================
 bool Graphics::showBackbuffer()
 {
+    flushBatch();
+
     // Display backbuffer to screen
     SDL_RenderPresent(renderer2d);
 
@@ -393,197 +361,301 @@ bool Graphics::showBackbuffer()
 }
 
 //=============================================================================
-// Frees the data associated with this texture
+// Create a texture that can be drawn into
 //=============================================================================
-void Graphics::freeTexture(LP_TEXTURE texture)
+bool Graphics::createRenderTarget(int width, int height, LP_TEXTURE& texture)
 {
-    SDL_DestroyTexture(texture);
+    texture = SDL_CreateTexture(renderer2d, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET, width, height);
+
+    if (texture == NULL)
+    {
+        GameError(gameErrorNS::WARNING, "Error creating render target.\n");
+        return false;
+    }
+
+    // drawing with alpha blending into a cleared target leaves
+    // premultiplied pixels
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND_PREMULTIPLIED);
+    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_LINEAR);
+
+    return true;
 }
 
 //=============================================================================
-// Load the texture into default SDL memory (normal texture use)
-// For internal engine use only. Use the TextureManager class to load game
-// textures.
+// Redirect drawing to texture and clear it to transparent black
 //=============================================================================
-bool Graphics::loadTexture(const char* filename, COLOR_ARGB transcolor,
-    unsigned int& width, unsigned int& height, LP_TEXTURE& texture)
+bool Graphics::beginRenderTarget(LP_TEXTURE texture, float x, float y)
 {
-    // create surface
-    image_t image = { 0 };
-    bool result = false;
+    flushBatch();           // queued sprites belong to the previous target
 
-    result = GetImageInfoFromFile(&image, filename);
+    RENDER_TARGET previous;
 
-    if (result == false)
+    previous.texture = SDL_GetRenderTarget(renderer2d);
+    previous.origin = targetOrigin;
+
+    if (SDL_SetRenderTarget(renderer2d, texture) == false)
     {
-        texture = NULL;
         return false;
     }
 
-    width = image.width;
-    height = image.height;
+    targetStack.push_back(previous);
+    targetOrigin = Vector2(x, y);
 
-    uint8_t colorkey[4] = {
-        (uint8_t)(transcolor.b * 255.0f),
-        (uint8_t)(transcolor.g * 255.0f),
-        (uint8_t)(transcolor.r * 255.0f),
-        (uint8_t)(transcolor.a * 255.0f)
-    };
+    SDL_SetRenderDrawColorFloat(renderer2d, 0.0f, 0.0f, 0.0f, 0.0f);
+    SDL_RenderClear(renderer2d);
+
+    return true;
+}
+
+//=============================================================================
+// Return drawing to the previous target, the backbuffer when none is left
+//=============================================================================
+bool Graphics::endRenderTarget()
+{
+    flushBatch();
 
-    result = LoadImageFromFile(&image, NULL, colorkey, filename);
-    if (result == false)
+    RENDER_TARGET previous = { NULL };
+
+    if (targetStack.empty() == false)
     {
-        texture = NULL;
-        return false;
+        previous = targetStack.back();
+        targetStack.pop_back();
     }
 
-    SDL_PixelFormat pixelformat = SDL_PIXELFORMAT_UNKNOWN;
-    switch (image.format)
-    {
-    case GEUL_COLOUR_INDEX:
-    {
-        pixelformat = SDL_PIXELFORMAT_INDEX8;
-    } break;
-    case GEUL_RGB:
-    {
-        pixelformat = SDL_PIXELFORMAT_RGB24;
-    } break;
-    case GEUL_RGBA:
-    {
-        pixelformat = SDL_PIXELFORMAT_RGBA32;
-    } break;
-    case GEUL_BGR:
-    {
-        pixelformat = SDL_PIXELFORMAT_BGR24;
-    } break;
-    case GEUL_BGRA:
-    {
-        pixelformat = SDL_PIXELFORMAT_BGRA32;
-    } break;
-    case GEUL_LUMINANCE:
-    {
-        if (BlitBW(&image) == false) {
-            free(image.pixels);
-            return false;
-        }
-        pixelformat = SDL_PIXELFORMAT_RGB24;
-    } break;
-    case GEUL_LUMINANCE_ALPHA:
+    targetOrigin = previous.origin;
+
+    return SDL_SetRenderTarget(renderer2d, previous.texture);
+}
+
+//=============================================================================
+// Render target contents were lost (SDL_EVENT_RENDER_TARGETS_RESET)
+//=============================================================================
+void Graphics::onRenderTargetsReset()
+{
+    targetGeneration++;
+}
+
+//=============================================================================
+// Frees the data associated with this texture
+// Queued sprites that use the texture are drawn first.
+//=============================================================================
+void Graphics::freeTexture(LP_TEXTURE texture)
+{
+    if (texture != NULL && texture == batchTexture)
     {
-        if (BlitBW(&image) == false) {
-            free(image.pixels);
-            return false;
-        }
-        pixelformat = SDL_PIXELFORMAT_RGBA32;
-    } break;
-    default:
+        flushBatch();
+    }
+
+    fullSizes.erase(texture);
+    SDL_DestroyTexture(texture);
+}
+
+//=============================================================================
+// Set the blend and scale mode of a texture to match the alpha mode.
+// Premultiplied textures filter without dark fringes so use linear scaling.
+//=============================================================================
+bool Graphics::setTextureBlendMode(LP_TEXTURE texture)
+{
+    if (premultipliedAlpha == false)
     {
-        free(image.pixels);
-        return false;
-    } break;
+        return SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
     }
 
-    // create the new texture
-    texture = SDL_CreateTexture(renderer2d, pixelformat, SDL_TEXTUREACCESS_STATIC,
-        width, height);
-    if (texture == NULL)
+    return SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND_PREMULTIPLIED) &&
+        SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_LINEAR);
+}
+
+//=============================================================================
+// Return a staging buffer of at least size bytes from the pool.
+// The pool is shared with loader threads and is guarded by stagingLock.
+//=============================================================================
+void* Graphics::acquireStaging(size_t size)
+{
+    void* pBits = NULL;
+
+    SDL_LockMutex(stagingLock);
+
+    // reuse a free buffer that is already big enough
+    for (size_t i = 0; i < stagingPool.size() && pBits == NULL; i++)
     {
-        return false;
+        if (stagingPool[i].inUse == false && stagingPool[i].size >= size)
+        {
+            stagingPool[i].inUse = true;
+            pBits = stagingPool[i].pBits;
+        }
     }
 
-    LOCKED_RECT pLockedRect = { 0 };
+    // grow a free buffer
+    for (size_t i = 0; i < stagingPool.size() && pBits == NULL; i++)
+    {
+        if (stagingPool[i].inUse == false)
+        {
+            void* pGrown = realloc(stagingPool[i].pBits, size);
+            if (pGrown == NULL)
+            {
+                break;
+            }
 
-    pLockedRect.pBits = image.pixels;
-    pLockedRect.pitch = image.width * (image.depth >> 3);
+            stagingPool[i].pBits = pGrown;
+            stagingPool[i].size = size;
+            stagingPool[i].inUse = true;
+            pBits = pGrown;
+        }
+    }
 
-    if (SDL_UpdateTexture(texture, NULL, pLockedRect.pBits, pLockedRect.pitch) ==
-        false)
+    if (pBits == NULL)
     {
-        SDL_DestroyTexture(texture);
+        STAGING_BUFFER staging = { 0 };
 
-        return false;
+        staging.pBits = malloc(size);
+        if (staging.pBits != NULL)
+        {
+            staging.size = size;
+            staging.inUse = true;
+            stagingPool.push_back(staging);
+            pBits = staging.pBits;
+        }
     }
 
-    free(image.pixels);
+    SDL_UnlockMutex(stagingLock);
 
-    return true;
+    return pBits;
 }
 
 //=============================================================================
-// Load the texture into system memory (system memory is lockable)
-// Provides direct access to pixel data. Use the TextureManager class to load
-// textures for display.
+// Return a staging buffer to the pool.
 //=============================================================================
-bool Graphics::loadTextureSystemMem(const char* filename, COLOR_ARGB transcolor,
-    unsigned int& width, unsigned int& height, LP_TEXTURE& texture)
+void Graphics::releaseStaging(void* pBits)
 {
-    // create surface
-    image_t image = { 0 };
-    bool result = false;
+    if (pBits == NULL)
+    {
+        return;
+    }
 
-    result = GetImageInfoFromFile(&image, filename);
+    SDL_LockMutex(stagingLock);
 
-    if (result == false)
+    for (size_t i = 0; i < stagingPool.size(); i++)
     {
-        texture = NULL;
-        return false;
+        if (stagingPool[i].pBits == pBits)
+        {
+            stagingPool[i].inUse = false;
+
+            // trim the pool back to its limit
+            if (stagingPool.size() > graphicsNS::MAX_STAGING_BUFFERS)
+            {
+                free(stagingPool[i].pBits);
+                stagingPool.erase(stagingPool.begin() + i);
+            }
+
+            break;
+        }
     }
 
-    width = image.width;
-    height = image.height;
+    SDL_UnlockMutex(stagingLock);
+}
 
-    uint8_t colorkey[4] = {
-        (uint8_t)(transcolor.b * 255.0f),
-        (uint8_t)(transcolor.g * 255.0f),
+//=============================================================================
+// Decode an image file into RGBA32 (or INDEX8) pixels ready for upload.
+// LoadImageFromFile parses the header itself so the file is only read once.
+// RGBA32 images are box filtered to half size reduction times.
+// Does not touch the renderer, so it may be called from a loader thread.
+//=============================================================================
+bool Graphics::decodeTexture(const char* filename, COLOR_ARGB transcolor,
+    DECODED_IMAGE& decoded, unsigned int reduction, bool premultiplied)
+{
+    image_t image = { 0 };
+    uint8_t* staging = NULL;
+
+    SDL_memset(&decoded, 0, sizeof(DECODED_IMAGE));
+
+    // colour key in RGBA32 byte order, only red, green and blue are compared
+    const uint8_t colorkey[4] = {
         (uint8_t)(transcolor.r * 255.0f),
+        (uint8_t)(transcolor.g * 255.0f),
+        (uint8_t)(transcolor.b * 255.0f),
         (uint8_t)(transcolor.a * 255.0f)
     };
+    const uint8_t keymask[4] = { 0xFF, 0xFF, 0xFF, 0x00 };
 
-    result = LoadImageFromFile(&image, NULL, colorkey, filename);
-    if (result == false)
+    // the colour key is applied after conversion, not by the loader
+    if (LoadImageFromFile(&image, NULL, NULL, filename) == false)
     {
-        texture = NULL;
         return false;
     }
 
-    SDL_PixelFormat pixelformat = SDL_PIXELFORMAT_UNKNOWN;
+    // indexed images stay INDEX8, so their palette entry is keyed by the
+    // loader instead, which needs the file read again with the key
+    if (image.format == GEUL_COLOUR_INDEX && transcolor.a != 0.0f)
+    {
+        uint8_t loaderkey[4] = {
+            (uint8_t)(transcolor.b * 255.0f),
+            (uint8_t)(transcolor.g * 255.0f),
+            (uint8_t)(transcolor.r * 255.0f),
+            (uint8_t)(transcolor.a * 255.0f)
+        };
+
+        free(image.pixels);
+        SDL_memset(&image, 0, sizeof(image));
+
+        if (LoadImageFromFile(&image, NULL, loaderkey, filename) == false)
+        {
+            return false;
+        }
+    }
+
+    const size_t count = (size_t)image.width * image.height;
+    SDL_PixelFormat pixelformat = SDL_PIXELFORMAT_RGBA32;
+
+    // convert to RGBA, 32-bit formats are converted in place
     switch (image.format)
     {
     case GEUL_COLOUR_INDEX:
     {
         pixelformat = SDL_PIXELFORMAT_INDEX8;
     } break;
-    case GEUL_RGB:
-    {
-        pixelformat = SDL_PIXELFORMAT_RGB24;
-    } break;
     case GEUL_RGBA:
     {
-        pixelformat = SDL_PIXELFORMAT_RGBA32;
-    } break;
-    case GEUL_BGR:
-    {
-        pixelformat = SDL_PIXELFORMAT_BGR24;
     } break;
     case GEUL_BGRA:
     {
-        pixelformat = SDL_PIXELFORMAT_BGRA32;
+        PixelSwapRB32(image.pixels, image.pixels, count);
     } break;
+    case GEUL_RGB:
+    case GEUL_BGR:
     case GEUL_LUMINANCE:
-    {
-        if (BlitBW(&image) == false) {
-            free(image.pixels);
-            return false;
-        }
-        pixelformat = SDL_PIXELFORMAT_RGB24;
-    } break;
     case GEUL_LUMINANCE_ALPHA:
     {
-        if (BlitBW(&image) == false) {
+        staging = (uint8_t*)acquireStaging(count * 4);
+        if (staging == NULL)
+        {
             free(image.pixels);
             return false;
         }
-        pixelformat = SDL_PIXELFORMAT_RGBA32;
+
+        switch (image.format)
+        {
+        case GEUL_BGR:
+        {
+            PixelSwapRB24(image.pixels, image.pixels, count);
+            PixelRGBToRGBA(image.pixels, staging, count);
+        } break;
+        case GEUL_RGB:
+        {
+            PixelRGBToRGBA(image.pixels, staging, count);
+        } break;
+        case GEUL_LUMINANCE:
+        {
+            PixelLuminanceToRGBA(image.pixels, staging, count);
+        } break;
+        default:
+        {
+            PixelLuminanceAlphaToRGBA(image.pixels, staging, count);
+        } break;
+        }
+
+        free(image.pixels);         // decoded copy is no longer needed
+        image.pixels = staging;
     } break;
     default:
     {
@@ -592,29 +664,188 @@ bool Graphics::loadTextureSystemMem(const char* filename, COLOR_ARGB transcolor,
     } break;
     }
 
-    // create the new texture
-    texture = SDL_CreateTexture(renderer2d, pixelformat, SDL_TEXTUREACCESS_STREAMING,
-        width, height);
+    if (pixelformat == SDL_PIXELFORMAT_RGBA32)
+    {
+        image.format = GEUL_RGBA;
+        image.depth = 32;
 
-    if (texture == NULL)
+        if (transcolor.a != 0.0f)
+        {
+            uint32_t key = 0;
+            uint32_t mask = 0;
+
+            SDL_memcpy(&key, colorkey, sizeof(key));
+            SDL_memcpy(&mask, keymask, sizeof(mask));
+            PixelColorKey((uint32_t*)image.pixels, count, key, mask);
+        }
+
+        if (premultiplied == true)
+        {
+            PixelPremultiplyAlpha(image.pixels, count);
+        }
+    }
+
+    decoded.width = image.width;
+    decoded.height = image.height;
+
+    // reduce in place, the buffer keeps its original allocation
+    if (pixelformat == SDL_PIXELFORMAT_RGBA32)
     {
-        return false;
+        for (unsigned int i = 0; i < reduction &&
+            (image.width > 1 || image.height > 1); i++)
+        {
+            PixelBoxFilterHalf32(image.pixels, image.pixels, image.width,
+                image.height);
+            image.width = (image.width > 1) ? image.width >> 1 : 1;
+            image.height = (image.height > 1) ? image.height >> 1 : 1;
+        }
     }
 
+    decoded.image = image;
+    decoded.format = pixelformat;
+    decoded.staged = (staging != NULL);
+
+    return true;
+}
+
+//=============================================================================
+// Create a texture from decoded pixels, must be called on the render thread.
+// The decoded pixels are released unless pImage is not NULL, in which case
+// the caller owns pImage->pixels and must free() it.
+//=============================================================================
+bool Graphics::uploadTexture(DECODED_IMAGE& decoded, SDL_TextureAccess access,
+    LP_TEXTURE& texture, image_t* pImage)
+{
+    image_t& image = decoded.image;
+    bool result = false;
+
     LOCKED_RECT pLockedRect = { 0 };
 
     pLockedRect.pBits = image.pixels;
     pLockedRect.pitch = image.width * (image.depth >> 3);
 
-    if (SDL_UpdateTexture(texture, NULL, pLockedRect.pBits, pLockedRect.pitch) ==
-        false)
+    // create the new texture
+    texture = SDL_CreateTexture(renderer2d, decoded.format, access, image.width,
+        image.height);
+    result = (texture != NULL);
+
+    if (result == true)
+    {
+        // the palette of an indexed image keeps straight alpha
+        result = SDL_UpdateTexture(texture, NULL, pLockedRect.pBits,
+            pLockedRect.pitch) &&
+            ((decoded.format == SDL_PIXELFORMAT_INDEX8) ?
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) :
+            setTextureBlendMode(texture));
+
+        // remember the full size so source rectangles stay in full
+        // resolution coordinates
+        if (result == true && (decoded.width != (unsigned int)image.width ||
+            decoded.height != (unsigned int)image.height))
+        {
+            fullSizes[texture] = Vector2((float)decoded.width,
+                (float)decoded.height);
+        }
+
+        if (result == false)
+        {
+            SDL_DestroyTexture(texture);
+            texture = NULL;
+        }
+    }
+
+    if (result == true && pImage != NULL)
     {
-        SDL_DestroyTexture(texture);
+        // caller asked for a CPU copy, hand over the pixels
+        *pImage = image;
+
+        if (decoded.staged == true)
+        {
+            const size_t size = pLockedRect.pitch * image.height;
+
+            pImage->pixels = (uint8_t*)malloc(size);
+            if (pImage->pixels != NULL)
+            {
+                SDL_memcpy(pImage->pixels, image.pixels, size);
+            }
+
+            releaseStaging(image.pixels);
+        }
 
+        SDL_memset(&decoded, 0, sizeof(DECODED_IMAGE));
+    }
+    else
+    {
+        freeDecodedImage(decoded);
+    }
+
+    return result;
+}
+
+//=============================================================================
+// Release decoded pixels that were not uploaded.
+//=============================================================================
+void Graphics::freeDecodedImage(DECODED_IMAGE& decoded)
+{
+    if (decoded.staged == true)
+    {
+        releaseStaging(decoded.image.pixels);
+    }
+    else
+    {
+        free(decoded.image.pixels);
+    }
+
+    SDL_memset(&decoded, 0, sizeof(DECODED_IMAGE));
+}
+
+//=============================================================================
+// Load the texture into default SDL memory (normal texture use)
+// For internal engine use only. Use the TextureManager class to load game
+// textures.
+//=============================================================================
+bool Graphics::loadTexture(const char* filename, COLOR_ARGB transcolor,
+    unsigned int& width, unsigned int& height, LP_TEXTURE& texture)
+{
+    DECODED_IMAGE decoded = { 0 };
+
+    texture = NULL;
+
+    if (decodeTexture(filename, transcolor, decoded, textureReduction,
+        premultipliedAlpha) == false)
+    {
         return false;
     }
 
-    return true;
+    width = decoded.width;
+    height = decoded.height;
+
+    return uploadTexture(decoded, SDL_TEXTUREACCESS_STATIC, texture);
+}
+
+//=============================================================================
+// Load the texture into system memory (system memory is lockable)
+// Provides direct access to pixel data. Use the TextureManager class to load
+// textures for display.
+//=============================================================================
+bool Graphics::loadTextureSystemMem(const char* filename, COLOR_ARGB transcolor,
+    unsigned int& width, unsigned int& height, LP_TEXTURE& texture,
+    image_t* pImage)
+{
+    DECODED_IMAGE decoded = { 0 };
+
+    texture = NULL;
+
+    if (decodeTexture(filename, transcolor, decoded, 0,
+        premultipliedAlpha) == false)
+    {
+        return false;
+    }
+
+    width = decoded.width;
+    height = decoded.height;
+
+    return uploadTexture(decoded, SDL_TEXTUREACCESS_STREAMING, texture, pImage);
 }
 
 //=============================================================================
@@ -747,18 +978,27 @@ void Graphics::drawQuad(const vector3_t* quadList[4], unsigned long quadListCoun
 }
 
 //=============================================================================
-// Display a sprite textured (rectangle) with alpha transparency.
+// Build the four vertices of a sprite quad.
 //=============================================================================
-void Graphics::drawSprite(LP_TEXTURE texture, const rect_t* psrcrect,
+void Graphics::spriteVertices(LP_TEXTURE texture, const rect_t* psrcrect,
     const vector3_t p0, const vector3_t p1,
     const vector3_t p2, const vector3_t p3,
-    COLOR_ARGB color)
+    COLOR_ARGB color, SDL_Vertex* pVertices)
 {
     rect_t rect = { 0 };
     float width = 1.0f;
     float height = 1.0f;
     if (texture != NULL) {
         SDL_GetTextureSize(texture, &width, &height);
+        if (fullSizes.empty() == false) {
+            // reduced textures are addressed in full resolution coordinates
+            std::unordered_map<LP_TEXTURE, vector2_t>::const_iterator full =
+                fullSizes.find(texture);
+            if (full != fullSizes.end()) {
+                width = full->second.x;
+                height = full->second.y;
+            }
+        }
     }
     if (psrcrect != NULL) {
         rect = {
@@ -778,38 +1018,130 @@ void Graphics::drawSprite(LP_TEXTURE texture, const rect_t* psrcrect,
     vertex1 = TransformVector3Coord(p1, transform3d);
     vertex2 = TransformVector3Coord(p2, transform3d);
     vertex3 = TransformVector3Coord(p3, transform3d);
-    colour0 = {
-        color.r,
-        color.g,
-        color.b,
-        color.a
-    };
-    vbuffer[0] = {
+    vertex0.x -= targetOrigin.x;
+    vertex0.y -= targetOrigin.y;
+    vertex1.x -= targetOrigin.x;
+    vertex1.y -= targetOrigin.y;
+    vertex2.x -= targetOrigin.x;
+    vertex2.y -= targetOrigin.y;
+    vertex3.x -= targetOrigin.x;
+    vertex3.y -= targetOrigin.y;
+    // untextured quads blend with the draw mode, which is only premultiplied
+    // inside spriteBegin, and indexed textures are never premultiplied
+    SDL_BlendMode blendMode = SDL_BLENDMODE_NONE;
+    if (texture != NULL) {
+        SDL_GetTextureBlendMode(texture, &blendMode);
+    } else {
+        SDL_GetRenderDrawBlendMode(renderer2d, &blendMode);
+    }
+    if (blendMode == SDL_BLENDMODE_BLEND_PREMULTIPLIED)
+    {
+        // tint must be premultiplied to match the texture
+        colour0 = {
+            color.r * color.a,
+            color.g * color.a,
+            color.b * color.a,
+            color.a
+        };
+    }
+    else
+    {
+        colour0 = {
+            color.r,
+            color.g,
+            color.b,
+            color.a
+        };
+    }
+    pVertices[0] = {
         { vertex0.x, vertex0.y },
         { colour0 },
         { s0, t0  }
     };
-    vbuffer[1] = {
+    pVertices[1] = {
         { vertex1.x, vertex1.y },
         { colour0 },
         { s1, t0  }
     };
-    vbuffer[2] = {
+    pVertices[2] = {
         { vertex2.x, vertex2.y },
         { colour0 },
         { s1, t1  }
     };
-    vbuffer[3] = {
+    pVertices[3] = {
         { vertex3.x, vertex3.y },
         { colour0 },
         { s0, t1  }
     };
+}
+
+//=============================================================================
+// Display a sprite textured (rectangle) with alpha transparency.
+//=============================================================================
+void Graphics::drawSprite(LP_TEXTURE texture, const rect_t* psrcrect,
+    const vector3_t p0, const vector3_t p1,
+    const vector3_t p2, const vector3_t p3,
+    COLOR_ARGB color)
+{
+    flushBatch();           // keep draw order with queued sprites
+    spriteVertices(texture, psrcrect, p0, p1, p2, p3, color, vbuffer);
     SDL_RenderGeometry(renderer2d, texture,
         vbuffer, sizeof(vbuffer) / sizeof(vbuffer[0]),
         ibuffer, sizeof(ibuffer) / sizeof(ibuffer[0])
     );
 }
 
+//=============================================================================
+// Queue a textured sprite. Queued sprites that share a texture are drawn
+// with a single SDL_RenderGeometry call by flushBatch().
+//=============================================================================
+void Graphics::batchSprite(LP_TEXTURE texture, const rect_t* psrcrect,
+    const vector3_t p0, const vector3_t p1,
+    const vector3_t p2, const vector3_t p3,
+    COLOR_ARGB color)
+{
+    if (texture != batchTexture ||
+        batchVertices.size() >= graphicsNS::MAX_BATCH_SPRITES * 4)
+    {
+        flushBatch();
+        batchTexture = texture;
+    }
+
+    const int base = (int)batchVertices.size();
+
+    batchVertices.resize(base + 4);
+    spriteVertices(texture, psrcrect, p0, p1, p2, p3, color,
+        &batchVertices[base]);
+
+    for (int i = 0; i < 6; i++)
+    {
+        batchIndices.push_back(base + ibuffer[i]);
+    }
+}
+
+//=============================================================================
+// Draw the queued sprites
+//=============================================================================
+bool Graphics::flushBatch()
+{
+    bool result = true;
+
+    if (batchVertices.empty() == false)
+    {
+        result = SDL_RenderGeometry(renderer2d, batchTexture,
+            batchVertices.data(), (int)batchVertices.size(),
+            batchIndices.data(), (int)batchIndices.size());
+
+        // clear keeps the capacity for the next batch
+        batchVertices.clear();
+        batchIndices.clear();
+    }
+
+    batchTexture = NULL;
+
+    return result;
+}
+
 //=============================================================================
 // Draw the sprite described in SpriteData structure
 // Color is optional, it is applied like a filter, WHITE is default (no change)
@@ -914,6 +1246,30 @@ bool Graphics::getFullscreen() const
     return fullscreen;
 }
 
+//=============================================================================
+// Returns the number of times loaded textures are halved
+//=============================================================================
+unsigned int Graphics::getTextureReduction() const
+{
+    return textureReduction;
+}
+
+//=============================================================================
+// Returns true if textures use premultiplied alpha
+//=============================================================================
+bool Graphics::getPremultipliedAlpha() const
+{
+    return premultipliedAlpha;
+}
+
+//=============================================================================
+// Returns a count that changes whenever render target contents are lost
+//=============================================================================
+unsigned int Graphics::getTargetGeneration() const
+{
+    return targetGeneration;
+}
+
 //=============================================================================
 // Returns true if the graphics card supports a stencil buffer
 //=============================================================================
@@ -956,6 +1312,24 @@ void Graphics::setVSync(bool vs)
     vsync = vs;
 }
 
+//=============================================================================
+// Set texture reduction (low-memory mode)
+// Textures already loaded keep their size, call before loading textures.
+//=============================================================================
+void Graphics::setTextureReduction(unsigned int reduction)
+{
+    textureReduction = SDL_min(reduction, graphicsNS::MAX_TEXTURE_REDUCTION);
+}
+
+//=============================================================================
+// Set premultiplied alpha
+// Textures already loaded are not converted, call before loading textures.
+//=============================================================================
+void Graphics::setPremultipliedAlpha(bool premultiplied)
+{
+    premultipliedAlpha = premultiplied;
+}
+
 //=============================================================================
 // Set color used to clear screen
 //=============================================================================
@@ -1039,7 +1413,8 @@ bool Graphics::spriteBegin(long Flags)
     {
         if ((Flags & SPRITE_ALPHABLEND) == SPRITE_ALPHABLEND)
         {
-            SDL_SetRenderDrawBlendMode(renderer2d, SDL_BLENDMODE_BLEND);
+            SDL_SetRenderDrawBlendMode(renderer2d, (premultipliedAlpha == true) ?
+                SDL_BLENDMODE_BLEND_PREMULTIPLIED : SDL_BLENDMODE_BLEND);
         }
     }
 
@@ -1068,5 +1443,7 @@ bool Graphics::spriteEnd()
 //=============================================================================
 bool Graphics::Flush()
 {
+    flushBatch();
+
     return SDL_FlushRenderer(renderer2d);
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
+#include <vector>
+#include <unordered_map>
 #include <SDL3\SDL.h>
 #include <GEUL\g_geul.h>
 #include "constants.h"
@@ -53,6 +55,10 @@ namespace graphicsNS
     const COLOR_ARGB TRANSCOLOR = SETCOLOR_ARGB(255, 255,   0, 255);  // transparent color (magenta)
 
     enum DISPLAY_MODE { DISPLAYMODE_TOGGLE, DISPLAYMODE_FULLSCREEN, DISPLAYMODE_WINDOW };
+
+    const int MAX_STAGING_BUFFERS = 4;          // staging buffers kept for reuse
+    const unsigned int MAX_TEXTURE_REDUCTION = 2;   // quarter resolution
+    const size_t MAX_BATCH_SPRITES = 4096;      // queued sprites before a flush
 }
 
 // Texture locked rectangle
@@ -62,6 +68,31 @@ typedef struct _LOCKED_RECT
     void* pBits;
 } LOCKED_RECT;
 
+// Reusable pixel staging buffer
+typedef struct _STAGING_BUFFER
+{
+    size_t size;
+    void* pBits;
+    bool inUse;
+} STAGING_BUFFER;
+
+// Render target replaced by Graphics::beginRenderTarget
+typedef struct _RENDER_TARGET
+{
+    LP_TEXTURE texture;     // NULL for the backbuffer
+    vector2_t origin;
+} RENDER_TARGET;
+
+// Decoded image waiting to be uploaded to a texture
+typedef struct _DECODED_IMAGE
+{
+    image_t image;
+    SDL_PixelFormat format;
+    bool staged;            // pixels belong to the staging pool
+    unsigned int width;     // full resolution size, image may be reduced
+    unsigned int height;
+} DECODED_IMAGE;
+
 typedef struct _VERTEX
 {
     vector4_t     position;         // Vertex position
@@ -130,6 +161,19 @@ private:
     static SDL_FColor colour0;
     static const int ibuffer[6];
     static SDL_Vertex vbuffer[4];
+    LP_TEXTURE batchTexture;        // texture of the queued sprites
+    std::vector<SDL_Vertex> batchVertices;
+    std::vector<int> batchIndices;
+    // Render targets
+    unsigned int targetGeneration;  // changes when targets lose their pixels
+    vector2_t targetOrigin;         // screen position of the target's top left
+    std::vector<RENDER_TARGET> targetStack;     // targets to return to
+    // Texture loading
+    bool premultipliedAlpha;        // textures are premultiplied at load time
+    unsigned int textureReduction;  // textures are halved this many times
+    std::unordered_map<LP_TEXTURE, vector2_t> fullSizes;    // full size of reduced textures
+    std::vector<STAGING_BUFFER> stagingPool;            // reusable pixel buffers
+    SDL_Mutex* stagingLock;         // textures may be decoded on other threads
 
     // Presentation parameters
     int backBufferWidth;
@@ -158,6 +202,18 @@ private:
     // Initialize SDL presentation parameters
     void initSDLpp();
 
+    // Return a staging buffer of at least size bytes from the pool.
+    void* acquireStaging(size_t size);
+
+    // Return a staging buffer to the pool.
+    void releaseStaging(void* pBits);
+
+    // Build the four vertices of a sprite quad.
+    void spriteVertices(LP_TEXTURE texture, const rect_t* psrcrect,
+        const vector3_t p0, const vector3_t p1,
+        const vector3_t p2, const vector3_t p3,
+        COLOR_ARGB color, SDL_Vertex* pVertices);
+
 public:
     // Constructor
     Graphics();
@@ -194,14 +250,36 @@ public:
     // Frees the data associated with this texture
     void freeTexture(LP_TEXTURE texture);
 
+    // Set the blend and scale mode of a texture to match the alpha mode.
+    bool setTextureBlendMode(LP_TEXTURE texture);
+
+    // Decode an image file into pixels ready for upload, halving it reduction
+    // times and premultiplying alpha if premultiplied. Indexed images keep
+    // straight alpha and are blended that way. Reads no Graphics
+    // state, so it is safe to call from any thread. Release with
+    // uploadTexture() or freeDecodedImage().
+    bool decodeTexture(const char* filename, COLOR_ARGB transcolor,
+        DECODED_IMAGE& decoded, unsigned int reduction, bool premultiplied);
+
+    // Create a texture from decoded pixels and release them. If pImage is not
+    // NULL it receives the pixels instead, the caller must free() them.
+    bool uploadTexture(DECODED_IMAGE& decoded, SDL_TextureAccess access,
+        LP_TEXTURE& texture, image_t* pImage = NULL);
+
+    // Release decoded pixels that were not uploaded.
+    void freeDecodedImage(DECODED_IMAGE& decoded);
+
     // Load the texture into default SDL memory (normal texture use)
     bool loadTexture(const char* filename, COLOR_ARGB transcolor,
         unsigned int& width, unsigned int& height, LP_TEXTURE& texture);
 
     // Load the texture into system memory (system memory is lockable)
     // Provides direct access to pixel data.
+    // If pImage is not NULL it receives a CPU copy of the pixels (e.g. for a
+    // collision mask), the caller must free() pImage->pixels.
     bool loadTextureSystemMem(const char* filename, COLOR_ARGB transcolor,
-        unsigned int& width, unsigned int& height, LP_TEXTURE& texture);
+        unsigned int& width, unsigned int& height, LP_TEXTURE& texture,
+        image_t* pImage = NULL);
 
     // Draw pixel at (x, y). 
     //      color defaults to graphicsNS::WHITE.
@@ -245,6 +323,32 @@ public:
         unsigned long rectListCount, const vector3_t* spriteList[4],
         unsigned long spriteListCount, COLOR_ARGB color = graphicsNS::WHITE);
 
+    // Queue a sprite, consecutive sprites with the same texture are drawn
+    // together. The queue is drawn by flushBatch(), drawSprite(), Flush(),
+    // spriteEnd() or showBackbuffer().
+    void batchSprite(LP_TEXTURE texture, const rect_t* srcrect,
+        const vector3_t p0, const vector3_t p1,
+        const vector3_t p2, const vector3_t p3,
+        COLOR_ARGB color = graphicsNS::WHITE);
+
+    // Draw queued sprites with one SDL_RenderGeometry call.
+    bool flushBatch();
+
+    // Create a texture that can be drawn into. Its pixels are premultiplied
+    // by alpha whatever the alpha mode, so it is blended as premultiplied.
+    bool createRenderTarget(int width, int height, LP_TEXTURE& texture);
+
+    // Redirect drawing to texture and clear it to transparent black.
+    // Sprites, quads and text keep their screen coordinates, (x, y) is the
+    // screen position that lands on the texture's top left. Calls may nest.
+    bool beginRenderTarget(LP_TEXTURE texture, float x = 0.0f, float y = 0.0f);
+
+    // Return drawing to the target that was current before beginRenderTarget.
+    bool endRenderTarget();
+
+    // Render target contents were lost, see getTargetGeneration().
+    void onRenderTargetsReset();
+
     // Return the number of pixels colliding between the two sprites.
     // Pre: The device supports a stencil buffer and pOcclusionQuery points to
     // a valid occlusionQuery object.
@@ -279,6 +383,16 @@ public:
     // Return fullscreen
     bool getFullscreen() const;
 
+    // Returns true if textures use premultiplied alpha
+    bool getPremultipliedAlpha() const;
+
+    // Returns the number of times loaded textures are halved
+    unsigned int getTextureReduction() const;
+
+    // Returns a count that changes whenever render target contents are lost,
+    // targets drawn under an older count must be redrawn
+    unsigned int getTargetGeneration() const;
+
     // Returns true if the graphics card supports a stencil buffer
     bool getStencilSupport() const;
 
@@ -288,6 +402,13 @@ public:
     // Set VSync
     void setVSync(bool vsync);
 
+    // Set premultiplied alpha, call before any textures are loaded
+    void setPremultipliedAlpha(bool premultiplied);
+
+    // Set texture reduction (low-memory mode), call before any textures are
+    // loaded. 0 full, 1 half, 2 quarter resolution.
+    void setTextureReduction(unsigned int reduction);
+
     // Set color used to clear screen
     void setBackColor(COLOR_ARGB c);
 
@@ -59,15 +59,10 @@ void InputDialog::prepareVerts()
 }
 
 //=============================================================================
-// Draw the InputDialog
+// Draw the InputDialog, called by MessageDialog::draw() when it changed
 //=============================================================================
-const void InputDialog::draw()
+void InputDialog::drawDialog()
 {
-    if (!visible || graphics == NULL || !initialized)
-    {
-        return;
-    }
-
     graphics->drawQuad(borderVerts[0], borderVerts[1], borderVerts[2], borderVerts[3],
         borderColor);           // border
     graphics->drawQuad(dialogVerts[0], dialogVerts[1], dialogVerts[2], dialogVerts[3],
@@ -100,9 +95,9 @@ const void InputDialog::draw()
     // display input text
     font.setFontColor(textFontColor);
     tempRect = inTextRect;          // save
-    // No text is printed with CALDRECT option. It moves rect.max.x
-    font.print(textIn, tempRect, ALIGNMENT::SINGLELINE | ALIGNMENT::LEFT |
-        ALIGNMENT::VCENTER | ALIGNMENT::CALCRECT);
+    // No text is printed. It moves rect.max.x
+    font.measure(textIn, tempRect, ALIGNMENT::SINGLELINE | ALIGNMENT::LEFT |
+        ALIGNMENT::VCENTER);
 
     if (tempRect.max.x > inTextRect.max.x)            // if text too long, right justify
     {
@@ -128,6 +123,7 @@ void InputDialog::keyIn(unsigned int key)
         if (textIn.length() > 0)
         {
             textIn.erase(textIn.size() - 1);
+            dirty = true;
         }
     }
     else
@@ -141,6 +137,7 @@ void InputDialog::keyIn(unsigned int key)
         if (textIn.length() + 1 < 256)
         {
             textIn.insert(textIn.length(), 1, (key & 0xFF));
+            dirty = true;
         }
     }
 }
@@ -166,6 +163,7 @@ std::string InputDialog::getText()
 void InputDialog::setTextFontColor(vector4_t fc)
 {
     textFontColor = fc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -174,6 +172,7 @@ void InputDialog::setTextFontColor(vector4_t fc)
 void InputDialog::setTextBackColor(vector4_t bc)
 {
     textBackColor = bc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -188,6 +187,7 @@ void InputDialog::update()
         if (buttonClicked == 2)         // cancel button
         {
             textIn = "";
+            dirty = true;
         }
 
         return;
@@ -201,6 +201,7 @@ void InputDialog::update()
     if (input->wasKeyPressed(BACKSPACE_KEY) == true)            // backspace
     {
         textIn.erase(textIn.size() - 1);
+        dirty = true;
     }
 }
 
@@ -229,9 +230,9 @@ void InputDialog::print(const std::string& str, rect_t& rect, unsigned int forma
     textRect.max.y = ((offset.y + extent.y) - m);
 
     // set textRect.max.y to precise height required for text
-    // no text is printed with CALDRECT option.
+    // no text is printed
     this->format = format;
-    font.print(text, textRect, format | ALIGNMENT::CALCRECT);
+    font.measure(text, textRect, format);
     extent.y = (textRect.max.y - textRect.min.y) - (float)(b + m);
 
     InputDialog::prepareVerts();
@@ -239,6 +240,7 @@ void InputDialog::print(const std::string& str, rect_t& rect, unsigned int forma
     textIn = "";                    // clear old input
     buttonClicked = 0;              // clear buttonClicked
     visible = true;
+    dirty = true;
 }
 
 //=============================================================================
@@ -21,6 +21,9 @@ private:
     rect_t  inTextRect;
     rect_t  tempRect;
 
+    // Draw the MessageDialog parts and the input text area.
+    void drawDialog();
+
 public:
     // Constructor
     InputDialog();
@@ -36,9 +39,6 @@ public:
     // Prepare vertex buffers
     void prepareVerts();
 
-    // Display the InputDialog.
-    const void draw();
-
     // Save the char just entered in textIn string
     void keyIn(unsigned int key);
 
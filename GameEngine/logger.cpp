@@ -0,0 +1,318 @@
+#include "logger.h"
+#include "console.h"
+#include <stdio.h>
+
+// Slots hold their sequence minus their index, so the zeroed static queue is
+// ready for producers before initialize() is called.
+LOG_MESSAGE Logger::queue[loggerNS::QUEUE_SIZE];
+SDL_AtomicU32 Logger::enqueuePos;
+Uint32 Logger::dequeuePos = 0;
+SDL_AtomicInt Logger::dropped;
+char Logger::mirror[loggerNS::MIRROR_SIZE][loggerNS::MAX_MESSAGE];
+SDL_AtomicU32 Logger::mirrorHead;
+SDL_AtomicU32 Logger::mirrorTail;
+char Logger::batch[loggerNS::BATCH_SIZE];
+int Logger::batchSize = 0;
+SDL_IOStream* Logger::file = NULL;
+Sint64 Logger::fileSize = 0;
+char Logger::fileName[256] = { 0 };
+SDL_Thread* Logger::writer = NULL;
+SDL_Semaphore* Logger::wake = NULL;
+SDL_AtomicInt Logger::running;
+
+static const char* const LEVEL_NAME[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+static const SDL_LogPriority LEVEL_PRIORITY[] = { SDL_LOG_PRIORITY_DEBUG,
+    SDL_LOG_PRIORITY_INFO, SDL_LOG_PRIORITY_WARN, SDL_LOG_PRIORITY_ERROR };
+
+//=============================================================================
+// Start the writer thread
+//=============================================================================
+bool Logger::initialize(const char* name)
+{
+    if (writer != NULL)
+    {
+        return true;
+    }
+
+    SDL_strlcpy(fileName, name, sizeof(fileName));
+
+    if (rotate() == false)
+    {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Couldn't open %s: %s",
+            fileName, SDL_GetError());
+    }
+
+    wake = SDL_CreateSemaphore(0);
+    SDL_SetAtomicInt(&running, 1);
+    writer = SDL_CreateThread(writerThread, "Logger", NULL);
+
+    if (writer == NULL)
+    {
+        SDL_SetAtomicInt(&running, 0);
+        SDL_DestroySemaphore(wake);
+        wake = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Write everything still queued and stop the writer thread
+//=============================================================================
+void Logger::shutdown()
+{
+    if (writer != NULL)
+    {
+        SDL_SetAtomicInt(&running, 0);
+        SDL_SignalSemaphore(wake);
+        SDL_WaitThread(writer, NULL);
+        writer = NULL;
+        SDL_DestroySemaphore(wake);
+        wake = NULL;
+    }
+
+    if (file != NULL)
+    {
+        SDL_CloseIO(file);
+        file = NULL;
+    }
+}
+
+//=============================================================================
+// Queue a message
+// Bounded MPSC queue: a producer claims a slot by advancing enqueuePos when
+// the slot's sequence says it is free, fills it and publishes it by bumping
+// the sequence. Nothing here waits on the writer.
+//=============================================================================
+void Logger::write(int level, const char* format, ...)
+{
+    const Uint32 mask = loggerNS::QUEUE_SIZE - 1;
+    Uint32 pos = SDL_GetAtomicU32(&enqueuePos);
+    LOG_MESSAGE* pMessage = NULL;
+
+    for (;;)
+    {
+        pMessage = &queue[pos & mask];
+        const Uint32 sequence = SDL_GetAtomicU32(&pMessage->sequence) + (pos & mask);
+        const Sint32 diff = (Sint32)(sequence - pos);
+
+        if (diff == 0)
+        {
+            if (SDL_CompareAndSwapAtomicU32(&enqueuePos, pos, pos + 1))
+            {
+                break;
+            }
+
+            pos = SDL_GetAtomicU32(&enqueuePos);
+        }
+        else if (diff < 0)          // full, the writer is a lap behind
+        {
+            SDL_AddAtomicInt(&dropped, 1);
+            return;
+        }
+        else
+        {
+            pos = SDL_GetAtomicU32(&enqueuePos);
+        }
+    }
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(pMessage->text, sizeof(pMessage->text), format, args);
+    va_end(args);
+
+    pMessage->level = SDL_clamp(level, LOG_LEVEL_DEBUG, LOG_LEVEL_ERROR);
+    pMessage->ticks = SDL_GetTicks();
+    SDL_SetAtomicU32(&pMessage->sequence, (pos + 1) - (pos & mask));
+
+    if (level >= LOG_LEVEL_ERROR && wake != NULL)
+    {
+        SDL_SignalSemaphore(wake);          // get errors to disk promptly
+    }
+}
+
+//=============================================================================
+// Print lines written since the last call on the console
+//=============================================================================
+void Logger::update(Console* console)
+{
+    Uint32 tail = SDL_GetAtomicU32(&mirrorTail);
+    const Uint32 head = SDL_GetAtomicU32(&mirrorHead);
+
+    while (tail != head)
+    {
+        const char* line = mirror[tail % loggerNS::MIRROR_SIZE];
+
+        if (console != NULL)
+        {
+            console->printLine(line, (int)SDL_strlen(line));
+        }
+
+        tail++;
+    }
+
+    SDL_SetAtomicU32(&mirrorTail, tail);
+}
+
+//=============================================================================
+// Return the number of messages dropped because the queue was full
+//=============================================================================
+int Logger::getDropped()
+{
+    return SDL_GetAtomicInt(&dropped);
+}
+
+//=============================================================================
+// Background thread, writes queued messages every FLUSH_INTERVAL
+//=============================================================================
+int SDLCALL Logger::writerThread(void* data)
+{
+    while (SDL_GetAtomicInt(&running) != 0)
+    {
+        SDL_WaitSemaphoreTimeout(wake, loggerNS::FLUSH_INTERVAL);
+        drain();
+        writeBatch();
+    }
+
+    drain();
+    writeBatch();
+
+    return 0;
+}
+
+//=============================================================================
+// Move every queued message to the file batch and the console mirror
+//=============================================================================
+void Logger::drain()
+{
+    const Uint32 mask = loggerNS::QUEUE_SIZE - 1;
+    static int reported = 0;
+
+    for (;;)
+    {
+        LOG_MESSAGE* pMessage = &queue[dequeuePos & mask];
+        const Uint32 sequence = SDL_GetAtomicU32(&pMessage->sequence) +
+            (dequeuePos & mask);
+
+        if ((Sint32)(sequence - (dequeuePos + 1)) < 0)
+        {
+            break;          // empty
+        }
+
+        char line[loggerNS::MAX_MESSAGE + 32];
+        const int length = SDL_snprintf(line, sizeof(line), "[%10.3f] %s: %s\n",
+            (double)pMessage->ticks / 1000.0, LEVEL_NAME[pMessage->level],
+            pMessage->text);
+
+        SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION,
+            LEVEL_PRIORITY[pMessage->level], "%s", pMessage->text);
+
+        // console line, without the time stamp
+        const Uint32 head = SDL_GetAtomicU32(&mirrorHead);
+
+        if (head - SDL_GetAtomicU32(&mirrorTail) < loggerNS::MIRROR_SIZE)
+        {
+            SDL_snprintf(mirror[head % loggerNS::MIRROR_SIZE], loggerNS::MAX_MESSAGE,
+                "%s: %s", LEVEL_NAME[pMessage->level], pMessage->text);
+            SDL_SetAtomicU32(&mirrorHead, head + 1);
+        }
+
+        SDL_SetAtomicU32(&pMessage->sequence,
+            (dequeuePos + loggerNS::QUEUE_SIZE) - (dequeuePos & mask));
+        dequeuePos++;
+
+        const int count = SDL_min(length, (int)sizeof(line) - 1);
+
+        if (batchSize + count > loggerNS::BATCH_SIZE)
+        {
+            writeBatch();
+        }
+
+        SDL_memcpy(&batch[batchSize], line, count);
+        batchSize += count;
+    }
+
+    const int lost = SDL_GetAtomicInt(&dropped);
+
+    if (lost != reported && batchSize + 64 <= loggerNS::BATCH_SIZE)
+    {
+        batchSize += SDL_snprintf(&batch[batchSize], 64,
+            "%d log messages dropped\n", lost - reported);
+        reported = lost;
+    }
+}
+
+//=============================================================================
+// Write the batch to the file, rotating it when it is full
+//=============================================================================
+void Logger::writeBatch()
+{
+    if (batchSize == 0)
+    {
+        return;
+    }
+
+    if (file != NULL)
+    {
+        fileSize += (Sint64)SDL_WriteIO(file, batch, batchSize);
+        SDL_FlushIO(file);
+    }
+
+    batchSize = 0;
+
+    if (fileSize >= loggerNS::MAX_FILE_SIZE)
+    {
+        rotate();
+    }
+}
+
+//=============================================================================
+// Keep the last MAX_FILES - 1 logs and start an empty file
+// log.txt becomes log.1.txt, log.1.txt becomes log.2.txt and so on.
+//=============================================================================
+bool Logger::rotate()
+{
+    if (file != NULL)
+    {
+        SDL_CloseIO(file);
+        file = NULL;
+    }
+
+    const char* ext = SDL_strrchr(fileName, '.');
+
+    if (ext != NULL && (SDL_strchr(ext, '\\') != NULL || SDL_strchr(ext, '/') != NULL))
+    {
+        ext = NULL;         // the dot is in a directory name
+    }
+    const int stem = (ext != NULL) ? (int)(ext - fileName) : (int)SDL_strlen(fileName);
+
+    if (ext == NULL)
+    {
+        ext = "";
+    }
+
+    for (int i = loggerNS::MAX_FILES - 1; i > 0; i--)
+    {
+        char from[300];
+        char to[300];
+
+        if (i == 1)
+        {
+            SDL_strlcpy(from, fileName, sizeof(from));
+        }
+        else
+        {
+            SDL_snprintf(from, sizeof(from), "%.*s.%d%s", stem, fileName, i - 1, ext);
+        }
+
+        SDL_snprintf(to, sizeof(to), "%.*s.%d%s", stem, fileName, i, ext);
+        SDL_RemovePath(to);
+        SDL_RenamePath(from, to);
+    }
+
+    file = SDL_IOFromFile(fileName, "w");
+    fileSize = 0;
+
+    return (file != NULL);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <SDL3\SDL.h>
+
+class Console;
+
+// Log severity. Messages below LOG_LEVEL are compiled out by the LOG_ macros.
+#define LOG_LEVEL_DEBUG     0
+#define LOG_LEVEL_INFO      1
+#define LOG_LEVEL_WARNING   2
+#define LOG_LEVEL_ERROR     3
+#define LOG_LEVEL_NONE      4
+
+#ifndef LOG_LEVEL
+#ifdef _DEBUG
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+namespace loggerNS
+{
+    const char FILE_NAME[] = "log.txt";
+    const int MAX_FILES = 3;                    // log.txt, log.1.txt, log.2.txt
+    const Sint64 MAX_FILE_SIZE = 1024 * 1024;   // bytes before the file is rotated
+    const Uint32 QUEUE_SIZE = 1024;             // queued messages, power of two
+    const Uint32 MIRROR_SIZE = 256;             // lines waiting for the console
+    const int MAX_MESSAGE = 256;                // longer messages are cut
+    const int BATCH_SIZE = 16384;               // bytes written to the file at once
+    const Sint32 FLUSH_INTERVAL = 100;          // milliseconds between writes
+}
+
+// Queued message. sequence tells producers and the writer who owns the slot.
+typedef struct _LOG_MESSAGE
+{
+    SDL_AtomicU32 sequence;
+    int level;
+    Uint64 ticks;
+    char text[loggerNS::MAX_MESSAGE];
+} LOG_MESSAGE;
+
+class Logger
+{
+    // Logger properties
+private:
+    static LOG_MESSAGE queue[loggerNS::QUEUE_SIZE];
+    static SDL_AtomicU32 enqueuePos;
+    static Uint32 dequeuePos;           // writer thread only
+    static SDL_AtomicInt dropped;       // messages lost to a full queue
+    static char mirror[loggerNS::MIRROR_SIZE][loggerNS::MAX_MESSAGE];
+    static SDL_AtomicU32 mirrorHead;    // written by the writer thread
+    static SDL_AtomicU32 mirrorTail;    // written by update()
+    static char batch[loggerNS::BATCH_SIZE];
+    static int batchSize;
+    static SDL_IOStream* file;
+    static Sint64 fileSize;
+    static char fileName[256];
+    static SDL_Thread* writer;
+    static SDL_Semaphore* wake;
+    static SDL_AtomicInt running;
+
+    // (For internal use only. No user serviceable parts inside.)
+
+    // Background thread, writes queued messages every FLUSH_INTERVAL
+    static int SDLCALL writerThread(void* data);
+
+    // Move every queued message to the file batch and the console mirror
+    static void drain();
+
+    // Write the batch to the file, rotating it when it is full
+    static void writeBatch();
+
+    // Keep the last MAX_FILES - 1 logs and start an empty file
+    static bool rotate();
+
+public:
+    // Start the writer thread. Messages logged before this are kept.
+    static bool initialize(const char* name = loggerNS::FILE_NAME);
+
+    // Write everything still queued and stop the writer thread
+    static void shutdown();
+
+    // Queue a message, safe from any thread and never blocks on the file.
+    // The message is dropped if the queue is full.
+    static void write(int level, const char* format, ...);
+
+    // Print lines written since the last call on the console. Main thread.
+    static void update(Console* console);
+
+    // Return the number of messages dropped because the queue was full
+    static int getDropped();
+};
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Logger::write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) Logger::write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) Logger::write(LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Logger::write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
@@ -37,6 +37,11 @@ MessageDialog::MessageDialog()
     buttonType = 0;     // OK/Cancel
     initialized = false;
     visible = false;
+    cache = NULL;
+    cacheW = 0;
+    cacheH = 0;
+    cacheGeneration = 0;
+    dirty = true;
 }
 
 //=============================================================================
@@ -44,6 +49,11 @@ MessageDialog::MessageDialog()
 //=============================================================================
 MessageDialog::~MessageDialog()
 {
+    if (graphics != NULL && cache != NULL)
+    {
+        graphics->freeTexture(cache);
+    }
+
     font.deleteAll();
 }
 
@@ -165,6 +175,60 @@ const void MessageDialog::draw()
         return;
     }
 
+    const int width = (int)SDL_ceilf(extent.x);
+    const int height = (int)SDL_ceilf(extent.y);
+
+    if (cache != NULL && (cacheW != width || cacheH != height))
+    {
+        graphics->freeTexture(cache);
+        cache = NULL;
+    }
+
+    if (cache == NULL)
+    {
+        if (width <= 0 || height <= 0 ||
+            graphics->createRenderTarget(width, height, cache) == false)
+        {
+            drawDialog();           // no cache, draw every frame
+            return;
+        }
+
+        cacheW = width;
+        cacheH = height;
+        dirty = true;
+    }
+
+    // redraw the cache only when the dialog changed or the target was lost
+    if (dirty || cacheGeneration != graphics->getTargetGeneration())
+    {
+        if (graphics->beginRenderTarget(cache, offset.x, offset.y) == false)
+        {
+            drawDialog();
+            return;
+        }
+
+        drawDialog();
+        graphics->endRenderTarget();
+
+        dirty = false;
+        cacheGeneration = graphics->getTargetGeneration();
+    }
+
+    const vector3_t p0 = { offset.x, offset.y, 1 };
+    const vector3_t p1 = { offset.x + width, offset.y, 1 };
+    const vector3_t p2 = { offset.x + width, offset.y + height, 1 };
+    const vector3_t p3 = { offset.x, offset.y + height, 1 };
+
+    graphics->spriteBegin(SPRITE_ALPHABLEND);
+    graphics->batchSprite(cache, NULL, p0, p1, p2, p3, graphicsNS::WHITE);
+    graphics->spriteEnd();
+}
+
+//=============================================================================
+// Draw border, backdrop, buttons and text
+//=============================================================================
+void MessageDialog::drawDialog()
+{
     graphics->drawQuad(borderVerts[0], borderVerts[1], borderVerts[2], borderVerts[3],
         borderColor);           // draw border
     graphics->drawQuad(dialogVerts[0], dialogVerts[1], dialogVerts[2], dialogVerts[3],
@@ -219,6 +283,7 @@ bool MessageDialog::getVisible() const
 void MessageDialog::setFontColor(vector4_t fc)
 {
     fontColor = fc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -227,6 +292,7 @@ void MessageDialog::setFontColor(vector4_t fc)
 void MessageDialog::setBorderColor(vector4_t bc)
 {
     borderColor = bc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -235,6 +301,7 @@ void MessageDialog::setBorderColor(vector4_t bc)
 void MessageDialog::setBackColor(vector4_t bc)
 {
     backColor = bc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -243,6 +310,7 @@ void MessageDialog::setBackColor(vector4_t bc)
 void MessageDialog::setButtonColor(vector4_t bc)
 {
     buttonColor = bc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -251,6 +319,7 @@ void MessageDialog::setButtonColor(vector4_t bc)
 void MessageDialog::setButtonFontColor(vector4_t bfc)
 {
     buttonFontColor = bfc;
+    dirty = true;
 }
 
 //=============================================================================
@@ -269,6 +338,7 @@ void MessageDialog::setButtonType(unsigned int t)
     if (t < messageDialogNS::MAX_TYPE)
     {
         buttonType = t;
+        dirty = true;
     }
 }
 
@@ -368,15 +438,16 @@ void MessageDialog::print(const std::string& str, rect_t& rect, unsigned int for
     textRect.max.y = (offset.y + extent.y) - m;
 
     // set rect.min.y to precise height required for text
-    // no text is printed with CALDRECT option.
+    // no text is printed
     this->format = format;
-    font.print(text, textRect, format | ALIGNMENT::CALCRECT);
+    font.measure(text, textRect, format);
     extent.y = (textRect.max.y - textRect.min.y) - (b + m);
 
     prepareVerts();
 
     buttonClicked = 0;              // clear buttonClicked
     visible = true;
+    dirty = true;
 }
 
 //=============================================================================
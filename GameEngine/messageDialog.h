@@ -64,6 +64,15 @@ protected:
     int         buttonType;         // 0 = OK/Cancel, 1 = Yes/No
     bool        initialized;            // true when initialized successfully
     bool        visible;            // true to display
+    // Retained rendering
+    LP_TEXTURE  cache;          // the dialog as drawn by drawDialog()
+    int         cacheW;
+    int         cacheH;
+    unsigned int cacheGeneration;           // Graphics target generation of cache
+    bool        dirty;          // true when cache must be drawn again
+
+    // Draw border, backdrop, buttons and text.
+    virtual void drawDialog();
 
 public:
     // Constructor
@@ -82,6 +91,8 @@ public:
     void prepareVerts();
 
     // Display the MessageDialog.
+    // The dialog is drawn into a texture when it changes and shown from
+    // there, so an unchanged dialog costs one sprite.
     const void draw();
 
     // Return button clicked
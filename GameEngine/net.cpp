@@ -1,4 +1,5 @@
 #include "net.h"
+#include "transport.h"
 
 //=============================================================================
 // Constructor
@@ -6,7 +7,8 @@
 Net::Net()
 {
     // SDL
-    datagramSocket = NULL;
+    transport = NULL;
+    userTransport = NULL;
     streamSocket = NULL;
     serverSocket = NULL;
     remoteAddr = NULL;
@@ -18,6 +20,21 @@ Net::Net()
     mode = netNS::UNINITIALIZED;
     netInitialized = false;
     bound = false;
+
+    // Receive queue
+    receiveQueue = NULL;
+    SDL_SetAtomicU32(&receiveHead, 0);
+    SDL_SetAtomicU32(&receiveTail, 0);
+    receiveTaken = 0;
+    sendQueue = NULL;
+    SDL_SetAtomicU32(&sendHead, 0);
+    SDL_SetAtomicU32(&sendTail, 0);
+    sendReclaimed = 0;
+    worker = NULL;
+    SDL_SetAtomicInt(&working, 0);
+
+    // TCP connections
+    nextConnection = 0;
 }
 
 //=============================================================================
@@ -48,7 +65,8 @@ int Net::initialize(int mode, int port, int protocol)
         return status;
     }
 
-    if (mode == netNS::CLIENT)
+    // a transport routes by port, there is nothing to look up
+    if (mode == netNS::CLIENT && (protocol != netNS::UDP || userTransport == NULL))
     {
         remoteAddr = SDLNet_ResolveHostname(serverIP);
 
@@ -66,15 +84,49 @@ int Net::initialize(int mode, int port, int protocol)
     {
     case netNS::UDP:            // UDP
     {
-        // Create UDP socket and bind it to a local interface and port
-        datagramSocket = SDLNet_CreateDatagramSocket(remoteAddr, port);
-        if (datagramSocket == NULL)
+        if (userTransport != NULL)
         {
-            SDLNet_Quit();
-            status = netNS::NET_INVALID_SOCKET;
-            return status;
+            transport = userTransport;
+        }
+        else
+        {
+            // Create UDP socket and bind it to a local interface and port
+            SocketTransport* socket = new SocketTransport;
+
+            if (socket->initialize(remoteAddr, port) == false)
+            {
+                delete socket;
+                SDLNet_Quit();
+                status = netNS::NET_INVALID_SOCKET;
+                return status;
+            }
+
+            transport = socket;
         }
         type = netNS::UDP;
+
+        // hand the transport to the worker thread
+        receiveQueue = new NET_PACKET[netNS::RECEIVE_SLOTS];
+        sendQueue = new NET_SEND[netNS::SEND_SLOTS];
+        SDL_SetAtomicU32(&receiveHead, 0);
+        SDL_SetAtomicU32(&receiveTail, 0);
+        receiveTaken = 0;
+        SDL_SetAtomicU32(&sendHead, 0);
+        SDL_SetAtomicU32(&sendTail, 0);
+        sendReclaimed = 0;
+        this->mode = mode;          // the worker filters on it
+        SDL_SetAtomicInt(&working, 1);
+        worker = SDL_CreateThread(workerThread, "NetWorker", this);
+
+        if (worker == NULL)
+        {
+            // nothing would ever fill the receive queue
+            SDL_SetAtomicInt(&working, 0);
+            closeSocket();
+            this->mode = netNS::UNINITIALIZED;
+            status = netNS::NET_INIT_FAILED;
+            return status;
+        }
     } break;
     case netNS::TCP:            // TCP
     {
@@ -112,6 +164,14 @@ int Net::initialize(int mode, int port, int protocol)
     return netNS::NET_OK;
 }
 
+//=============================================================================
+// Use transport for UDP instead of a socket
+//=============================================================================
+void Net::setTransport(Transport* pTransport)
+{
+    userTransport = pTransport;
+}
+
 //=============================================================================
 // Setup network for use as server
 //=============================================================================
@@ -149,16 +209,19 @@ int Net::createClient(char* server, int port, int protocol)
         return status;
     }
 
-    // set local IP address
-    getLocalIP(localIP);            // get local IP
-    localAddr = SDLNet_ResolveHostname(localIP);            // local IP
-
-    if (localAddr != NULL)
+    // set local IP address, not needed on a transport
+    if (protocol != netNS::UDP || userTransport == NULL)
     {
-        if (SDLNet_WaitUntilResolved(localAddr, -1) < 0)
+        getLocalIP(localIP);            // get local IP
+        localAddr = SDLNet_ResolveHostname(localIP);            // local IP
+
+        if (localAddr != NULL)
         {
-            SDLNet_UnrefAddress(localAddr);
-            localAddr = NULL;
+            if (SDLNet_WaitUntilResolved(localAddr, -1) < 0)
+            {
+                SDLNet_UnrefAddress(localAddr);
+                localAddr = NULL;
+            }
         }
     }
 
@@ -178,22 +241,34 @@ int Net::sendData(const char* data, int& size, const char* remoteIP)
 
     size = 0;           // assume 0 bytes sent, changed if send successful
 
-    if (mode == netNS::SERVER)
+    if (type == netNS::UDP && mode == netNS::SERVER)
     {
-        remoteAddr = SDLNet_ResolveHostname(remoteIP);
-        status = SDLNet_WaitUntilResolved(remoteAddr, -1);
-    }
+        // resolved once per peer, never waited for here
+        int peer = findPeer(remoteIP, 0);
 
-    if (type == netNS::UDP)
-    {
-        void* buf = (void*)SDL_malloc(sendSize * sizeof(char));
-        SDL_memcpy(buf, data, sendSize * sizeof(char));
-        ret = SDLNet_SendDatagram(datagramSocket, remoteAddr, 0, buf,
-            sendSize);
+        if (peer < 0)
+        {
+            peer = addPeer(remoteIP, 0);
+        }
 
-        SDL_free(buf);
+        status = sendTo(peer, data, sendSize);
 
-        if (ret < 0)
+        if (status == netNS::NET_ADDRESS_PENDING)
+        {
+            return netNS::NET_OK;           // not sent yet
+        }
+
+        if (status != netNS::NET_OK)
+        {
+            return netNS::NET_ERROR;
+        }
+    }
+    else if (type == netNS::UDP)
+    {
+        // queued, the worker thread does the send
+        ret = send(data, sendSize, remoteAddr, 0);
+
+        if (ret != netNS::NET_OK)
         {
             return netNS::NET_ERROR;
         }
@@ -201,38 +276,30 @@ int Net::sendData(const char* data, int& size, const char* remoteIP)
 
     if (mode == netNS::CLIENT && type == netNS::UNCONNECTED_TCP)
     {
-        ret = SDLNet_GetConnectionStatus(streamSocket);
-
-        if (ret == 1)
+        if (connectClient() == false)
         {
-            ret = 0;
-            type = netNS::CONNECTED_TCP;
+            return netNS::NET_CONNECT_FAILED;
         }
-        else
+
+        if (type == netNS::UNCONNECTED_TCP)
         {
-            if (ret == 0)
-            {
-                return netNS::NET_OK;          // no connection yet
-            }
-            else
-            {
-                return netNS::NET_CONNECT_FAILED;
-            }
+            return netNS::NET_OK;          // no connection yet
         }
     }
 
     if (type == netNS::CONNECTED_TCP)
     {
-        if (streamSocket != NULL)
-        {
-            ret = SDLNet_WriteToStreamSocket(streamSocket, data, sendSize);
+        // the client has one connection, the server sends to remoteIP's
+        const int connection = (mode == netNS::CLIENT) ? 0 : findConnection(remoteIP);
 
-            if (ret < 0)
-            {
-                type = netNS::UNCONNECTED_TCP;
+        if (connection < 0)
+        {
+            return netNS::NET_OK;          // not connected
+        }
 
-                return netNS::NET_ERROR;
-            }
+        if (sendStream(connection, data, sendSize) != netNS::NET_OK)
+        {
+            return netNS::NET_ERROR;
         }
     }
 
@@ -254,22 +321,34 @@ int Net::sendData(const char* data, int& size, const char* remoteIP,
 
     size = 0;           // assume 0 bytes sent, changed if send successful
 
-    if (mode == netNS::SERVER)
+    if (type == netNS::UDP && mode == netNS::SERVER)
     {
-        remoteAddr = SDLNet_ResolveHostname(remoteIP);
-        status = SDLNet_WaitUntilResolved(remoteAddr, -1);
-    }
+        // resolved once per peer, never waited for here
+        int peer = findPeer(remoteIP, port);
 
-    if (type == netNS::UDP)
-    {
-        void* buf = (void*)SDL_malloc(sendSize * sizeof(char));
-        SDL_memcpy(buf, data, sendSize * sizeof(char));
-        ret = SDLNet_SendDatagram(datagramSocket, remoteAddr, port, buf,
-            sendSize);
+        if (peer < 0)
+        {
+            peer = addPeer(remoteIP, port);
+        }
 
-        SDL_free(buf);
+        status = sendTo(peer, data, sendSize);
 
-        if (ret < 0)
+        if (status == netNS::NET_ADDRESS_PENDING)
+        {
+            return netNS::NET_OK;           // not sent yet
+        }
+
+        if (status != netNS::NET_OK)
+        {
+            return netNS::NET_ERROR;
+        }
+    }
+    else if (type == netNS::UDP)
+    {
+        // queued, the worker thread does the send
+        ret = send(data, sendSize, remoteAddr, port);
+
+        if (ret != netNS::NET_OK)
         {
             return netNS::NET_ERROR;
         }
@@ -277,38 +356,30 @@ int Net::sendData(const char* data, int& size, const char* remoteIP,
 
     if (mode == netNS::CLIENT && type == netNS::UNCONNECTED_TCP)
     {
-        ret = SDLNet_GetConnectionStatus(streamSocket);
-
-        if (ret == 1)
+        if (connectClient() == false)
         {
-            ret = 0;
-            type = netNS::CONNECTED_TCP;
+            return netNS::NET_CONNECT_FAILED;
         }
-        else
+
+        if (type == netNS::UNCONNECTED_TCP)
         {
-            if (ret == 0)
-            {
-                return netNS::NET_OK;          // no connection yet
-            }
-            else
-            {
-                return netNS::NET_CONNECT_FAILED;
-            }
+            return netNS::NET_OK;          // no connection yet
         }
     }
 
     if (type == netNS::CONNECTED_TCP)
     {
-        if (streamSocket != 0)
-        {
-            ret = SDLNet_WriteToStreamSocket(streamSocket, data, sendSize);
+        // the client has one connection, the server sends to remoteIP's
+        const int connection = (mode == netNS::CLIENT) ? 0 : findConnection(remoteIP);
 
-            if (ret < 0)
-            {
-                type = netNS::UNCONNECTED_TCP;
+        if (connection < 0)
+        {
+            return netNS::NET_OK;          // not connected
+        }
 
-                return netNS::NET_ERROR;
-            }
+        if (sendStream(connection, data, sendSize) != netNS::NET_OK)
+        {
+            return netNS::NET_ERROR;
         }
     }
 
@@ -319,222 +390,1100 @@ int Net::sendData(const char* data, int& size, const char* remoteIP,
 }
 
 //=============================================================================
-// Read data, return sender's IP
+// Copy data into a pooled buffer and queue it for the worker thread
 //=============================================================================
-int Net::readData(char* data, int& size, char* senderIP)
+int Net::send(const void* data, int size, SDLNet_Address* addr, unsigned short port)
 {
-    char* remoteIP = NULL;
-    int ret = 0;
-    int readSize = size;
-
-    size = 0;           // assume 0 bytes read, changed if read successful
-    if (bound == false)         // no receive from unbound socket
+    if (transport == NULL)
     {
-        return netNS::NET_OK;
+        return netNS::NET_INVALID_SOCKET;
     }
 
-    if (mode == netNS::SERVER && type == netNS::UNCONNECTED_TCP)
+    if (size < 0 || size > netNS::BUFFER_LENGTH)
     {
-        if (serverSocket != NULL)
-        {
-            SDLNet_StreamSocket* tempSocket = 0;
+        return netNS::NET_ERROR;
+    }
 
-            ret = SDLNet_AcceptClient(serverSocket, &tempSocket);
+    NET_BUFFER* buffer = acquireBuffer();
 
-            if (ret == 0 && tempSocket == 0)
-            {
-                return netNS::NET_OK;          // no connection yet
-            }
+    SDL_memcpy(buffer->data, data, size);
+    buffer->size = size;
 
-            SDLNet_DestroyStreamSocket(streamSocket);
-            streamSocket = tempSocket;          // TCP client connected
-            remoteAddr = SDLNet_GetStreamSocketAddress(streamSocket);
+    return send(buffer, addr, port);
+}
 
-            type = netNS::CONNECTED_TCP;
-        }
+//=============================================================================
+// Queue a pooled buffer for the worker thread, Net owns it from here on
+//=============================================================================
+int Net::send(NET_BUFFER* buffer, SDLNet_Address* addr, unsigned short port)
+{
+    if (buffer == NULL)
+    {
+        return netNS::NET_ERROR;
     }
 
-    if (mode == netNS::CLIENT && type == netNS::UNCONNECTED_TCP)
+    if (transport == NULL)
     {
-        return netNS::NET_OK;           // no connection yet
+        releaseBuffer(buffer);
+        return netNS::NET_INVALID_SOCKET;
     }
 
-    if (datagramSocket != NULL)
+    if (addr == NULL)
     {
-        SDLNet_Datagram* dgram = NULL;
+        addr = remoteAddr;
+    }
 
-        while (((ret = SDLNet_ReceiveDatagram(datagramSocket, &dgram)) == 0) &&
-            (dgram != NULL))
-        {
-            if (mode == netNS::CLIENT)
-            {
-                if (SDLNet_CompareAddresses(dgram->addr, remoteAddr) != 0)
-                {
-                    // packet from non-server address.
-                    SDLNet_DestroyDatagram(dgram);
-                    dgram = NULL;
-
-                    continue;
-                }
-            }
+    reclaimBuffers();           // the slot may still hold a sent buffer
 
-            remoteAddr = dgram->addr;
-            remoteIP = (char*)SDLNet_GetAddressString(remoteAddr);
+    const Uint32 head = SDL_GetAtomicU32(&sendHead);
 
-            if (remoteIP != NULL)
-            {
-                SDL_memcpy(senderIP, remoteIP, netNS::IP_SIZE);
-            }
+    if (head - SDL_GetAtomicU32(&sendTail) >= netNS::SEND_SLOTS)
+    {
+        releaseBuffer(buffer);
+        return netNS::NET_ERROR;            // worker is behind
+    }
 
-            if (dgram->buflen < readSize)
-            {
-                readSize = dgram->buflen;
-            }
+    NET_SEND& entry = sendQueue[head % netNS::SEND_SLOTS];
 
-            SDL_memcpy(data, dgram->buf, readSize);
-            size = readSize;
+    entry.addr = SDLNet_RefAddress(addr);           // a peer may go away first
+    entry.port = port;
+    entry.buffer = buffer;
 
-            SDLNet_DestroyDatagram(dgram);
-            dgram = NULL;
-        }
-    }
+    SDL_SetAtomicU32(&sendHead, head + 1);
 
-    if (streamSocket != NULL)
-    {
-        ret = SDLNet_ReadFromStreamSocket(streamSocket, data, readSize);
+    bound = true;
 
-        if (ret < 0)
+    return netNS::NET_OK;
+}
+
+//=============================================================================
+// Send messages gathered into as few datagrams as possible
+//=============================================================================
+int Net::sendMessages(const void* const* messages, const int* sizes, int count,
+    SDLNet_Address* addr, unsigned short port)
+{
+    NET_BUFFER* buffer = acquireBuffer();
+    int status = netNS::NET_OK;
+
+    for (int i = 0; i < count && status == netNS::NET_OK; i++)
+    {
+        if (appendMessage(buffer, messages[i], sizes[i]))
         {
-            return netNS::NET_ERROR;
+            continue;
         }
 
-        remoteIP = (char*)SDLNet_GetAddressString(remoteAddr);
-        if (remoteIP != NULL)
+        if (buffer->size == 0)          // too big for an empty datagram
         {
-            SDL_memcpy(senderIP, remoteIP, netNS::IP_SIZE);
+            status = netNS::NET_ERROR;
+            break;
         }
 
-        size = ret;
+        // datagram is full, send it and start the next one
+        status = send(buffer, addr, port);
+        buffer = acquireBuffer();
+        i--;
     }
 
-    return netNS::NET_OK;
+    if (status == netNS::NET_OK && buffer->size > 0)
+    {
+        return send(buffer, addr, port);
+    }
+
+    releaseBuffer(buffer);
+
+    return status;
 }
 
 //=============================================================================
-// Read data, return sender's IP and port
+// Add a peer, its address is resolved in the background
 //=============================================================================
-int Net::readData(char* data, int& size, char* senderIP, unsigned short& port)
+int Net::addPeer(const char* host, unsigned short port)
 {
-    char* remoteIP = NULL;
-    int ret = 0;
-    int readSize = size;
+    if (host == NULL)
+    {
+        return -1;
+    }
 
-    size = 0;           // assume 0 bytes read, changed if read successful
-    if (bound == false)         // no receive from unbound socket
+    size_t id = 0;
+
+    while (id < peers.size() && peers[id].state != netNS::PEER_FREE)
     {
-        return netNS::NET_OK;
+        id++;
     }
 
-    if (mode == netNS::SERVER && type == netNS::UNCONNECTED_TCP)
+    if (id == peers.size())
     {
-        if (serverSocket != NULL)
-        {
-            SDLNet_StreamSocket* tempSocket = 0;
+        peers.push_back(NET_PEER());
+    }
 
-            ret = SDLNet_AcceptClient(serverSocket, &tempSocket);
+    NET_PEER& peer = peers[id];
 
-            if (ret == 0 && tempSocket == 0)
-            {
-                return netNS::NET_OK;          // no connection yet
-            }
+    peer.host = host;
+    peer.port = port;
+    peer.addr = SDLNet_ResolveHostname(host);
+    peer.state = (peer.addr != NULL) ? netNS::PEER_RESOLVING : netNS::PEER_FAILED;
 
-            SDLNet_DestroyStreamSocket(streamSocket);
-            streamSocket = tempSocket;          // TCP client connected
-            remoteAddr = SDLNet_GetStreamSocketAddress(streamSocket);
+    return (int)id;
+}
 
-            type = netNS::CONNECTED_TCP;
+//=============================================================================
+// Return the id of the peer added with host and port
+//=============================================================================
+int Net::findPeer(const char* host, unsigned short port) const
+{
+    for (size_t i = 0; i < peers.size(); i++)
+    {
+        if (peers[i].state != netNS::PEER_FREE && peers[i].port == port &&
+            peers[i].host == host)
+        {
+            return (int)i;
         }
     }
 
-    if (mode == netNS::CLIENT && type == netNS::UNCONNECTED_TCP)
+    return -1;
+}
+
+//=============================================================================
+// Return the id of the peer a packet came from
+//=============================================================================
+int Net::findPeer(const NET_PACKET* packet) const
+{
+    if (packet == NULL || packet->addr == NULL)
     {
-        return netNS::NET_OK;           // no connection yet
+        return -1;
     }
 
-    if (datagramSocket != NULL)
+    for (size_t i = 0; i < peers.size(); i++)
     {
-        SDLNet_Datagram* dgram = NULL;
-
-        while (((ret = SDLNet_ReceiveDatagram(datagramSocket, &dgram)) == 0) &&
-            (dgram != NULL))
+        if (peers[i].state == netNS::PEER_READY && peers[i].port == packet->port &&
+            SDLNet_CompareAddresses(peers[i].addr, packet->addr) == 0)
         {
-            if (mode == netNS::CLIENT)
-            {
-                if (SDLNet_CompareAddresses(dgram->addr, remoteAddr) != 0)
-                {
-                    // packet from non-server address.
-                    SDLNet_DestroyDatagram(dgram);
-                    dgram = NULL;
-
-                    continue;
-                }
-            }
+            return (int)i;
+        }
+    }
 
-            remoteAddr = dgram->addr;
-            remoteIP = (char*)SDLNet_GetAddressString(remoteAddr);
+    return -1;
+}
 
-            if (remoteIP != NULL)
-            {
-                SDL_memcpy(senderIP, remoteIP, netNS::IP_SIZE);
-            }
+//=============================================================================
+// Add the sender of a received packet
+//=============================================================================
+int Net::acceptPeer(const NET_PACKET* packet)
+{
+    int id = findPeer(packet);
 
-            if (dgram->buflen < readSize)
-            {
-                readSize = dgram->buflen;
-            }
+    if (id >= 0 || packet == NULL || packet->addr == NULL)
+    {
+        return id;
+    }
 
-            SDL_memcpy(data, dgram->buf, readSize);
-            size = readSize;
-            port = dgram->port;
+    const char* host = SDLNet_GetAddressString(packet->addr);
+    id = 0;
 
-            SDLNet_DestroyDatagram(dgram);
-            dgram = NULL;
-        }
+    while (id < (int)peers.size() && peers[id].state != netNS::PEER_FREE)
+    {
+        id++;
     }
 
-    if (streamSocket != NULL)
+    if (id == (int)peers.size())
     {
-        ret = SDLNet_ReadFromStreamSocket(streamSocket, data, readSize);
+        peers.push_back(NET_PEER());
+    }
 
-        if (ret < 0)
+    NET_PEER& peer = peers[id];
+
+    peer.host = (host != NULL) ? host : "";
+    peer.port = packet->port;
+    peer.addr = SDLNet_RefAddress(packet->addr);
+    peer.state = netNS::PEER_READY;
+
+    return id;
+}
+
+//=============================================================================
+// Send to a peer
+//=============================================================================
+int Net::sendTo(int peer, const void* data, int size)
+{
+    if (peer < 0 || peer >= (int)peers.size() ||
+        peers[peer].state == netNS::PEER_FREE)
+    {
+        return netNS::NET_ERROR;
+    }
+
+    if (isPeerReady(peers[peer]) == false)
+    {
+        if (peers[peer].state == netNS::PEER_FAILED)
         {
-            return netNS::NET_ERROR;
+            return netNS::NET_DOMAIN_NOT_FOUND;
         }
 
-        remoteIP = (char*)SDLNet_GetAddressString(remoteAddr);
-        if (remoteIP != NULL)
+        return netNS::NET_ADDRESS_PENDING;
+    }
+
+    return send(data, size, peers[peer].addr, peers[peer].port);
+}
+
+//=============================================================================
+// Remove a peer and release its address
+//=============================================================================
+void Net::removePeer(int peer)
+{
+    if (peer < 0 || peer >= (int)peers.size())
+    {
+        return;
+    }
+
+    SDLNet_UnrefAddress(peers[peer].addr);
+    peers[peer].addr = NULL;
+    peers[peer].host.clear();
+    peers[peer].state = netNS::PEER_FREE;
+}
+
+//=============================================================================
+// Return true if the peer's address is ready, without waiting
+//=============================================================================
+bool Net::isPeerReady(NET_PEER& peer)
+{
+    if (peer.state == netNS::PEER_RESOLVING)
+    {
+        const int status = SDLNet_GetAddressStatus(peer.addr);
+
+        if (status > 0)
+        {
+            peer.state = netNS::PEER_READY;
+        }
+        else if (status < 0)
         {
-            SDL_memcpy(senderIP, remoteIP, netNS::IP_SIZE);
+            peer.state = netNS::PEER_FAILED;
         }
+    }
+
+    return (peer.state == netNS::PEER_READY);
+}
+
+//=============================================================================
+// Take a send buffer from the pool
+//=============================================================================
+NET_BUFFER* Net::acquireBuffer()
+{
+    NET_BUFFER* buffer = NULL;
 
-        size = ret;
+    reclaimBuffers();
+
+    if (bufferPool.empty())
+    {
+        buffer = new NET_BUFFER;
+    }
+    else
+    {
+        buffer = bufferPool.back();
+        bufferPool.pop_back();
     }
 
-    return netNS::NET_OK;
+    buffer->size = 0;
+
+    return buffer;
 }
 
 //=============================================================================
-// Close socket and free resources.
+// Give a send buffer back to the pool
 //=============================================================================
-int Net::closeSocket()
+void Net::releaseBuffer(NET_BUFFER* buffer)
 {
-    type = netNS::UNCONNECTED;
-    bound = false;
-    netInitialized = false;
+    if (buffer != NULL)
+    {
+        bufferPool.push_back(buffer);
+    }
+}
 
-    SDLNet_DestroyDatagramSocket(datagramSocket);
-    SDLNet_DestroyStreamSocket(streamSocket);
-    SDLNet_DestroyServer(serverSocket);
+//=============================================================================
+// Put the buffers the worker thread has sent back in the pool
+//=============================================================================
+void Net::reclaimBuffers()
+{
+    if (sendQueue == NULL)
+    {
+        return;
+    }
+
+    const Uint32 tail = SDL_GetAtomicU32(&sendTail);
+
+    while (sendReclaimed != tail)
+    {
+        NET_SEND& entry = sendQueue[sendReclaimed % netNS::SEND_SLOTS];
+
+        releaseBuffer(entry.buffer);
+        entry.buffer = NULL;
+        sendReclaimed++;
+    }
+}
+
+//=============================================================================
+// Pack a message into buffer
+//=============================================================================
+bool Net::appendMessage(NET_BUFFER* buffer, const void* data, int size)
+{
+    if (buffer == NULL || size < 0 || size > 0xFFFF ||
+        buffer->size + netNS::MESSAGE_HEADER + size > netNS::BUFFER_LENGTH)
+    {
+        return false;
+    }
+
+    const Uint16 length = SDL_Swap16LE((Uint16)size);
+
+    SDL_memcpy(&buffer->data[buffer->size], &length, netNS::MESSAGE_HEADER);
+    SDL_memcpy(&buffer->data[buffer->size + netNS::MESSAGE_HEADER], data, size);
+    buffer->size += netNS::MESSAGE_HEADER + size;
+
+    return true;
+}
+
+//=============================================================================
+// Read the next gathered message from a datagram
+//=============================================================================
+bool Net::readMessage(const char* data, int size, int& offset,
+    const char*& message, int& messageSize)
+{
+    if (offset + netNS::MESSAGE_HEADER > size)
+    {
+        return false;
+    }
+
+    Uint16 length = 0;
+
+    SDL_memcpy(&length, &data[offset], netNS::MESSAGE_HEADER);
+    length = SDL_Swap16LE(length);
+
+    if (offset + netNS::MESSAGE_HEADER + length > size)
+    {
+        return false;           // cut short
+    }
+
+    message = &data[offset + netNS::MESSAGE_HEADER];
+    messageSize = length;
+    offset += netNS::MESSAGE_HEADER + length;
+
+    return true;
+}
+
+//=============================================================================
+// Accept or finish connecting, wait for input and read it
+// SDL_net only says how many sockets have input, not which, so sockets are
+// read in turn until that many have delivered something.
+//=============================================================================
+int Net::serviceConnections(Sint32 timeout)
+{
+    if (mode == netNS::CLIENT && type == netNS::UNCONNECTED_TCP)
+    {
+        if (connectClient() == false)
+        {
+            return -1;
+        }
+
+        if (type == netNS::UNCONNECTED_TCP)
+        {
+            return 0;           // no connection yet
+        }
+    }
+
+    waitList.clear();
+    waitConnections.clear();
+
+    if (serverSocket != NULL)
+    {
+        waitList.push_back(serverSocket);           // ready when a client waits
+        waitConnections.push_back(-1);
+    }
+
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        if (connections[i]->socket != NULL)
+        {
+            waitList.push_back(connections[i]->socket);
+            waitConnections.push_back((int)i);
+        }
+    }
+
+    int ready = 0;
+
+    if (waitList.empty() == false)
+    {
+        ready = SDLNet_WaitUntilInputAvailable(&waitList[0], (int)waitList.size(), timeout);
+    }
+
+    // clients accepted now are read next time, they were not waited on
+    for (size_t i = 0; i < waitList.size() && ready > 0; i++)
+    {
+        if (waitConnections[i] >= 0)
+        {
+            if (readConnection(waitConnections[i]))
+            {
+                ready--;
+            }
+
+            continue;
+        }
+
+        SDLNet_StreamSocket* client = NULL;
+        bool accepted = false;
+
+        while (SDLNet_AcceptClient(serverSocket, &client) == 0 && client != NULL)
+        {
+            if (addConnection(client) < 0)
+            {
+                SDLNet_DestroyStreamSocket(client);         // server full
+            }
+
+            client = NULL;
+            accepted = true;
+        }
+
+        if (accepted)
+        {
+            ready--;
+        }
+    }
+
+    return getConnectionCount();
+}
+
+//=============================================================================
+// Return the next complete message from any connection
+//=============================================================================
+bool Net::receiveStream(int& connection, const char*& message, int& size)
+{
+    const size_t count = connections.size();
+
+    for (size_t n = 0; n < count; n++)
+    {
+        const size_t id = (nextConnection + n) % count;
+        NET_CONNECTION* pConnection = connections[id];
+
+        if (pConnection->socket == NULL)
+        {
+            continue;
+        }
+
+        int offset = pConnection->start;
+
+        if (readMessage(pConnection->buffer, pConnection->size, offset,
+            message, size))
+        {
+            pConnection->start = offset;
+            connection = (int)id;
+            nextConnection = id + 1;            // others go first next time
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//=============================================================================
+// Send one framed message on a connection
+//=============================================================================
+int Net::sendStream(int connection, const void* data, int size)
+{
+    if (connection < 0 || connection >= (int)connections.size() ||
+        connections[connection]->socket == NULL)
+    {
+        return netNS::NET_INVALID_SOCKET;
+    }
+
+    if (size < 0 || size > netNS::STREAM_BUFFER - netNS::MESSAGE_HEADER)
+    {
+        return netNS::NET_ERROR;            // the receiver could never hold it
+    }
+
+    SDLNet_StreamSocket* socket = connections[connection]->socket;
+    const Uint16 length = SDL_Swap16LE((Uint16)size);
+
+    if (SDLNet_WriteToStreamSocket(socket, &length, netNS::MESSAGE_HEADER) < 0 ||
+        SDLNet_WriteToStreamSocket(socket, data, size) < 0)
+    {
+        closeConnection(connection);
+
+        return netNS::NET_ERROR;
+    }
+
+    return netNS::NET_OK;
+}
+
+//=============================================================================
+// Return the id of the connection from remoteIP
+//=============================================================================
+int Net::findConnection(const char* remoteIP) const
+{
+    if (remoteIP == NULL)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        if (connections[i]->socket != NULL && connections[i]->addr != NULL &&
+            SDL_strcmp(SDLNet_GetAddressString(connections[i]->addr), remoteIP) == 0)
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+//=============================================================================
+// Close one connection
+//=============================================================================
+void Net::closeConnection(int connection)
+{
+    if (connection < 0 || connection >= (int)connections.size())
+    {
+        return;
+    }
+
+    NET_CONNECTION* pConnection = connections[connection];
+
+    if (pConnection->socket == NULL)
+    {
+        return;
+    }
+
+    SDLNet_DestroyStreamSocket(pConnection->socket);
+    SDLNet_UnrefAddress(pConnection->addr);
+    pConnection->socket = NULL;
+    pConnection->addr = NULL;
+    pConnection->start = 0;
+    pConnection->size = 0;
+
+    if (getConnectionCount() == 0 && type == netNS::CONNECTED_TCP)
+    {
+        type = netNS::UNCONNECTED_TCP;
+    }
+}
+
+//=============================================================================
+// Return the number of open connections
+//=============================================================================
+int Net::getConnectionCount() const
+{
+    int count = 0;
+
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        if (connections[i]->socket != NULL)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+//=============================================================================
+// Finish connecting a TCP client without waiting
+//=============================================================================
+bool Net::connectClient()
+{
+    if (streamSocket == NULL)
+    {
+        return (type == netNS::CONNECTED_TCP);
+    }
+
+    const int status = SDLNet_GetConnectionStatus(streamSocket);
+
+    if (status == 0)
+    {
+        return true;            // still connecting
+    }
+
+    if (status < 0)
+    {
+        return false;
+    }
+
+    // the connection table owns the socket from here on
+    if (addConnection(streamSocket) < 0)
+    {
+        return false;
+    }
+
+    streamSocket = NULL;
+
+    return true;
+}
+
+//=============================================================================
+// Add a connected socket to the table
+//=============================================================================
+int Net::addConnection(SDLNet_StreamSocket* socket)
+{
+    size_t id = 0;
+
+    while (id < connections.size() && connections[id]->socket != NULL)
+    {
+        id++;
+    }
+
+    if (id == connections.size())
+    {
+        if ((int)id >= netNS::MAX_CONNECTIONS)
+        {
+            return -1;
+        }
+
+        connections.push_back(new NET_CONNECTION);
+    }
+
+    NET_CONNECTION* pConnection = connections[id];
+
+    pConnection->socket = socket;
+    pConnection->addr = SDLNet_GetStreamSocketAddress(socket);
+    pConnection->start = 0;
+    pConnection->size = 0;
+
+    type = netNS::CONNECTED_TCP;
+
+    return (int)id;
+}
+
+//=============================================================================
+// Read whatever the connection has into its buffer
+//=============================================================================
+bool Net::readConnection(int connection)
+{
+    NET_CONNECTION* pConnection = connections[connection];
+    const int unread = pConnection->size - pConnection->start;
+
+    if (pConnection->socket == NULL)
+    {
+        return false;
+    }
+
+    // drop the messages already returned
+    if (pConnection->start > 0)
+    {
+        pConnection->size -= pConnection->start;
+        SDL_memmove(pConnection->buffer, &pConnection->buffer[pConnection->start],
+            pConnection->size);
+        pConnection->start = 0;
+    }
+
+    while (pConnection->size < netNS::STREAM_BUFFER)
+    {
+        const int ret = SDLNet_ReadFromStreamSocket(pConnection->socket,
+            &pConnection->buffer[pConnection->size],
+            netNS::STREAM_BUFFER - pConnection->size);
+
+        if (ret < 0)
+        {
+            closeConnection(connection);            // remote disconnect
+            return true;
+        }
+
+        if (ret == 0)
+        {
+            break;
+        }
+
+        pConnection->size += ret;
+    }
+
+    // a message longer than the buffer can never complete
+    if (pConnection->size >= netNS::MESSAGE_HEADER)
+    {
+        Uint16 length = 0;
+
+        SDL_memcpy(&length, pConnection->buffer, netNS::MESSAGE_HEADER);
+
+        if (netNS::MESSAGE_HEADER + SDL_Swap16LE(length) > netNS::STREAM_BUFFER)
+        {
+            closeConnection(connection);
+            return true;
+        }
+    }
+
+    return (pConnection->size > unread);
+}
+
+//=============================================================================
+// Read data, return sender's IP
+//=============================================================================
+int Net::readData(char* data, int& size, char* senderIP)
+{
+    char* remoteIP = NULL;
+    int readSize = size;
+
+    size = 0;           // assume 0 bytes read, changed if read successful
+    if (bound == false)         // no receive from unbound socket
+    {
+        return netNS::NET_OK;
+    }
+
+    if (transport != NULL)
+    {
+        // oldest queued datagram, the rest stay queued for the next call
+        const NET_PACKET* packet = receive();
+
+        if (packet != NULL)
+        {
+            remoteIP = (char*)SDLNet_GetAddressString(packet->addr);
+
+            if (remoteIP != NULL)
+            {
+                SDL_strlcpy(senderIP, remoteIP, netNS::IP_SIZE);
+            }
+
+            if (packet->size < readSize)
+            {
+                readSize = packet->size;
+            }
+
+            SDL_memcpy(data, packet->data, readSize);
+            size = readSize;
+        }
+    }
+
+    if (type == netNS::UNCONNECTED_TCP || type == netNS::CONNECTED_TCP)
+    {
+        int connection = -1;
+        const char* message = NULL;
+        int messageSize = 0;
+
+        bool received = receiveStream(connection, message, messageSize);
+
+        // everything read has been returned, poll the sockets without waiting
+        if (received == false)
+        {
+            if (serviceConnections(0) < 0)
+            {
+                return netNS::NET_ERROR;
+            }
+
+            received = receiveStream(connection, message, messageSize);
+        }
+
+        if (received)
+        {
+            remoteIP = (char*)SDLNet_GetAddressString(connections[connection]->addr);
+
+            if (remoteIP != NULL)
+            {
+                SDL_strlcpy(senderIP, remoteIP, netNS::IP_SIZE);
+            }
+
+            if (messageSize < readSize)
+            {
+                readSize = messageSize;
+            }
+
+            SDL_memcpy(data, message, readSize);
+            size = readSize;
+        }
+    }
+
+    return netNS::NET_OK;
+}
+
+//=============================================================================
+// Read data, return sender's IP and port
+//=============================================================================
+int Net::readData(char* data, int& size, char* senderIP, unsigned short& port)
+{
+    char* remoteIP = NULL;
+    int readSize = size;
+
+    size = 0;           // assume 0 bytes read, changed if read successful
+    if (bound == false)         // no receive from unbound socket
+    {
+        return netNS::NET_OK;
+    }
+
+    if (transport != NULL)
+    {
+        // oldest queued datagram, the rest stay queued for the next call
+        const NET_PACKET* packet = receive();
+
+        if (packet != NULL)
+        {
+            remoteIP = (char*)SDLNet_GetAddressString(packet->addr);
+
+            if (remoteIP != NULL)
+            {
+                SDL_strlcpy(senderIP, remoteIP, netNS::IP_SIZE);
+            }
+
+            if (packet->size < readSize)
+            {
+                readSize = packet->size;
+            }
+
+            SDL_memcpy(data, packet->data, readSize);
+            size = readSize;
+            port = packet->port;
+        }
+    }
+
+    if (type == netNS::UNCONNECTED_TCP || type == netNS::CONNECTED_TCP)
+    {
+        int connection = -1;
+        const char* message = NULL;
+        int messageSize = 0;
+
+        bool received = receiveStream(connection, message, messageSize);
+
+        // everything read has been returned, poll the sockets without waiting
+        if (received == false)
+        {
+            if (serviceConnections(0) < 0)
+            {
+                return netNS::NET_ERROR;
+            }
+
+            received = receiveStream(connection, message, messageSize);
+        }
+
+        if (received)
+        {
+            remoteIP = (char*)SDLNet_GetAddressString(connections[connection]->addr);
+
+            if (remoteIP != NULL)
+            {
+                SDL_strlcpy(senderIP, remoteIP, netNS::IP_SIZE);
+            }
+
+            if (messageSize < readSize)
+            {
+                readSize = messageSize;
+            }
+
+            SDL_memcpy(data, message, readSize);
+            size = readSize;
+        }
+    }
+
+    return netNS::NET_OK;
+}
+
+//=============================================================================
+// Receive the oldest queued datagram
+//=============================================================================
+const NET_PACKET* Net::receive()
+{
+    const NET_PACKET* packet = NULL;
+
+    if (receiveBatch(&packet, 1) == 0)
+    {
+        return NULL;
+    }
+
+    return packet;
+}
+
+//=============================================================================
+// Receive up to maxPackets queued datagrams
+//=============================================================================
+int Net::receiveBatch(const NET_PACKET** packets, int maxPackets)
+{
+    releasePackets();
+
+    if (receiveQueue == NULL || packets == NULL || maxPackets <= 0)
+    {
+        return 0;
+    }
+
+    const Uint32 tail = SDL_GetAtomicU32(&receiveTail);
+    const Uint32 queued = SDL_GetAtomicU32(&receiveHead) - tail;
+    const int count = (queued < (Uint32)maxPackets) ? (int)queued : maxPackets;
+
+    for (int i = 0; i < count; i++)
+    {
+        packets[i] = &receiveQueue[(tail + i) % netNS::RECEIVE_SLOTS];
+    }
+
+    receiveTaken = count;
+
+    return count;
+}
+
+//=============================================================================
+// Return the packets handed out by receive() to the worker thread
+//=============================================================================
+void Net::releasePackets()
+{
+    if (receiveTaken == 0)
+    {
+        return;
+    }
+
+    const Uint32 tail = SDL_GetAtomicU32(&receiveTail);
+
+    for (Uint32 i = 0; i < receiveTaken; i++)
+    {
+        NET_PACKET& packet = receiveQueue[(tail + i) % netNS::RECEIVE_SLOTS];
+
+        SDLNet_UnrefAddress(packet.addr);
+        packet.addr = NULL;
+    }
+
+    SDL_SetAtomicU32(&receiveTail, tail + receiveTaken);
+    receiveTaken = 0;
+}
+
+//=============================================================================
+// Worker thread, sends queued datagrams and queues received ones
+// SDL_net can't wait on the socket and the send queue together, so the wait
+// for input is WORKER_WAIT at most and none while sends are queued.
+//=============================================================================
+int SDLCALL Net::workerThread(void* data)
+{
+    Net* net = (Net*)data;
+
+    while (SDL_GetAtomicInt(&net->working) != 0)
+    {
+        net->flushSends();
+
+        Uint32 head = SDL_GetAtomicU32(&net->receiveHead);
+
+        if (head - SDL_GetAtomicU32(&net->receiveTail) >= netNS::RECEIVE_SLOTS)
+        {
+            SDL_Delay(1);           // full, leave datagrams in the socket
+            continue;
+        }
+
+        const Sint32 wait = (SDL_GetAtomicU32(&net->sendHead) !=
+            SDL_GetAtomicU32(&net->sendTail)) ? 0 : netNS::WORKER_WAIT;
+
+        if (net->transport->wait(wait) <= 0)
+        {
+            continue;
+        }
+
+        // take everything that arrived while there is room
+        while (head - SDL_GetAtomicU32(&net->receiveTail) < netNS::RECEIVE_SLOTS)
+        {
+            NET_PACKET& packet = net->receiveQueue[head % netNS::RECEIVE_SLOTS];
+
+            // read straight into the queue, stamped by the transport
+            if (net->transport->receive(packet) <= 0)
+            {
+                break;
+            }
+
+            // no remoteAddr on a transport, anyone may send
+            if (net->mode == netNS::CLIENT && net->remoteAddr != NULL &&
+                SDLNet_CompareAddresses(packet.addr, net->remoteAddr) != 0)
+            {
+                SDLNet_UnrefAddress(packet.addr);           // packet from non-server address
+                packet.addr = NULL;
+                continue;
+            }
+
+            head++;
+            SDL_SetAtomicU32(&net->receiveHead, head);
+        }
+    }
+
+    net->flushSends();          // don't lose the last sends on close
+
+    return 0;
+}
+
+//=============================================================================
+// Send everything in the send queue
+//=============================================================================
+void Net::flushSends()
+{
+    Uint32 tail = SDL_GetAtomicU32(&sendTail);
+    const Uint32 head = SDL_GetAtomicU32(&sendHead);
+
+    while (tail != head)
+    {
+        NET_SEND& entry = sendQueue[tail % netNS::SEND_SLOTS];
+
+        // the game thread takes the buffer back once sendTail passes it
+        transport->send(entry.addr, entry.port, entry.buffer->data, entry.buffer->size);
+        SDLNet_UnrefAddress(entry.addr);
+        entry.addr = NULL;
+
+        tail++;
+        SDL_SetAtomicU32(&sendTail, tail);
+    }
+}
+
+//=============================================================================
+// Close socket and free resources.
+//=============================================================================
+int Net::closeSocket()
+{
+    type = netNS::UNCONNECTED;
+    bound = false;
+    netInitialized = false;
+
+    // stop the worker before its socket goes away
+    if (worker != NULL)
+    {
+        SDL_SetAtomicInt(&working, 0);
+        SDL_WaitThread(worker, NULL);
+        worker = NULL;
+    }
+
+    if (receiveQueue != NULL)
+    {
+        releasePackets();
+
+        const Uint32 head = SDL_GetAtomicU32(&receiveHead);
+
+        for (Uint32 i = SDL_GetAtomicU32(&receiveTail); i != head; i++)
+        {
+            SDLNet_UnrefAddress(receiveQueue[i % netNS::RECEIVE_SLOTS].addr);
+        }
+
+        delete[] receiveQueue;
+        receiveQueue = NULL;
+    }
+
+    if (sendQueue != NULL)
+    {
+        reclaimBuffers();           // the worker sent everything before it stopped
+        delete[] sendQueue;
+        sendQueue = NULL;
+    }
+
+    for (size_t i = 0; i < peers.size(); i++)
+    {
+        removePeer((int)i);
+    }
+
+    peers.clear();
+
+    for (size_t i = 0; i < bufferPool.size(); i++)
+    {
+        delete bufferPool[i];
+    }
+
+    bufferPool.clear();
+
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        closeConnection((int)i);
+        delete connections[i];
+    }
+
+    connections.clear();
+    nextConnection = 0;
+
+    if (transport != userTransport)
+    {
+        delete transport;           // the socket Net created
+    }
+
+    SDLNet_DestroyStreamSocket(streamSocket);
+    SDLNet_DestroyServer(serverSocket);
+    transport = NULL;
+    streamSocket = NULL;
+    serverSocket = NULL;
     SDLNet_Quit();
 
     return netNS::NET_OK;
@@ -601,7 +1550,7 @@ std::string Net::getError(int error) const
 {
     std::string errorStr;
 
-    if (error < 0 || error > netNS::NET_ERROR_CODES)
+    if (error < 0 || error >= netNS::NET_ERROR_CODES)
     {
         error = netNS::NET_UNKNOWN_NETWORK_ERROR;
     }
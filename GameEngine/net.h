@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 #include <SDL3_net\SDL_net.h>
 #include "constants.h"
 #include "gameError.h"
@@ -42,6 +43,7 @@ namespace netNS
         NET_DOMAIN_NOT_FOUND = 8,
         NET_REMOTE_DISCONNECT = 9,
         NET_UNKNOWN_NETWORK_ERROR = 10,
+        NET_ADDRESS_PENDING = 11,
         NET_ERROR_CODES
     };
 
@@ -56,11 +58,26 @@ namespace netNS
         "Connect failed: ",
         "Port already in use: ",
         "Domain not found: ",
-        "Remote Disconnect: "
-        "Unknown network error: "
+        "Remote Disconnect: ",
+        "Unknown network error: ",
+        "Address not resolved yet: "
     };
 
-    const int PACKETS_PER_SEC = 30;         // Number of packets to send per second
+    const Uint32 RECEIVE_SLOTS = 256;           // queued datagrams, power of two
+    const int MESSAGE_HEADER = 2;               // length in front of gathered messages
+
+    // Peer state
+    const int PEER_FREE = 0;
+    const int PEER_RESOLVING = 1;
+    const int PEER_READY = 2;
+    const int PEER_FAILED = 3;
+    const Uint32 SEND_SLOTS = 256;              // queued outgoing datagrams, power of two
+    const Sint32 WORKER_WAIT = 1;               // worker wait for input in milliseconds
+
+    const int MAX_CONNECTIONS = 128;            // TCP clients a server accepts
+    const int STREAM_BUFFER = BUFFER_LENGTH * 2;            // receive buffer per connection
+
+    const int PACKETS_PER_SEC = 20;         // Number of packets to send per second
     const float NET_TIME = 1.0f / PACKETS_PER_SEC;          // time between net transmissions
     const int MAX_ERRORS = PACKETS_PER_SEC * 30;            // Packets/Sec * 30 Sec
     const int MAX_COMM_WARNINGS = 10;           // max packets out of sync before time reset
@@ -73,11 +90,58 @@ namespace netNS
     const int REMOTE_DISCONNECT = 0x2775;
 }
 
+class Transport;
+
+// Datagram in the receive or send queue
+typedef struct _NET_PACKET
+{
+    SDLNet_Address* addr;           // sender, valid until the packet is released
+    unsigned short port;            // sender port
+    int size;
+    Uint64 ticks;                   // SDL_GetTicksNS() or simulator time when read
+    char data[netNS::BUFFER_LENGTH];
+} NET_PACKET;
+
+// Pooled datagram buffer, see Net::acquireBuffer()
+typedef struct _NET_BUFFER
+{
+    int size;                       // bytes used
+    char data[netNS::BUFFER_LENGTH];
+} NET_BUFFER;
+
+// Datagram in the send queue, the buffer goes back to the pool once sent
+typedef struct _NET_SEND
+{
+    SDLNet_Address* addr;           // ref held until it is sent
+    unsigned short port;
+    NET_BUFFER* buffer;
+} NET_SEND;
+
+// Remote end of a connection, the address is resolved once and kept
+typedef struct _NET_PEER
+{
+    std::string host;               // name or IP it was added with
+    unsigned short port;
+    SDLNet_Address* addr;           // ref held while the peer exists
+    int state;                      // PEER_FREE, PEER_RESOLVING, ...
+} NET_PEER;
+
+// TCP connection, framed messages are reassembled in buffer
+typedef struct _NET_CONNECTION
+{
+    SDLNet_StreamSocket* socket;    // NULL when the slot is free
+    SDLNet_Address* addr;           // ref held while connected
+    int start;                      // first unread byte
+    int size;                       // bytes in buffer
+    char buffer[netNS::STREAM_BUFFER];
+} NET_CONNECTION;
+
 class Net
 {
 private:
     // SDL
-    SDLNet_DatagramSocket* datagramSocket;          // UDP\DATAGRAM socket client\server
+    Transport* transport;           // UDP\DATAGRAM transport client\server
+    Transport* userTransport;           // set by setTransport(), not owned
     SDLNet_StreamSocket* streamSocket;          // TCP\STREAM socket client\server
     SDLNet_Server* serverSocket;
     SDLNet_Address* remoteAddr;         // remote address
@@ -90,6 +154,77 @@ private:
     bool    netInitialized;
     bool    bound;
 
+    // UDP worker thread, the only user of transport while it runs.
+    // Each queue has one producer and one consumer.
+    NET_PACKET*   receiveQueue;         // RECEIVE_SLOTS packets
+    SDL_AtomicU32 receiveHead;          // written by the worker thread
+    SDL_AtomicU32 receiveTail;          // written by the game thread
+    Uint32        receiveTaken;         // packets handed out, released next call
+    NET_SEND*     sendQueue;            // SEND_SLOTS datagrams
+    SDL_AtomicU32 sendHead;             // written by the game thread
+    SDL_AtomicU32 sendTail;             // written by the worker thread
+    Uint32        sendReclaimed;        // sent datagrams whose buffers are back in the pool
+    SDL_Thread*   worker;
+    SDL_AtomicInt working;
+
+    // send buffers
+    std::vector<NET_BUFFER*> bufferPool;          // free buffers
+
+    // connection table
+    std::vector<NET_PEER> peers;
+
+    // TCP connections, a client has one
+    std::vector<NET_CONNECTION*> connections;
+    std::vector<void*> waitList;            // sockets for SDLNet_WaitUntilInputAvailable
+    std::vector<int> waitConnections;       // connection of each waitList socket, -1 for the server
+    size_t  nextConnection;         // where receiveStream starts looking
+
+    //=============================================================================
+    // Finish connecting a TCP client without waiting. Returns false if the
+    // connection failed.
+    //=============================================================================
+    bool connectClient();
+
+    //=============================================================================
+    // Add a connected socket to the table. Returns its id, or -1 if the table
+    // is full.
+    //=============================================================================
+    int addConnection(SDLNet_StreamSocket* socket);
+
+    //=============================================================================
+    // Read whatever the connection has into its buffer. Closes it on error.
+    // Returns true if anything arrived or the connection closed.
+    //=============================================================================
+    bool readConnection(int connection);
+
+    //=============================================================================
+    // Return true if the peer's address is ready, checking a pending
+    // resolution without waiting for it.
+    //=============================================================================
+    bool isPeerReady(NET_PEER& peer);
+
+    //=============================================================================
+    // Worker thread, sends queued datagrams and moves received ones from the
+    // socket to the receive queue. When the receive queue is full datagrams
+    // are left in the socket.
+    //=============================================================================
+    static int SDLCALL workerThread(void* data);
+
+    //=============================================================================
+    // Send everything in the send queue (worker thread)
+    //=============================================================================
+    void flushSends();
+
+    //=============================================================================
+    // Return the packets handed out by receive() to the worker thread
+    //=============================================================================
+    void releasePackets();
+
+    //=============================================================================
+    // Put the buffers the worker thread has sent back in the pool
+    //=============================================================================
+    void reclaimBuffers();
+
     //=============================================================================
     // Initialize network (for class use only)
     // Called by createServer and creatClient
@@ -104,6 +239,16 @@ public:
     Net();
     ~Net();
 
+    //=============================================================================
+    // Use transport for UDP instead of a socket, e.g. a LoopbackTransport to
+    // run client and server in one process. Call before createServer() or
+    // createClient(). The caller keeps ownership, NULL goes back to sockets.
+    // A UDP client on a transport doesn't resolve the server or local
+    // address: it sends with a NULL address to the port and takes
+    // datagrams from any sender.
+    //=============================================================================
+    void setTransport(Transport* pTransport);
+
     //=============================================================================
     // Setup network for use as server
     // May not be configured as Server and Client at the same time. 
@@ -146,6 +291,79 @@ public:
     int sendData(const char* data, int& size, const char* remoteIP,
         const unsigned short port);
 
+    //=============================================================================
+    // Queue a datagram for the worker thread (UDP). The socket is never
+    // touched on the calling thread.
+    //
+    //   *data = Caller owned data, copied into a pooled buffer during the call
+    //   size = Number of bytes to send
+    //   *buffer = Pooled buffer from acquireBuffer(), sent as it is. Net owns
+    //     it from the call on and puts it back in the pool once it is sent,
+    //     or at once on error.
+    //   *addr = Destination, NULL for the server in client mode
+    //   port = Destination port number
+    //
+    //   Returns NET_OK on success.
+    //   Returns int code on error, NET_ERROR if the send queue is full.
+    //=============================================================================
+    int send(const void* data, int size, SDLNet_Address* addr, unsigned short port);
+    int send(NET_BUFFER* buffer, SDLNet_Address* addr, unsigned short port);
+
+    //=============================================================================
+    // Send several small messages gathered into as few datagrams as possible
+    // (UDP). Each message is packed with a MESSAGE_HEADER byte length, read
+    // them back with readMessage().
+    //
+    //   Returns NET_OK on success.
+    //   Returns int code on error, or NET_ERROR if a message can never fit.
+    //=============================================================================
+    int sendMessages(const void* const* messages, const int* sizes, int count,
+        SDLNet_Address* addr, unsigned short port);
+
+    //=============================================================================
+    // Connection table (UDP)
+    //
+    //   addPeer starts resolving host in the background and returns the peer
+    //   id at once. findPeer returns the id of a peer added with the same host
+    //   and port, or the id of the peer a packet came from, -1 if none.
+    //   acceptPeer adds the sender of a received packet, its address is
+    //   already resolved.
+    //   sendTo sends to a peer, NET_ADDRESS_PENDING until it is resolved.
+    //   removePeer releases the peer's address.
+    //=============================================================================
+    int addPeer(const char* host, unsigned short port);
+    int findPeer(const char* host, unsigned short port) const;
+    int findPeer(const NET_PACKET* packet) const;
+    int acceptPeer(const NET_PACKET* packet);
+    int sendTo(int peer, const void* data, int size);
+    void removePeer(int peer);
+
+    //=============================================================================
+    // Pooled send buffers (game thread only). Build a datagram in place with
+    // appendMessage() or by writing data and size and send it with
+    // send(buffer, ...), which takes the buffer back. Give back a buffer
+    // that is not sent with releaseBuffer().
+    //=============================================================================
+    NET_BUFFER* acquireBuffer();
+    void releaseBuffer(NET_BUFFER* buffer);
+
+    //=============================================================================
+    // Pack a message into buffer. Returns false if it does not fit.
+    //=============================================================================
+    static bool appendMessage(NET_BUFFER* buffer, const void* data, int size);
+
+    //=============================================================================
+    // Read the next gathered message from a datagram
+    //
+    //   offset = Start at 0, advanced past the message
+    //   *message = Set to the message inside data
+    //   messageSize = Set to the message length
+    //
+    //   Returns false when there are no more messages or the data is cut short.
+    //=============================================================================
+    static bool readMessage(const char* data, int size, int& offset,
+        const char*& message, int& messageSize);
+
     //=============================================================================
     // Read data
     // 
@@ -160,6 +378,46 @@ public:
     int readData(char* data, int& size, char* senderIP);
     int readData(char* data, int& size, char* senderIP, unsigned short& port);
 
+    //=============================================================================
+    // Receive queued datagrams (UDP)
+    //
+    //   Datagrams are queued by the worker thread as they arrive, stamped
+    //   with the time they were read, none are lost while the queue has
+    //   room. The returned packets stay valid until the next call to
+    //   receive() or receiveBatch().
+    //
+    //   receive returns the oldest packet or NULL if none are queued.
+    //   receiveBatch fills packets with up to maxPackets, oldest first, and
+    //   returns the number filled.
+    //=============================================================================
+    const NET_PACKET* receive();
+    int receiveBatch(const NET_PACKET** packets, int maxPackets);
+
+    //=============================================================================
+    // TCP connections
+    //
+    //   serviceConnections accepts every waiting client (server) or finishes
+    //   connecting (client), waits up to timeout milliseconds for input on any
+    //   socket and reads what arrived. It is the only place sockets are
+    //   polled: call it once per tick. readData() calls it only once every
+    //   message already read has been returned. Returns the number of
+    //   connections, or -1 if a client connection failed.
+    //
+    //   Messages are framed with a MESSAGE_HEADER byte length. receiveStream
+    //   returns the next complete message from any connection, taking turns,
+    //   false if there is none. message stays valid until the next call to
+    //   serviceConnections().
+    //   sendStream sends one framed message on a connection.
+    //   findConnection returns the id of the connection from remoteIP, -1 if
+    //   none. closeConnection closes one connection.
+    //=============================================================================
+    int serviceConnections(Sint32 timeout);
+    bool receiveStream(int& connection, const char*& message, int& size);
+    int sendStream(int connection, const void* data, int size);
+    int findConnection(const char* remoteIP) const;
+    void closeConnection(int connection);
+    int getConnectionCount() const;
+
     //=============================================================================
     // Close socket and free resources
     // 
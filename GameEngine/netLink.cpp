@@ -0,0 +1,592 @@
+#include "netLink.h"
+
+// Little-endian fields in packets
+static void write16(char* p, Uint16 value)
+{
+    value = SDL_Swap16LE(value);
+    SDL_memcpy(p, &value, sizeof(value));
+}
+
+static void write32(char* p, Uint32 value)
+{
+    value = SDL_Swap32LE(value);
+    SDL_memcpy(p, &value, sizeof(value));
+}
+
+static Uint16 read16(const char* p)
+{
+    Uint16 value;
+    SDL_memcpy(&value, p, sizeof(value));
+    return SDL_Swap16LE(value);
+}
+
+static Uint32 read32(const char* p)
+{
+    Uint32 value;
+    SDL_memcpy(&value, p, sizeof(value));
+    return SDL_Swap32LE(value);
+}
+
+// Write a message header and data at buffer[size], advance size
+static void writeMessage(char* buffer, int& size, int channel, Uint16 id,
+    const void* data, int length)
+{
+    buffer[size] = (char)channel;
+    write16(&buffer[size + 1], id);
+    write16(&buffer[size + 3], (Uint16)length);
+    SDL_memcpy(&buffer[size + netLinkNS::MESSAGE_HEADER], data, length);
+    size += netLinkNS::MESSAGE_HEADER + length;
+}
+
+// True if sequence a is newer than b, allowing for wrap around
+static bool sequenceGreater(Uint16 a, Uint16 b)
+{
+    return (Sint16)(a - b) > 0;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+NetLink::NetLink()
+{
+    net = NULL;
+    addr = NULL;
+    port = 0;
+    SDL_memset(channels, 0, sizeof(channels));
+    channelCount = 0;
+    sequence = 0;
+    remoteSequence = 0;
+    ackBits = 0;
+    received = false;
+    ackPending = false;
+    sentPackets = NULL;
+    rtt = netLinkNS::RTT_START;
+    pendingSize = 0;
+    inboxSize = 0;
+    inboxRead = 0;
+    nextChannel = 0;
+    packetsSent = 0;
+    messagesResent = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+NetLink::~NetLink()
+{
+    release();
+}
+
+//=============================================================================
+// Set up the link
+//=============================================================================
+bool NetLink::initialize(Net* pNet, SDLNet_Address* address, unsigned short port,
+    const int* types, int count)
+{
+    release();
+
+    if (pNet == NULL || types == NULL || count <= 0 ||
+        count > netLinkNS::MAX_CHANNELS)
+    {
+        return false;
+    }
+
+    net = pNet;
+    addr = (address != NULL) ? SDLNet_RefAddress(address) : NULL;
+    this->port = port;
+    channelCount = count;
+
+    for (int i = 0; i < count; i++)
+    {
+        channels[i].type = types[i];
+
+        if (types[i] == netLinkNS::RELIABLE_ORDERED)
+        {
+            channels[i].sendSlots = new LINK_MESSAGE[netLinkNS::MESSAGE_SLOTS];
+            channels[i].receiveSlots = new LINK_MESSAGE[netLinkNS::MESSAGE_SLOTS];
+
+            for (int j = 0; j < netLinkNS::MESSAGE_SLOTS; j++)
+            {
+                channels[i].sendSlots[j].used = false;
+                channels[i].receiveSlots[j].used = false;
+            }
+        }
+    }
+
+    sentPackets = new LINK_PACKET[netLinkNS::SENT_SLOTS];
+
+    for (int i = 0; i < netLinkNS::SENT_SLOTS; i++)
+    {
+        sentPackets[i].used = false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Free the channel buffers and forget the link state
+//=============================================================================
+void NetLink::release()
+{
+    for (int i = 0; i < netLinkNS::MAX_CHANNELS; i++)
+    {
+        delete[] channels[i].sendSlots;
+        delete[] channels[i].receiveSlots;
+    }
+
+    delete[] sentPackets;
+    sentPackets = NULL;
+
+    SDLNet_UnrefAddress(addr);
+    addr = NULL;
+    net = NULL;
+
+    SDL_memset(channels, 0, sizeof(channels));
+    channelCount = 0;
+    sequence = 0;
+    remoteSequence = 0;
+    ackBits = 0;
+    received = false;
+    ackPending = false;
+    rtt = netLinkNS::RTT_START;
+    pendingSize = 0;
+    inboxSize = 0;
+    inboxRead = 0;
+    nextChannel = 0;
+}
+
+//=============================================================================
+// Queue a message on a channel
+//=============================================================================
+bool NetLink::send(int channel, const void* data, int size)
+{
+    if (channel < 0 || channel >= channelCount || size < 0 ||
+        size > netLinkNS::MAX_MESSAGE)
+    {
+        return false;
+    }
+
+    LINK_CHANNEL& ch = channels[channel];
+
+    if (ch.type == netLinkNS::RELIABLE_ORDERED)
+    {
+        if ((Uint16)(ch.sendId - ch.oldestUnacked) >= netLinkNS::MESSAGE_SLOTS)
+        {
+            return false;           // too many waiting for acks
+        }
+
+        LINK_MESSAGE& message = ch.sendSlots[ch.sendId % netLinkNS::MESSAGE_SLOTS];
+
+        message.id = ch.sendId;
+        message.used = true;
+        message.sent = 0;
+        message.size = size;
+        SDL_memcpy(message.data, data, size);
+    }
+    else
+    {
+        if (pendingSize + netLinkNS::MESSAGE_HEADER + size > netLinkNS::PENDING_SIZE)
+        {
+            return false;
+        }
+
+        writeMessage(pending, pendingSize, channel, ch.sendId, data, size);
+    }
+
+    ch.sendId++;
+
+    return true;
+}
+
+//=============================================================================
+// Send queued messages, due resends and acks
+//=============================================================================
+int NetLink::update(Uint64 now)
+{
+    if (net == NULL)
+    {
+        return netNS::NET_ERROR;
+    }
+
+    const Uint64 resend = (Uint64)(SDL_max(rtt * netLinkNS::RESEND_FACTOR,
+        netLinkNS::RESEND_MIN) * 1000000.0f);           // milliseconds to ns
+    char packet[netLinkNS::MAX_PACKET];
+    int size = netLinkNS::PACKET_HEADER;
+    LINK_PACKET* record = &beginPacket();
+    int status = netNS::NET_OK;
+
+    // reliable messages never sent or not acked in time, oldest first
+    for (int c = 0; c < channelCount; c++)
+    {
+        LINK_CHANNEL& ch = channels[c];
+
+        if (ch.type != netLinkNS::RELIABLE_ORDERED)
+        {
+            continue;
+        }
+
+        for (Uint16 id = ch.oldestUnacked; id != ch.sendId; id++)
+        {
+            LINK_MESSAGE& message = ch.sendSlots[id % netLinkNS::MESSAGE_SLOTS];
+
+            if (message.used == false ||
+                (message.sent != 0 && now - message.sent < resend))
+            {
+                continue;
+            }
+
+            if (size + netLinkNS::MESSAGE_HEADER + message.size > netLinkNS::MAX_PACKET ||
+                record->count == netLinkNS::MESSAGES_PER_PACKET)
+            {
+                status = sendPacket(packet, size, now);
+
+                if (status != netNS::NET_OK)
+                {
+                    return status;
+                }
+
+                size = netLinkNS::PACKET_HEADER;
+                record = &sentPackets[sequence % netLinkNS::SENT_SLOTS];
+            }
+
+            if (message.sent != 0)
+            {
+                messagesResent++;
+            }
+
+            writeMessage(packet, size, c, id, message.data, message.size);
+            message.sent = now;
+            record->channel[record->count] = (Uint8)c;
+            record->id[record->count] = id;
+            record->count++;
+        }
+    }
+
+    // unreliable and sequenced messages, already framed
+    int offset = 0;
+
+    while (offset < pendingSize)
+    {
+        const int length = netLinkNS::MESSAGE_HEADER + read16(&pending[offset + 3]);
+
+        if (size + length > netLinkNS::MAX_PACKET)
+        {
+            status = sendPacket(packet, size, now);
+
+            if (status != netNS::NET_OK)
+            {
+                break;
+            }
+
+            size = netLinkNS::PACKET_HEADER;
+        }
+
+        SDL_memcpy(&packet[size], &pending[offset], length);
+        size += length;
+        offset += length;
+    }
+
+    pendingSize = 0;            // unreliable, not kept after an error
+
+    // a packet with only acks if nothing else is going
+    if (status == netNS::NET_OK && (size > netLinkNS::PACKET_HEADER || ackPending))
+    {
+        status = sendPacket(packet, size, now);
+    }
+
+    return status;
+}
+
+//=============================================================================
+// Start the record for the packet with the current sequence
+//=============================================================================
+LINK_PACKET& NetLink::beginPacket()
+{
+    LINK_PACKET& record = sentPackets[sequence % netLinkNS::SENT_SLOTS];
+
+    record.sequence = sequence;
+    record.used = false;
+    record.acked = false;
+    record.count = 0;
+
+    return record;
+}
+
+//=============================================================================
+// Write the header, send the packet and begin the next one
+//=============================================================================
+int NetLink::sendPacket(char* packet, int size, Uint64 now)
+{
+    LINK_PACKET& record = sentPackets[sequence % netLinkNS::SENT_SLOTS];
+
+    write16(&packet[0], sequence);
+    write16(&packet[2], remoteSequence);
+    write32(&packet[4], received ? ackBits : 0);
+
+    record.used = true;
+    record.sent = now;
+
+    const int status = net->send(packet, size, addr, port);
+
+    sequence++;
+    packetsSent++;
+    ackPending = false;
+    beginPacket();
+
+    return status;
+}
+
+//=============================================================================
+// Process a datagram received from the remote end
+//=============================================================================
+bool NetLink::processPacket(const char* data, int size, Uint64 ticks)
+{
+    if (net == NULL || data == NULL || size < netLinkNS::PACKET_HEADER)
+    {
+        return false;
+    }
+
+    // check every message before anything is used
+    for (int offset = netLinkNS::PACKET_HEADER; offset < size; )
+    {
+        if (offset + netLinkNS::MESSAGE_HEADER > size)
+        {
+            return false;
+        }
+
+        const int channel = (Uint8)data[offset];
+        const int length = read16(&data[offset + 3]);
+
+        if (channel >= channelCount || length > netLinkNS::MAX_MESSAGE ||
+            offset + netLinkNS::MESSAGE_HEADER + length > size)
+        {
+            return false;
+        }
+
+        offset += netLinkNS::MESSAGE_HEADER + length;
+    }
+
+    const Uint16 remote = read16(&data[0]);
+    const Uint16 ack = read16(&data[2]);
+    const Uint32 bits = read32(&data[4]);
+
+    if (receivePacket(remote) == false)
+    {
+        return true;            // duplicate, its messages were handled
+    }
+
+    ackPacket(ack, ticks);
+
+    for (int i = 0; i < 32; i++)
+    {
+        if (bits & (1u << i))
+        {
+            ackPacket((Uint16)(ack - 1 - i), ticks);
+        }
+    }
+
+    for (int offset = netLinkNS::PACKET_HEADER; offset < size; )
+    {
+        const int channel = (Uint8)data[offset];
+        const Uint16 id = read16(&data[offset + 1]);
+        const int length = read16(&data[offset + 3]);
+        const char* message = &data[offset + netLinkNS::MESSAGE_HEADER];
+        LINK_CHANNEL& ch = channels[channel];
+
+        offset += netLinkNS::MESSAGE_HEADER + length;
+
+        if (ch.type == netLinkNS::RELIABLE_ORDERED)
+        {
+            // ids behind receiveId were delivered, ahead of the window can't be held
+            if ((Uint16)(id - ch.receiveId) >= netLinkNS::MESSAGE_SLOTS)
+            {
+                continue;
+            }
+
+            LINK_MESSAGE& slot = ch.receiveSlots[id % netLinkNS::MESSAGE_SLOTS];
+
+            if (slot.used == false)
+            {
+                slot.id = id;
+                slot.used = true;
+                slot.size = length;
+                SDL_memcpy(slot.data, message, length);
+            }
+
+            continue;
+        }
+
+        if (ch.type == netLinkNS::SEQUENCED)
+        {
+            if ((Sint16)(id - ch.receiveId) < 0)
+            {
+                continue;           // older than one already delivered
+            }
+
+            ch.receiveId = id + 1;
+        }
+
+        if (inboxSize + netLinkNS::MESSAGE_HEADER + length <= netLinkNS::INBOX_SIZE)
+        {
+            writeMessage(inbox, inboxSize, channel, id, message, length);
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Record a received packet sequence for the acks sent back
+//=============================================================================
+bool NetLink::receivePacket(Uint16 remote)
+{
+    ackPending = true;
+
+    if (received == false)
+    {
+        received = true;
+        remoteSequence = remote;
+        ackBits = 0;
+
+        return true;
+    }
+
+    if (sequenceGreater(remote, remoteSequence))
+    {
+        const Uint16 shift = remote - remoteSequence;
+
+        // the old newest packet becomes bit shift - 1
+        ackBits = (shift >= 32) ? 0 : (ackBits << shift);
+
+        if (shift <= 32)
+        {
+            ackBits |= 1u << (shift - 1);
+        }
+
+        remoteSequence = remote;
+
+        return true;
+    }
+
+    const Uint16 behind = remoteSequence - remote;
+
+    if (behind == 0 || behind > 32 || (ackBits & (1u << (behind - 1))))
+    {
+        return false;           // duplicate, or too old to ack
+    }
+
+    ackBits |= 1u << (behind - 1);
+
+    return true;
+}
+
+//=============================================================================
+// Mark a sent packet and its reliable messages acked
+//=============================================================================
+void NetLink::ackPacket(Uint16 ack, Uint64 ticks)
+{
+    LINK_PACKET& record = sentPackets[ack % netLinkNS::SENT_SLOTS];
+
+    if (record.used == false || record.acked || record.sequence != ack)
+    {
+        return;
+    }
+
+    record.acked = true;
+
+    if (ticks > record.sent)
+    {
+        const float sample = (float)(ticks - record.sent) / 1000000.0f;
+
+        rtt += (sample - rtt) * netLinkNS::RTT_SMOOTHING;
+    }
+
+    for (int i = 0; i < record.count; i++)
+    {
+        LINK_CHANNEL& ch = channels[record.channel[i]];
+        LINK_MESSAGE& message = ch.sendSlots[record.id[i] % netLinkNS::MESSAGE_SLOTS];
+
+        if (message.used && message.id == record.id[i])
+        {
+            message.used = false;
+        }
+
+        // slide the window past acked messages
+        while (ch.oldestUnacked != ch.sendId &&
+            ch.sendSlots[ch.oldestUnacked % netLinkNS::MESSAGE_SLOTS].used == false)
+        {
+            ch.oldestUnacked++;
+        }
+    }
+}
+
+//=============================================================================
+// Return the next received message
+//=============================================================================
+bool NetLink::receive(int& channel, const char*& message, int& size)
+{
+    if (inboxRead < inboxSize)
+    {
+        channel = (Uint8)inbox[inboxRead];
+        size = read16(&inbox[inboxRead + 3]);
+        message = &inbox[inboxRead + netLinkNS::MESSAGE_HEADER];
+        inboxRead += netLinkNS::MESSAGE_HEADER + size;
+
+        return true;
+    }
+
+    inboxSize = 0;
+    inboxRead = 0;
+
+    // reliable channels in turn, each in order
+    for (int n = 0; n < channelCount; n++)
+    {
+        const int c = (nextChannel + n) % channelCount;
+        LINK_CHANNEL& ch = channels[c];
+
+        if (ch.type != netLinkNS::RELIABLE_ORDERED)
+        {
+            continue;
+        }
+
+        LINK_MESSAGE& slot = ch.receiveSlots[ch.receiveId % netLinkNS::MESSAGE_SLOTS];
+
+        if (slot.used && slot.id == ch.receiveId)
+        {
+            slot.used = false;          // data stays until the slot is reused
+            ch.receiveId++;
+            channel = c;
+            message = slot.data;
+            size = slot.size;
+            nextChannel = c + 1;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//=============================================================================
+// Return the smoothed round trip time in milliseconds
+//=============================================================================
+float NetLink::getRTT() const
+{
+    return rtt;
+}
+
+//=============================================================================
+// Return the number of packets sent
+//=============================================================================
+Uint32 NetLink::getPacketsSent() const
+{
+    return packetsSent;
+}
+
+//=============================================================================
+// Return the number of reliable messages sent again
+//=============================================================================
+Uint32 NetLink::getMessagesResent() const
+{
+    return messagesResent;
+}
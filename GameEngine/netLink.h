@@ -0,0 +1,180 @@
+#pragma once
+#include "net.h"
+
+//-----------------------------------------------------------------------------
+//
+// NETWORK LINK
+//
+// Reliability over the UDP datagram socket. A NetLink is one remote end with
+// several channels. Every packet carries a sequence number and acks for the
+// last 33 packets received, reliable messages are resent until a packet that
+// carried them is acked. Messages for the link are coalesced into as few
+// packets as possible by update().
+//
+//-----------------------------------------------------------------------------
+
+namespace netLinkNS
+{
+    // Channel type
+    const int UNRELIABLE = 0;           // may be lost, duplicated or out of order
+    const int SEQUENCED = 1;            // may be lost, older messages are dropped
+    const int RELIABLE_ORDERED = 2;         // resent until acked, delivered in order
+
+    const int MAX_CHANNELS = 4;
+    const int MAX_PACKET = 1200;            // bytes, stays under common MTUs
+    const int MAX_MESSAGE = 256;            // bytes in one message
+    const Uint16 MESSAGE_SLOTS = 64;            // unacked reliable messages per channel
+    const int SENT_SLOTS = 256;         // packets remembered for acks
+    const int MESSAGES_PER_PACKET = 32;         // reliable messages tracked per packet
+    const int PACKET_HEADER = 8;            // sequence, ack, ack bits
+    const int MESSAGE_HEADER = 5;           // channel, id, length
+    const int PENDING_SIZE = 8192;          // unreliable bytes waiting for update()
+    const int INBOX_SIZE = 16384;           // unreliable bytes waiting for receive()
+    const float RTT_START = 100.0f;         // milliseconds, until the first ack
+    const float RTT_SMOOTHING = 0.1f;           // weight of a new RTT sample
+    const float RESEND_FACTOR = 1.5f;           // resend after RTT * RESEND_FACTOR
+    const float RESEND_MIN = 20.0f;         // milliseconds
+}
+
+// Reliable message waiting for an ack or for delivery
+typedef struct _LINK_MESSAGE
+{
+    Uint16 id;
+    bool used;
+    Uint64 sent;            // SDL_GetTicksNS() of the last send, 0 if not sent
+    int size;
+    char data[netLinkNS::MAX_MESSAGE];
+} LINK_MESSAGE;
+
+// Sent packet, kept for acks and RTT
+typedef struct _LINK_PACKET
+{
+    Uint16 sequence;
+    bool used;
+    bool acked;
+    Uint64 sent;            // SDL_GetTicksNS()
+    int count;          // reliable messages in the packet
+    Uint8 channel[netLinkNS::MESSAGES_PER_PACKET];
+    Uint16 id[netLinkNS::MESSAGES_PER_PACKET];
+} LINK_PACKET;
+
+typedef struct _LINK_CHANNEL
+{
+    int type;
+    Uint16 sendId;          // id of the next message sent
+    Uint16 oldestUnacked;           // reliable
+    Uint16 receiveId;           // next id delivered, or newest sequenced + 1
+    LINK_MESSAGE* sendSlots;            // reliable, MESSAGE_SLOTS
+    LINK_MESSAGE* receiveSlots;         // reliable, MESSAGE_SLOTS
+} LINK_CHANNEL;
+
+class NetLink
+{
+    // NetLink properties
+private:
+    Net*    net;
+    SDLNet_Address* addr;           // NULL for the server in client mode
+    unsigned short port;
+    LINK_CHANNEL channels[netLinkNS::MAX_CHANNELS];
+    int     channelCount;
+    Uint16  sequence;           // next packet sequence
+    Uint16  remoteSequence;         // newest packet received
+    Uint32  ackBits;            // bit n set if remoteSequence - 1 - n was received
+    bool    received;           // a packet has been received
+    bool    ackPending;         // received packets not acked yet
+    LINK_PACKET* sentPackets;           // SENT_SLOTS
+    float   rtt;            // smoothed round trip time in milliseconds
+    char    pending[netLinkNS::PENDING_SIZE];           // unreliable messages to send
+    int     pendingSize;
+    char    inbox[netLinkNS::INBOX_SIZE];           // unreliable messages received
+    int     inboxSize;
+    int     inboxRead;
+    int     nextChannel;            // where receive() starts on reliable channels
+    Uint32  packetsSent;
+    Uint32  messagesResent;
+
+    // (For internal use only. No user serviceable parts inside.)
+
+    // Start the record for the packet with the current sequence
+    LINK_PACKET& beginPacket();
+
+    // Write the header, send the packet and begin the next one
+    int sendPacket(char* packet, int size, Uint64 now);
+
+    // Mark a sent packet and its reliable messages acked
+    void ackPacket(Uint16 ack, Uint64 ticks);
+
+    // Record a received packet. Returns false if it is a duplicate or too old.
+    bool receivePacket(Uint16 remote);
+
+    // Free the channel buffers
+    void release();
+
+    // Not copyable, the channel and packet buffers are owned
+    NetLink(const NetLink&);
+    NetLink& operator=(const NetLink&);
+
+public:
+    // Constructor
+    NetLink();
+
+    // Destructor
+    virtual ~NetLink();
+
+    //=============================================================================
+    // Set up the link
+    //
+    //   *pNet = Net set up for UDP
+    //   *address = Remote address, NULL for the server in client mode. A ref
+    //     is held while the link uses it.
+    //   port = Remote port
+    //   *types = Channel types, one per channel
+    //   count = Number of channels, up to MAX_CHANNELS
+    //
+    //   Returns false on error.
+    //=============================================================================
+    bool initialize(Net* pNet, SDLNet_Address* address, unsigned short port,
+        const int* types, int count);
+
+    //=============================================================================
+    // Queue a message on a channel, it is sent by the next update().
+    // Returns false if the message is too big or the channel is full.
+    //=============================================================================
+    bool send(int channel, const void* data, int size);
+
+    //=============================================================================
+    // Send queued messages, due resends and acks, coalesced into packets of
+    // up to MAX_PACKET bytes. Call once per network tick.
+    //
+    //   now = SDL_GetTicksNS()
+    //
+    //   Returns NET_OK on success.
+    //   Returns int code on error.
+    //=============================================================================
+    int update(Uint64 now);
+
+    //=============================================================================
+    // Process a datagram received from the remote end
+    //
+    //   ticks = Receive time, NET_PACKET::ticks
+    //
+    //   Returns false if the packet is malformed.
+    //=============================================================================
+    bool processPacket(const char* data, int size, Uint64 ticks);
+
+    //=============================================================================
+    // Return the next received message. message stays valid until the next
+    // call to receive() or processPacket().
+    // Returns false if there are none.
+    //=============================================================================
+    bool receive(int& channel, const char*& message, int& size);
+
+    // Return the smoothed round trip time in milliseconds
+    float getRTT() const;
+
+    // Return the number of packets sent
+    Uint32 getPacketsSent() const;
+
+    // Return the number of reliable messages sent again
+    Uint32 getMessagesResent() const;
+};
@@ -0,0 +1,642 @@
+#include <SDL3\SDL_intrin.h>
+#include "pixelConvert.h"
+
+//=============================================================================
+// Scalar kernels
+// Reference versions, also used for the pixels left over by the SIMD kernels.
+//=============================================================================
+
+static void LuminanceToRGB_C(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i*3+0] = src[i];
+        dst[i*3+1] = src[i];
+        dst[i*3+2] = src[i];
+    }
+}
+
+static void LuminanceToRGBA_C(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i*4+0] = src[i];
+        dst[i*4+1] = src[i];
+        dst[i*4+2] = src[i];
+        dst[i*4+3] = 0xFF;
+    }
+}
+
+static void LuminanceAlphaToRGBA_C(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i*4+0] = src[i*2+0];
+        dst[i*4+1] = src[i*2+0];
+        dst[i*4+2] = src[i*2+0];
+        dst[i*4+3] = src[i*2+1];
+    }
+}
+
+static void RGBToRGBA_C(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i*4+0] = src[i*3+0];
+        dst[i*4+1] = src[i*3+1];
+        dst[i*4+2] = src[i*3+2];
+        dst[i*4+3] = 0xFF;
+    }
+}
+
+static void SwapRB24_C(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t r = src[i*3+0];
+        dst[i*3+0] = src[i*3+2];
+        dst[i*3+1] = src[i*3+1];
+        dst[i*3+2] = r;
+    }
+}
+
+static void SwapRB32_C(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t r = src[i*4+0];
+        dst[i*4+0] = src[i*4+2];
+        dst[i*4+1] = src[i*4+1];
+        dst[i*4+2] = r;
+        dst[i*4+3] = src[i*4+3];
+    }
+}
+
+static void ColorKey_C(uint32_t* pixels, size_t count, uint32_t key, uint32_t mask)
+{
+    key &= mask;
+    for (size_t i = 0; i < count; i++) {
+        if ((pixels[i] & mask) == key) {
+            pixels[i] = 0;
+        }
+    }
+}
+
+// c * a / 255 rounded, exact for all 8-bit c and a
+static inline uint8_t MulDiv255(uint32_t c, uint32_t a)
+{
+    const uint32_t t = c * a + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+static void PremultiplyAlpha_C(uint8_t* pixels, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t a = pixels[i*4+3];
+        pixels[i*4+0] = MulDiv255(pixels[i*4+0], a);
+        pixels[i*4+1] = MulDiv255(pixels[i*4+1], a);
+        pixels[i*4+2] = MulDiv255(pixels[i*4+2], a);
+    }
+}
+
+//=============================================================================
+// SSE2 kernels
+// SSE2 has no byte shuffle, so only the 32-bit formats have SSE2 kernels.
+// Kernels return the number of pixels converted.
+//=============================================================================
+#if defined(SDL_SSE2_INTRINSICS)
+
+static size_t LuminanceToRGBA_SSE2(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i l = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(l, l);
+        const __m128i hi = _mm_unpackhi_epi8(l, l);
+        __m128i* out = (__m128i*)(dst + i*4);
+        _mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+        _mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+        _mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+    }
+    return i;
+}
+
+static size_t LuminanceAlphaToRGBA_SSE2(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    // doubling the bytes gives L L A A, copy L over byte 2
+    const __m128i keep = _mm_set1_epi32((int)0xFF00FFFF);
+    const __m128i blue = _mm_set1_epi32(0x00FF0000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i la = _mm_loadu_si128((const __m128i*)(src + i*2));
+        __m128i lo = _mm_unpacklo_epi8(la, la);
+        __m128i hi = _mm_unpackhi_epi8(la, la);
+        lo = _mm_or_si128(_mm_and_si128(lo, keep),
+            _mm_and_si128(_mm_slli_epi32(lo, 16), blue));
+        hi = _mm_or_si128(_mm_and_si128(hi, keep),
+            _mm_and_si128(_mm_slli_epi32(hi, 16), blue));
+        _mm_storeu_si128((__m128i*)(dst + i*4) + 0, lo);
+        _mm_storeu_si128((__m128i*)(dst + i*4) + 1, hi);
+    }
+    return i;
+}
+
+static size_t SwapRB32_SSE2(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    const __m128i ag = _mm_set1_epi32((int)0xFF00FF00);
+    const __m128i rb = _mm_set1_epi32(0x00FF00FF);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(src + i*4));
+        const __m128i c = _mm_and_si128(x, rb);
+        const __m128i s = _mm_or_si128(_mm_slli_epi32(c, 16), _mm_srli_epi32(c, 16));
+        _mm_storeu_si128((__m128i*)(dst + i*4), _mm_or_si128(_mm_and_si128(x, ag), s));
+    }
+    return i;
+}
+
+static size_t ColorKey_SSE2(uint32_t* pixels, size_t count, uint32_t key, uint32_t mask)
+{
+    const __m128i m = _mm_set1_epi32((int)mask);
+    const __m128i k = _mm_set1_epi32((int)(key & mask));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(pixels + i));
+        const __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(x, m), k);
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_andnot_si128(eq, x));
+    }
+    return i;
+}
+
+// premultiply two pixels held as 16-bit channels
+static inline __m128i Premultiply2_SSE2(__m128i v)
+{
+    const __m128i keep = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i half = _mm_set1_epi16(128);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF);
+    a = _mm_or_si128(_mm_and_si128(a, keep), one);          // alpha * 255
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(v, a), half);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static size_t PremultiplyAlpha_SSE2(uint8_t* pixels, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(pixels + i*4));
+        const __m128i lo = Premultiply2_SSE2(_mm_unpacklo_epi8(x, zero));
+        const __m128i hi = Premultiply2_SSE2(_mm_unpackhi_epi8(x, zero));
+        _mm_storeu_si128((__m128i*)(pixels + i*4), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+#endif
+
+//=============================================================================
+// AVX2 kernels
+// Selected at run time. The 24-bit kernels use 128-bit byte shuffles, which
+// are always present on AVX2 hardware.
+//=============================================================================
+#if defined(SDL_AVX2_INTRINSICS)
+
+static bool HasAVX2()
+{
+    static const bool hasAVX2 = SDL_HasAVX2();
+    return hasAVX2;
+}
+
+SDL_TARGETING("avx2") static size_t LuminanceToRGB_AVX2(const uint8_t* src,
+    uint8_t* dst, size_t count)
+{
+    const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14,
+        14, 15, 15, 15);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i l = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i* out = (__m128i*)(dst + i*3);
+        _mm_storeu_si128(out + 0, _mm_shuffle_epi8(l, m0));
+        _mm_storeu_si128(out + 1, _mm_shuffle_epi8(l, m1));
+        _mm_storeu_si128(out + 2, _mm_shuffle_epi8(l, m2));
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static size_t LuminanceToRGBA_AVX2(const uint8_t* src,
+    uint8_t* dst, size_t count)
+{
+    const __m256i grey = _mm256_set1_epi32(0x00010101);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i l = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        const __m256i x = _mm256_or_si256(_mm256_mullo_epi32(l, grey), alpha);
+        _mm256_storeu_si256((__m256i*)(dst + i*4), x);
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static size_t LuminanceAlphaToRGBA_AVX2(const uint8_t* src,
+    uint8_t* dst, size_t count)
+{
+    const __m256i grey = _mm256_set1_epi32(0x00010101);
+    const __m256i lum = _mm256_set1_epi32(0x000000FF);
+    const __m256i alpha = _mm256_set1_epi32(0x0000FF00);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i la = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i*2)));
+        const __m256i l = _mm256_mullo_epi32(_mm256_and_si256(la, lum), grey);
+        const __m256i a = _mm256_slli_epi32(_mm256_and_si256(la, alpha), 16);
+        _mm256_storeu_si256((__m256i*)(dst + i*4), _mm256_or_si256(l, a));
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static size_t RGBToRGBA_AVX2(const uint8_t* src,
+    uint8_t* dst, size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    size_t i = 0;
+    // each step reads 28 bytes for 8 pixels, stay clear of the end of src
+    for (; i + 10 <= count; i += 8) {
+        const __m128i lo = _mm_loadu_si128((const __m128i*)(src + i*3));
+        const __m128i hi = _mm_loadu_si128((const __m128i*)(src + i*3 + 12));
+        const __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        const __m256i y = _mm256_or_si256(_mm256_shuffle_epi8(x, shuffle), alpha);
+        _mm256_storeu_si256((__m256i*)(dst + i*4), y);
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static size_t SwapRB24_AVX2(const uint8_t* src,
+    uint8_t* dst, size_t count)
+{
+    // 5 pixels per step, byte 15 is copied through unchanged
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9,
+        14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 6 <= count; i += 5) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(src + i*3));
+        _mm_storeu_si128((__m128i*)(dst + i*3), _mm_shuffle_epi8(x, shuffle));
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static size_t SwapRB32_AVX2(const uint8_t* src,
+    uint8_t* dst, size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(src + i*4));
+        _mm256_storeu_si256((__m256i*)(dst + i*4), _mm256_shuffle_epi8(x, shuffle));
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static size_t ColorKey_AVX2(uint32_t* pixels, size_t count,
+    uint32_t key, uint32_t mask)
+{
+    const __m256i m = _mm256_set1_epi32((int)mask);
+    const __m256i k = _mm256_set1_epi32((int)(key & mask));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(pixels + i));
+        const __m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(x, m), k);
+        _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_andnot_si256(eq, x));
+    }
+    return i;
+}
+
+SDL_TARGETING("avx2") static inline __m256i Premultiply4_AVX2(__m256i v)
+{
+    const __m256i keep = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1,
+        0, -1, -1, -1, 0, -1, -1, -1);
+    const __m256i one = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0,
+        255, 0, 0, 0, 255, 0, 0, 0);
+    const __m256i half = _mm256_set1_epi16(128);
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xFF), 0xFF);
+    a = _mm256_or_si256(_mm256_and_si256(a, keep), one);            // alpha * 255
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(v, a), half);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+SDL_TARGETING("avx2") static size_t PremultiplyAlpha_AVX2(uint8_t* pixels,
+    size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(pixels + i*4));
+        const __m256i lo = Premultiply4_AVX2(_mm256_unpacklo_epi8(x, zero));
+        const __m256i hi = Premultiply4_AVX2(_mm256_unpackhi_epi8(x, zero));
+        _mm256_storeu_si256((__m256i*)(pixels + i*4), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+#endif
+
+//=============================================================================
+// NEON kernels
+//=============================================================================
+#if defined(SDL_NEON_INTRINSICS)
+
+static size_t LuminanceToRGB_NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t rgb;
+        rgb.val[0] = rgb.val[1] = rgb.val[2] = vld1q_u8(src + i);
+        vst3q_u8(dst + i*3, rgb);
+    }
+    return i;
+}
+
+static size_t LuminanceToRGBA_NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgba.val[1] = rgba.val[2] = vld1q_u8(src + i);
+        rgba.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + i*4, rgba);
+    }
+    return i;
+}
+
+static size_t LuminanceAlphaToRGBA_NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x2_t la = vld2q_u8(src + i*2);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgba.val[1] = rgba.val[2] = la.val[0];
+        rgba.val[3] = la.val[1];
+        vst4q_u8(dst + i*4, rgba);
+    }
+    return i;
+}
+
+static size_t RGBToRGBA_NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x3_t rgb = vld3q_u8(src + i*3);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgb.val[0];
+        rgba.val[1] = rgb.val[1];
+        rgba.val[2] = rgb.val[2];
+        rgba.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + i*4, rgba);
+    }
+    return i;
+}
+
+static size_t SwapRB24_NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t rgb = vld3q_u8(src + i*3);
+        const uint8x16_t r = rgb.val[0];
+        rgb.val[0] = rgb.val[2];
+        rgb.val[2] = r;
+        vst3q_u8(dst + i*3, rgb);
+    }
+    return i;
+}
+
+static size_t SwapRB32_NEON(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t rgba = vld4q_u8(src + i*4);
+        const uint8x16_t r = rgba.val[0];
+        rgba.val[0] = rgba.val[2];
+        rgba.val[2] = r;
+        vst4q_u8(dst + i*4, rgba);
+    }
+    return i;
+}
+
+static size_t ColorKey_NEON(uint32_t* pixels, size_t count, uint32_t key, uint32_t mask)
+{
+    const uint32x4_t m = vdupq_n_u32(mask);
+    const uint32x4_t k = vdupq_n_u32(key & mask);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t x = vld1q_u32(pixels + i);
+        const uint32x4_t eq = vceqq_u32(vandq_u32(x, m), k);
+        vst1q_u32(pixels + i, vbicq_u32(x, eq));
+    }
+    return i;
+}
+
+// c * a / 255 rounded, same result as MulDiv255
+static inline uint8x8_t MulDiv255_NEON(uint8x8_t c, uint8x8_t a)
+{
+    const uint16x8_t t = vmull_u8(c, a);
+    return vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+}
+
+static size_t PremultiplyAlpha_NEON(uint8_t* pixels, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t rgba = vld4q_u8(pixels + i*4);
+        const uint8x16_t a = rgba.val[3];
+        for (int c = 0; c < 3; c++) {
+            rgba.val[c] = vcombine_u8(
+                MulDiv255_NEON(vget_low_u8(rgba.val[c]), vget_low_u8(a)),
+                MulDiv255_NEON(vget_high_u8(rgba.val[c]), vget_high_u8(a)));
+        }
+        vst4q_u8(pixels + i*4, rgba);
+    }
+    return i;
+}
+
+#endif
+
+//=============================================================================
+// Expand 8-bit luminance to 24-bit RGB.
+//=============================================================================
+void PixelLuminanceToRGB(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = LuminanceToRGB_AVX2(src, dst, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = LuminanceToRGB_NEON(src, dst, count);
+#endif
+    LuminanceToRGB_C(src + i, dst + i*3, count - i);
+}
+
+//=============================================================================
+// Expand 8-bit luminance to 32-bit RGBA.
+//=============================================================================
+void PixelLuminanceToRGBA(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = LuminanceToRGBA_AVX2(src, dst, count);
+    }
+#endif
+#if defined(SDL_SSE2_INTRINSICS)
+    if (i == 0) {
+        i = LuminanceToRGBA_SSE2(src, dst, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = LuminanceToRGBA_NEON(src, dst, count);
+#endif
+    LuminanceToRGBA_C(src + i, dst + i*4, count - i);
+}
+
+//=============================================================================
+// Expand 16-bit luminance alpha to 32-bit RGBA.
+//=============================================================================
+void PixelLuminanceAlphaToRGBA(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = LuminanceAlphaToRGBA_AVX2(src, dst, count);
+    }
+#endif
+#if defined(SDL_SSE2_INTRINSICS)
+    if (i == 0) {
+        i = LuminanceAlphaToRGBA_SSE2(src, dst, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = LuminanceAlphaToRGBA_NEON(src, dst, count);
+#endif
+    LuminanceAlphaToRGBA_C(src + i*2, dst + i*4, count - i);
+}
+
+//=============================================================================
+// Expand 24-bit RGB to 32-bit RGBA.
+//=============================================================================
+void PixelRGBToRGBA(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = RGBToRGBA_AVX2(src, dst, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = RGBToRGBA_NEON(src, dst, count);
+#endif
+    RGBToRGBA_C(src + i*3, dst + i*4, count - i);
+}
+
+//=============================================================================
+// Swap the red and blue channels of 24-bit pixels.
+//=============================================================================
+void PixelSwapRB24(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = SwapRB24_AVX2(src, dst, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = SwapRB24_NEON(src, dst, count);
+#endif
+    SwapRB24_C(src + i*3, dst + i*3, count - i);
+}
+
+//=============================================================================
+// Swap the red and blue channels of 32-bit pixels.
+//=============================================================================
+void PixelSwapRB32(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = SwapRB32_AVX2(src, dst, count);
+    }
+#endif
+#if defined(SDL_SSE2_INTRINSICS)
+    if (i == 0) {
+        i = SwapRB32_SSE2(src, dst, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = SwapRB32_NEON(src, dst, count);
+#endif
+    SwapRB32_C(src + i*4, dst + i*4, count - i);
+}
+
+//=============================================================================
+// Replace pixels matching the colour key with transparent black.
+//=============================================================================
+void PixelColorKey(uint32_t* pixels, size_t count, uint32_t key, uint32_t mask)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = ColorKey_AVX2(pixels, count, key, mask);
+    }
+#endif
+#if defined(SDL_SSE2_INTRINSICS)
+    if (i == 0) {
+        i = ColorKey_SSE2(pixels, count, key, mask);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = ColorKey_NEON(pixels, count, key, mask);
+#endif
+    ColorKey_C(pixels + i, count - i, key, mask);
+}
+
+//=============================================================================
+// Multiply the colour channels of 32-bit pixels by their alpha.
+//=============================================================================
+void PixelPremultiplyAlpha(uint8_t* pixels, size_t count)
+{
+    size_t i = 0;
+#if defined(SDL_AVX2_INTRINSICS)
+    if (HasAVX2()) {
+        i = PremultiplyAlpha_AVX2(pixels, count);
+    }
+#endif
+#if defined(SDL_SSE2_INTRINSICS)
+    if (i == 0) {
+        i = PremultiplyAlpha_SSE2(pixels, count);
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    i = PremultiplyAlpha_NEON(pixels, count);
+#endif
+    PremultiplyAlpha_C(pixels + i*4, count - i);
+}
+
+//=============================================================================
+// Halve the size of a 32-bit image with a 2x2 box filter.
+// An odd last row or column is dropped, a 1 pixel edge is averaged with
+// itself. Rows are visited top down, so the reduced image can be written
+// over the source.
+//=============================================================================
+void PixelBoxFilterHalf32(const uint8_t* src, uint8_t* dst, int width, int height)
+{
+    const int w = (width > 1) ? width >> 1 : 1;
+    const int h = (height > 1) ? height >> 1 : 1;
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row0 = src + (size_t)(y*2) * width * 4;
+        const uint8_t* row1 = src + (size_t)SDL_min(y*2+1, height-1) * width * 4;
+        uint8_t* out = dst + (size_t)y * w * 4;
+        for (int x = 0; x < w; x++) {
+            const int x0 = (x*2) * 4;
+            const int x1 = SDL_min(x*2+1, width-1) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[x*4+c] = (uint8_t)((row0[x0+c] + row0[x1+c] +
+                    row1[x0+c] + row1[x1+c] + 2) >> 2);
+            }
+        }
+    }
+}
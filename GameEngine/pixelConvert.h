@@ -0,0 +1,46 @@
+#pragma once
+#include <SDL3\SDL.h>
+
+//-----------------------------------------------------------------------------
+//
+// PIXEL CONVERSION
+//
+//-----------------------------------------------------------------------------
+
+// Pixel conversion kernels used by texture loading and font atlas generation.
+// Each function picks an AVX2, SSE2 or NEON kernel when the CPU supports it
+// and finishes any remaining pixels with the scalar version.
+// count is the number of pixels, not bytes.
+
+// Expand 8-bit luminance to 24-bit RGB.
+void PixelLuminanceToRGB(const uint8_t* src, uint8_t* dst, size_t count);
+
+// Expand 8-bit luminance to 32-bit RGBA, alpha is set to 255.
+void PixelLuminanceToRGBA(const uint8_t* src, uint8_t* dst, size_t count);
+
+// Expand 16-bit luminance alpha to 32-bit RGBA.
+void PixelLuminanceAlphaToRGBA(const uint8_t* src, uint8_t* dst, size_t count);
+
+// Expand 24-bit RGB to 32-bit RGBA, alpha is set to 255.
+void PixelRGBToRGBA(const uint8_t* src, uint8_t* dst, size_t count);
+
+// Swap the red and blue channels of 24-bit pixels (BGR <-> RGB).
+// src and dst may be the same buffer.
+void PixelSwapRB24(const uint8_t* src, uint8_t* dst, size_t count);
+
+// Swap the red and blue channels of 32-bit pixels (BGRA <-> RGBA).
+// src and dst may be the same buffer.
+void PixelSwapRB32(const uint8_t* src, uint8_t* dst, size_t count);
+
+// Replace every 32-bit pixel where (pixel & mask) == (key & mask) with
+// transparent black.
+void PixelColorKey(uint32_t* pixels, size_t count, uint32_t key, uint32_t mask);
+
+// Multiply the colour channels of 32-bit pixels by their alpha (byte 3).
+void PixelPremultiplyAlpha(uint8_t* pixels, size_t count);
+
+// Halve the size of a 32-bit width x height image with a 2x2 box filter,
+// dst receives (width / 2) x (height / 2) pixels, at least 1 x 1. An odd
+// last row or column is dropped.
+// src and dst may be the same buffer.
+void PixelBoxFilterHalf32(const uint8_t* src, uint8_t* dst, int width, int height);
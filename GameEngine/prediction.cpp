@@ -0,0 +1,317 @@
+#include "prediction.h"
+
+// Shortest way from angle a to b
+static float lerpAngle(float a, float b, float t)
+{
+    float d = b - a;
+
+    if (d > (float)G_PI)
+    {
+        d -= 2.0f * (float)G_PI;
+    }
+    else if (d < -(float)G_PI)
+    {
+        d += 2.0f * (float)G_PI;
+    }
+
+    return a + d * t;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SnapshotBuffer::SnapshotBuffer()
+{
+    buffer = new TIMED_SNAPSHOT[predictionNS::BUFFER_SIZE];
+    delay = predictionNS::INTERPOLATION_DELAY;
+    reset();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SnapshotBuffer::~SnapshotBuffer()
+{
+    delete[] buffer;
+}
+
+//=============================================================================
+// Forget all snapshots
+//=============================================================================
+void SnapshotBuffer::reset()
+{
+    head = 0;
+    count = 0;
+    renderTime = 0.0;
+    started = false;
+}
+
+//=============================================================================
+// Return the snapshot n places after the oldest
+//=============================================================================
+const TIMED_SNAPSHOT& SnapshotBuffer::at(int n) const
+{
+    return buffer[(head + n) % predictionNS::BUFFER_SIZE];
+}
+
+//=============================================================================
+// Add a received snapshot
+//=============================================================================
+void SnapshotBuffer::add(const SNAPSHOT& snapshot, double time)
+{
+    if (count > 0 && time <= at(count - 1).time)
+    {
+        return;         // late, a newer one is already here
+    }
+
+    if (count == predictionNS::BUFFER_SIZE)
+    {
+        head = (head + 1) % predictionNS::BUFFER_SIZE;          // drop the oldest
+        count--;
+    }
+
+    TIMED_SNAPSHOT& slot = buffer[(head + count) % predictionNS::BUFFER_SIZE];
+
+    slot.time = time;
+    slot.snapshot = snapshot;
+    count++;
+}
+
+//=============================================================================
+// Advance the render time
+// The clock runs slightly fast or slow to stay delay behind the newest
+// snapshot, and jumps if it is more than RESYNC off.
+//=============================================================================
+void SnapshotBuffer::update(float frameTime)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    const double target = at(count - 1).time - delay;
+    const double error = target - renderTime;
+
+    if (started == false || SDL_fabs(error) > predictionNS::RESYNC)
+    {
+        renderTime = target;
+        started = true;
+        return;
+    }
+
+    const double scale = SDL_clamp(error * predictionNS::TIME_CORRECTION,
+        -predictionNS::MAX_TIME_SCALE, predictionNS::MAX_TIME_SCALE);
+
+    renderTime += frameTime * (1.0 + scale);
+}
+
+//=============================================================================
+// Set entities between the snapshots around the render time
+//=============================================================================
+void SnapshotBuffer::apply(Entity* const* entities, int entityCount) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // newest snapshot at or before the render time
+    int first = 0;
+
+    while (first + 1 < count && at(first + 1).time <= renderTime)
+    {
+        first++;
+    }
+
+    const TIMED_SNAPSHOT& a = at(first);
+    const bool extrapolate = (first + 1 == count);
+    const TIMED_SNAPSHOT& b = extrapolate ? a : at(first + 1);
+    float t = 0.0f;
+    float ahead = 0.0f;
+
+    if (extrapolate)
+    {
+        ahead = (float)SDL_clamp(renderTime - a.time, 0.0,
+            (double)predictionNS::MAX_EXTRAPOLATION);
+    }
+    else
+    {
+        t = (float)SDL_clamp((renderTime - a.time) / (b.time - a.time), 0.0, 1.0);
+    }
+
+    entityCount = SDL_min(entityCount, a.snapshot.count);
+
+    for (int i = 0; i < entityCount; i++)
+    {
+        ENTITY_VALUES from;
+        ENTITY_VALUES to;
+
+        SnapshotReceiver::unpack(a.snapshot.entities[i], from);
+
+        if (extrapolate)
+        {
+            from.field[snapshotNS::X] += from.field[snapshotNS::VX] * ahead;
+            from.field[snapshotNS::Y] += from.field[snapshotNS::VY] * ahead;
+        }
+        else if (i < b.snapshot.count && a.snapshot.entities[i].active &&
+            b.snapshot.entities[i].active)
+        {
+            SnapshotReceiver::unpack(b.snapshot.entities[i], to);
+
+            const float angle = lerpAngle(from.field[snapshotNS::ANGLE],
+                to.field[snapshotNS::ANGLE], t);
+
+            for (int f = 0; f < snapshotNS::FIELDS; f++)
+            {
+                from.field[f] += (to.field[f] - from.field[f]) * t;
+            }
+
+            from.field[snapshotNS::ANGLE] = angle;          // the short way round
+        }
+
+        SnapshotReceiver::apply(from, entities[i]);
+    }
+}
+
+//=============================================================================
+// Set the interpolation delay in seconds
+//=============================================================================
+void SnapshotBuffer::setDelay(float d)
+{
+    delay = SDL_max(d, 0.0f);
+}
+
+//=============================================================================
+// Return the interpolation delay in seconds
+//=============================================================================
+float SnapshotBuffer::getDelay() const
+{
+    return delay;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+Predictor::Predictor()
+{
+    reset();
+}
+
+//=============================================================================
+// Forget all inputs
+//=============================================================================
+void Predictor::reset()
+{
+    nextSequence = 0;
+    oldest = 0;
+    correction = Vector2(0.0f, 0.0f);
+}
+
+//=============================================================================
+// Move the entity by input now and keep the input
+//=============================================================================
+const PLAYER_INPUT& Predictor::predict(Entity& entity, const PLAYER_INPUT& input)
+{
+    if ((Uint16)(nextSequence - oldest) >= predictionNS::INPUT_HISTORY)
+    {
+        oldest++;           // the server is too far behind, forget the oldest
+    }
+
+    PLAYER_INPUT& saved = inputs[nextSequence % predictionNS::INPUT_HISTORY];
+
+    saved = input;
+    saved.sequence = nextSequence;
+    quantise(saved);            // replay exactly what the server will run
+    nextSequence++;
+
+    step(entity, saved);
+
+    return saved;
+}
+
+//=============================================================================
+// Correct the entity from the server's state and replay newer inputs
+//=============================================================================
+void Predictor::reconcile(Entity& entity, const ENTITY_VALUES& server, Uint16 lastInput)
+{
+    const Uint16 next = lastInput + 1;
+
+    // only inputs that were sent and not confirmed yet
+    if ((Sint16)(next - oldest) < 0 || (Sint16)(nextSequence - next) < 0)
+    {
+        return;
+    }
+
+    const float beforeX = entity.getX();
+    const float beforeY = entity.getY();
+
+    SnapshotReceiver::apply(server, &entity);
+    oldest = next;
+
+    for (Uint16 s = oldest; s != nextSequence; s++)
+    {
+        step(entity, inputs[s % predictionNS::INPUT_HISTORY]);
+    }
+
+    correction.x += beforeX - entity.getX();
+    correction.y += beforeY - entity.getY();
+
+    if (SDL_fabsf(correction.x) > predictionNS::SNAP_DISTANCE ||
+        SDL_fabsf(correction.y) > predictionNS::SNAP_DISTANCE)
+    {
+        correction = Vector2(0.0f, 0.0f);           // too far off, jump
+    }
+}
+
+//=============================================================================
+// Smooth out the correction
+//=============================================================================
+void Predictor::update(float frameTime)
+{
+    const float keep = SDL_max(0.0f, 1.0f - predictionNS::CORRECTION_RATE * frameTime);
+
+    correction.x *= keep;
+    correction.y *= keep;
+}
+
+//=============================================================================
+// Return the offset to draw the entity at
+//=============================================================================
+vector2_t Predictor::getCorrection() const
+{
+    return correction;
+}
+
+//=============================================================================
+// Move an entity by one input
+// Entity::update() applies deltaV, the position is moved here.
+//=============================================================================
+void Predictor::step(Entity& entity, const PLAYER_INPUT& input)
+{
+    const float speed = entity.getSpeed();
+
+    entity.setVelocity(Vector2(input.moveX * speed, input.moveY * speed));
+    entity.setAngle(entity.getAngle() +
+        input.turn * entityNS::ROTATION_RATE * input.frameTime);
+    entity.update(input.frameTime);
+
+    const vector2_t velocity = entity.getVelocity();
+
+    entity.setX(entity.getX() + velocity.x * input.frameTime);
+    entity.setY(entity.getY() + velocity.y * input.frameTime);
+}
+
+//=============================================================================
+// Round input through its wire format
+//=============================================================================
+void Predictor::quantise(PLAYER_INPUT& input)
+{
+    char data[32];
+    PLAYER_INPUT copy = input;
+    const int size = writeMessage(copy, data, sizeof(data));
+
+    if (size > 0)
+    {
+        readMessage(input, data, size);
+    }
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include "net.h"
+#include "snapshot.h"
+#include "bitStream.h"
+
+//-----------------------------------------------------------------------------
+//
+// PREDICTION
+//
+// Client side smoothing of server snapshots. SnapshotBuffer draws remote
+// entities a little in the past, between the two snapshots around the
+// render time. Predictor moves the local player at once from its input and
+// corrects it when the server's state for that input arrives.
+//
+//-----------------------------------------------------------------------------
+
+namespace predictionNS
+{
+    const int BUFFER_SIZE = 32;         // snapshots kept for interpolation
+    const float INTERPOLATION_DELAY = 2.0f * netNS::NET_TIME;           // seconds behind the newest snapshot
+    const float MAX_EXTRAPOLATION = 0.1f;           // seconds past the newest snapshot
+    const float RESYNC = 0.5f;          // seconds off before the clock jumps
+    const float TIME_CORRECTION = 2.0f;         // clock speed-up per second off
+    const float MAX_TIME_SCALE = 0.1f;          // most the clock is sped up or slowed
+    const Uint16 INPUT_HISTORY = 128;           // inputs waiting for the server, power of two
+    const float CORRECTION_RATE = 10.0f;            // error removed per second
+    const float SNAP_DISTANCE = 64.0f;          // pixels, larger errors are not smoothed
+    const float MAX_FRAME_TIME = 0.25f;         // seconds, longest input step
+    const int BUTTON_BITS = 16;
+    const Sint32 AXIS_STEPS = 127;          // per side of 0, so 0 is sent exactly
+}
+
+// Player input for one step, sent to the server and replayed on the client
+typedef struct _PLAYER_INPUT
+{
+    Uint16 sequence;            // set by Predictor::predict()
+    float frameTime;            // seconds
+    float moveX;            // -1 to 1
+    float moveY;            // -1 to 1
+    float turn;         // -1 to 1
+    Uint32 buttons;
+
+    template <typename Stream> bool serialize(Stream& stream)
+    {
+        const float steps = (float)predictionNS::AXIS_STEPS;
+        Uint32 value = sequence;
+        Sint32 axis[3] = { 0, 0, 0 };
+
+        if (Stream::IsWriting)
+        {
+            axis[0] = (Sint32)SDL_roundf(SDL_clamp(moveX, -1.0f, 1.0f) * steps);
+            axis[1] = (Sint32)SDL_roundf(SDL_clamp(moveY, -1.0f, 1.0f) * steps);
+            axis[2] = (Sint32)SDL_roundf(SDL_clamp(turn, -1.0f, 1.0f) * steps);
+        }
+
+        const bool ok = stream.serializeBits(value, 16) &&
+            stream.serializeFloat(frameTime, 0.0f, predictionNS::MAX_FRAME_TIME, 12) &&
+            stream.serializeInt(axis[0], -predictionNS::AXIS_STEPS, predictionNS::AXIS_STEPS) &&
+            stream.serializeInt(axis[1], -predictionNS::AXIS_STEPS, predictionNS::AXIS_STEPS) &&
+            stream.serializeInt(axis[2], -predictionNS::AXIS_STEPS, predictionNS::AXIS_STEPS) &&
+            stream.serializeBits(buttons, predictionNS::BUTTON_BITS);
+
+        sequence = (Uint16)value;
+
+        if (Stream::IsReading)
+        {
+            moveX = axis[0] / steps;
+            moveY = axis[1] / steps;
+            turn = axis[2] / steps;
+        }
+
+        return ok;
+    }
+} PLAYER_INPUT;
+
+typedef struct _TIMED_SNAPSHOT
+{
+    double time;            // server time in seconds
+    SNAPSHOT snapshot;
+} TIMED_SNAPSHOT;
+
+// Interpolation of remote entities
+class SnapshotBuffer
+{
+    // SnapshotBuffer properties
+private:
+    TIMED_SNAPSHOT* buffer;         // BUFFER_SIZE, oldest first from head
+    int     head;
+    int     count;
+    double  renderTime;         // server time being drawn
+    float   delay;
+    bool    started;
+
+    // Return the snapshot n places after the oldest
+    const TIMED_SNAPSHOT& at(int n) const;
+
+    // Not copyable, the buffer is owned
+    SnapshotBuffer(const SnapshotBuffer&);
+    SnapshotBuffer& operator=(const SnapshotBuffer&);
+
+public:
+    // Constructor
+    SnapshotBuffer();
+
+    // Destructor
+    virtual ~SnapshotBuffer();
+
+    //=============================================================================
+    // Add a received snapshot
+    //   time = Server time it was captured, e.g. its tick times NET_TIME.
+    // Snapshots older than the newest are dropped.
+    //=============================================================================
+    void add(const SNAPSHOT& snapshot, double time);
+
+    //=============================================================================
+    // Advance the render time, keeping it delay behind the newest snapshot.
+    // Call once per frame.
+    //=============================================================================
+    void update(float frameTime);
+
+    //=============================================================================
+    // Set entityCount entities between the snapshots around the render time.
+    // Past the newest snapshot entities keep moving for MAX_EXTRAPOLATION.
+    //=============================================================================
+    void apply(Entity* const* entities, int entityCount) const;
+
+    // Set the interpolation delay in seconds
+    void setDelay(float d);
+
+    // Return the interpolation delay in seconds
+    float getDelay() const;
+
+    // Forget all snapshots
+    void reset();
+};
+
+// Prediction of the local player
+class Predictor
+{
+    // Predictor properties
+private:
+    PLAYER_INPUT inputs[predictionNS::INPUT_HISTORY];
+    Uint16  nextSequence;
+    Uint16  oldest;         // oldest input the server hasn't confirmed
+    vector2_t correction;           // error still to be smoothed out
+
+public:
+    // Constructor
+    Predictor();
+
+    //=============================================================================
+    // Move the entity by input now and keep the input for reconcile().
+    // Returns the input with its sequence set, quantised the way the server
+    // will see it. Send it to the server.
+    //=============================================================================
+    const PLAYER_INPUT& predict(Entity& entity, const PLAYER_INPUT& input);
+
+    //=============================================================================
+    // Correct the entity from the server's state after it processed input
+    // lastInput, replaying the inputs the server hasn't seen yet.
+    //=============================================================================
+    void reconcile(Entity& entity, const ENTITY_VALUES& server, Uint16 lastInput);
+
+    //=============================================================================
+    // Smooth out the correction. Call once per frame.
+    //=============================================================================
+    void update(float frameTime);
+
+    // Return the offset to draw the entity at, so corrections don't jump
+    vector2_t getCorrection() const;
+
+    //=============================================================================
+    // Move an entity by one input. The server runs the same step for the
+    // inputs it receives.
+    //=============================================================================
+    static void step(Entity& entity, const PLAYER_INPUT& input);
+
+    // Round input through its wire format
+    static void quantise(PLAYER_INPUT& input);
+
+    // Forget all inputs
+    void reset();
+};
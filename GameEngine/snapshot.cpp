@@ -0,0 +1,372 @@
+#include "snapshot.h"
+#include "bitStream.h"
+
+static const int FIELD_BITS[snapshotNS::FIELDS] = {
+    snapshotNS::POSITION_BITS, snapshotNS::POSITION_BITS,
+    snapshotNS::VELOCITY_BITS, snapshotNS::VELOCITY_BITS,
+    snapshotNS::ANGLE_BITS, snapshotNS::SCALE_BITS
+};
+
+static const int SMALL = 1 << (snapshotNS::SMALL_DELTA_BITS - 1);
+
+static Uint16 quantise(float value, float min, float max, int bits)
+{
+    const float steps = (float)((1 << bits) - 1);
+    const float t = (SDL_clamp(value, min, max) - min) / (max - min);
+
+    return (Uint16)(t * steps + 0.5f);
+}
+
+static float dequantise(Uint16 value, float min, float max, int bits)
+{
+    const float steps = (float)((1 << bits) - 1);
+
+    return min + (max - min) * ((float)value / steps);
+}
+
+// Unchanged: 0. Small change: 1 0 delta. Otherwise: 1 1 value.
+static void writeField(BitWriter& writer, Uint16 value, Uint16 base, int bits)
+{
+    if (value == base)
+    {
+        writer.writeBool(false);
+        return;
+    }
+
+    const int delta = (int)value - (int)base;
+
+    writer.writeBool(true);
+
+    if (delta >= -SMALL && delta < SMALL)
+    {
+        writer.writeBool(false);
+        writer.writeInt(delta, -SMALL, SMALL - 1);
+    }
+    else
+    {
+        writer.writeBool(true);
+        writer.writeBits(value, bits);
+    }
+}
+
+static Uint16 readField(BitReader& reader, Uint16 base, int bits)
+{
+    bool changed = false;
+    bool full = false;
+
+    if (reader.readBool(changed) == false || changed == false)
+    {
+        return base;
+    }
+
+    if (reader.readBool(full) && full == false)
+    {
+        Sint32 delta = 0;
+
+        reader.readInt(delta, -SMALL, SMALL - 1);
+
+        return (Uint16)((int)base + delta);
+    }
+
+    Uint32 value = 0;
+
+    reader.readBits(value, bits);
+
+    return (Uint16)value;
+}
+
+static bool sameState(const ENTITY_STATE& a, const ENTITY_STATE& b)
+{
+    return (a.active == b.active &&
+        SDL_memcmp(a.field, b.field, sizeof(a.field)) == 0);
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SnapshotSender::SnapshotSender()
+{
+    history = new SNAPSHOT[snapshotNS::HISTORY];
+    reset();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SnapshotSender::~SnapshotSender()
+{
+    delete[] history;
+}
+
+//=============================================================================
+// Forget the history
+//=============================================================================
+void SnapshotSender::reset()
+{
+    sequence = 0;
+    baseline = 0;
+    acked = false;
+}
+
+//=============================================================================
+// Quantise entities into snapshot
+//=============================================================================
+void SnapshotSender::capture(Entity* const* entities, int count, SNAPSHOT& snapshot)
+{
+    snapshot.count = SDL_min(count, snapshotNS::MAX_ENTITIES);
+
+    for (int i = 0; i < snapshot.count; i++)
+    {
+        const Entity* entity = entities[i];
+        ENTITY_STATE& state = snapshot.entities[i];
+        const vector2_t velocity = entity->getVelocity();
+        float angle = SDL_fmodf(entity->getAngle(), 2.0f * (float)G_PI);
+
+        if (angle < 0.0f)
+        {
+            angle += 2.0f * (float)G_PI;
+        }
+
+        state.field[snapshotNS::X] = quantise(entity->getX(),
+            snapshotNS::POSITION_MIN, snapshotNS::POSITION_MAX, snapshotNS::POSITION_BITS);
+        state.field[snapshotNS::Y] = quantise(entity->getY(),
+            snapshotNS::POSITION_MIN, snapshotNS::POSITION_MAX, snapshotNS::POSITION_BITS);
+        state.field[snapshotNS::VX] = quantise(velocity.x,
+            snapshotNS::VELOCITY_MIN, snapshotNS::VELOCITY_MAX, snapshotNS::VELOCITY_BITS);
+        state.field[snapshotNS::VY] = quantise(velocity.y,
+            snapshotNS::VELOCITY_MIN, snapshotNS::VELOCITY_MAX, snapshotNS::VELOCITY_BITS);
+        state.field[snapshotNS::ANGLE] = quantise(angle, 0.0f, 2.0f * (float)G_PI,
+            snapshotNS::ANGLE_BITS);
+        state.field[snapshotNS::SCALE] = quantise(entity->getScale(), 0.0f,
+            snapshotNS::SCALE_MAX, snapshotNS::SCALE_BITS);
+        state.active = entity->getActive();
+    }
+}
+
+//=============================================================================
+// Write snapshot as a delta against the acked baseline
+//=============================================================================
+int SnapshotSender::write(SNAPSHOT& snapshot, char* data, int size)
+{
+    static const ENTITY_STATE empty = { { 0 }, false };
+    BitWriter writer(data, size);
+
+    // a baseline older than the history can't be used
+    const bool delta = acked && (Uint16)(sequence - baseline) <= snapshotNS::HISTORY;
+    const SNAPSHOT* base = delta ? &history[baseline % snapshotNS::HISTORY] : NULL;
+
+    snapshot.sequence = sequence;
+
+    writer.writeBits(snapshot.sequence, snapshotNS::SEQUENCE_BITS);
+    writer.writeBool(delta);
+
+    if (delta)
+    {
+        writer.writeBits(baseline, snapshotNS::SEQUENCE_BITS);
+    }
+
+    writer.writeInt(snapshot.count, 0, snapshotNS::MAX_ENTITIES);
+
+    for (int i = 0; i < snapshot.count; i++)
+    {
+        const ENTITY_STATE& state = snapshot.entities[i];
+        const ENTITY_STATE& old = (base != NULL && i < base->count) ?
+            base->entities[i] : empty;
+
+        if (sameState(state, old))
+        {
+            writer.writeBool(false);
+            continue;
+        }
+
+        writer.writeBool(true);
+        writer.writeBool(state.active);
+
+        for (int f = 0; f < snapshotNS::FIELDS; f++)
+        {
+            writeField(writer, state.field[f], old.field[f], FIELD_BITS[f]);
+        }
+    }
+
+    const int bytes = writer.flush();
+
+    if (bytes < 0)
+    {
+        return -1;
+    }
+
+    // overwrites the snapshot HISTORY ago, a baseline that old isn't used
+    history[sequence % snapshotNS::HISTORY] = snapshot;
+    sequence++;
+
+    return bytes;
+}
+
+//=============================================================================
+// Use the snapshot with sequence as the baseline
+//=============================================================================
+void SnapshotSender::ack(Uint16 sequence)
+{
+    // only sequences that were sent, and newer than the baseline
+    if ((Uint16)(this->sequence - sequence) == 0 ||
+        (Uint16)(this->sequence - sequence) > snapshotNS::HISTORY)
+    {
+        return;
+    }
+
+    if (acked == false || (Sint16)(sequence - baseline) > 0)
+    {
+        baseline = sequence;
+        acked = true;
+    }
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SnapshotReceiver::SnapshotReceiver()
+{
+    history = new SNAPSHOT[snapshotNS::HISTORY];
+    valid = new bool[snapshotNS::HISTORY];
+    reset();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SnapshotReceiver::~SnapshotReceiver()
+{
+    delete[] history;
+    delete[] valid;
+}
+
+//=============================================================================
+// Forget the history
+//=============================================================================
+void SnapshotReceiver::reset()
+{
+    for (int i = 0; i < snapshotNS::HISTORY; i++)
+    {
+        valid[i] = false;
+    }
+}
+
+//=============================================================================
+// Decode a snapshot
+//=============================================================================
+bool SnapshotReceiver::read(const char* data, int size, SNAPSHOT& snapshot)
+{
+    static const ENTITY_STATE empty = { { 0 }, false };
+    BitReader reader(data, size);
+    const SNAPSHOT* base = NULL;
+    Uint32 sequence = 0;
+    bool delta = false;
+    Sint32 count = 0;
+
+    reader.readBits(sequence, snapshotNS::SEQUENCE_BITS);
+    reader.readBool(delta);
+
+    if (delta)
+    {
+        Uint32 baseline = 0;
+
+        if (reader.readBits(baseline, snapshotNS::SEQUENCE_BITS) == false ||
+            valid[baseline % snapshotNS::HISTORY] == false ||
+            history[baseline % snapshotNS::HISTORY].sequence != baseline)
+        {
+            return false;           // baseline not received, or gone
+        }
+
+        base = &history[baseline % snapshotNS::HISTORY];
+    }
+
+    if (reader.readInt(count, 0, snapshotNS::MAX_ENTITIES) == false)
+    {
+        return false;
+    }
+
+    snapshot.sequence = (Uint16)sequence;
+    snapshot.count = count;
+
+    for (int i = 0; i < count && reader.getError() == false; i++)
+    {
+        const ENTITY_STATE& old = (base != NULL && i < base->count) ?
+            base->entities[i] : empty;
+        ENTITY_STATE& state = snapshot.entities[i];
+        bool changed = false;
+
+        if (reader.readBool(changed) && changed == false)
+        {
+            state = old;
+            continue;
+        }
+
+        reader.readBool(state.active);
+
+        for (int f = 0; f < snapshotNS::FIELDS; f++)
+        {
+            state.field[f] = readField(reader, old.field[f], FIELD_BITS[f]);
+        }
+    }
+
+    if (reader.getError())
+    {
+        return false;
+    }
+
+    history[sequence % snapshotNS::HISTORY] = snapshot;
+    valid[sequence % snapshotNS::HISTORY] = true;
+
+    return true;
+}
+
+//=============================================================================
+// Dequantise state
+//=============================================================================
+void SnapshotReceiver::unpack(const ENTITY_STATE& state, ENTITY_VALUES& values)
+{
+    values.field[snapshotNS::X] = dequantise(state.field[snapshotNS::X],
+        snapshotNS::POSITION_MIN, snapshotNS::POSITION_MAX, snapshotNS::POSITION_BITS);
+    values.field[snapshotNS::Y] = dequantise(state.field[snapshotNS::Y],
+        snapshotNS::POSITION_MIN, snapshotNS::POSITION_MAX, snapshotNS::POSITION_BITS);
+    values.field[snapshotNS::VX] = dequantise(state.field[snapshotNS::VX],
+        snapshotNS::VELOCITY_MIN, snapshotNS::VELOCITY_MAX, snapshotNS::VELOCITY_BITS);
+    values.field[snapshotNS::VY] = dequantise(state.field[snapshotNS::VY],
+        snapshotNS::VELOCITY_MIN, snapshotNS::VELOCITY_MAX, snapshotNS::VELOCITY_BITS);
+    values.field[snapshotNS::ANGLE] = dequantise(state.field[snapshotNS::ANGLE], 0.0f,
+        2.0f * (float)G_PI, snapshotNS::ANGLE_BITS);
+    values.field[snapshotNS::SCALE] = dequantise(state.field[snapshotNS::SCALE], 0.0f,
+        snapshotNS::SCALE_MAX, snapshotNS::SCALE_BITS);
+    values.active = state.active;
+}
+
+//=============================================================================
+// Set an entity from values
+//=============================================================================
+void SnapshotReceiver::apply(const ENTITY_VALUES& values, Entity* entity)
+{
+    entity->setX(values.field[snapshotNS::X]);
+    entity->setY(values.field[snapshotNS::Y]);
+    entity->setVelocity(Vector2(values.field[snapshotNS::VX],
+        values.field[snapshotNS::VY]));
+    entity->setAngle(values.field[snapshotNS::ANGLE]);
+    entity->setScale(values.field[snapshotNS::SCALE]);
+    entity->setActive(values.active);
+}
+
+//=============================================================================
+// Set entities from snapshot
+//=============================================================================
+void SnapshotReceiver::apply(const SNAPSHOT& snapshot, Entity* const* entities,
+    int count)
+{
+    ENTITY_VALUES values;
+
+    count = SDL_min(count, snapshot.count);
+
+    for (int i = 0; i < count; i++)
+    {
+        unpack(snapshot.entities[i], values);
+        apply(values, entities[i]);
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <SDL3\SDL.h>
+#include "entity.h"
+
+//-----------------------------------------------------------------------------
+//
+// SNAPSHOT
+//
+// Entity state quantised for the network. The server keeps the snapshots it
+// sent to each client and writes the next one as a bit-packed delta against
+// the newest one the client acked. Unchanged entities cost one bit.
+//
+//-----------------------------------------------------------------------------
+
+namespace snapshotNS
+{
+    const int MAX_ENTITIES = 256;
+    const Uint16 HISTORY = 32;          // snapshots kept, power of two
+
+    // Quantised fields
+    enum { X, Y, VX, VY, ANGLE, SCALE, FIELDS };
+
+    const float POSITION_MIN = -8192.0f;            // pixels, 1/4 pixel steps
+    const float POSITION_MAX = 8192.0f;
+    const float VELOCITY_MIN = -2048.0f;            // pixels per second
+    const float VELOCITY_MAX = 2048.0f;
+    const float SCALE_MAX = 8.0f;
+    const int POSITION_BITS = 16;
+    const int VELOCITY_BITS = 16;
+    const int ANGLE_BITS = 12;
+    const int SCALE_BITS = 12;
+    const int SMALL_DELTA_BITS = 7;         // fields that moved less than 64 steps
+    const int SEQUENCE_BITS = 16;
+}
+
+// Quantised state of one Entity
+typedef struct _ENTITY_STATE
+{
+    Uint16 field[snapshotNS::FIELDS];
+    bool active;
+} ENTITY_STATE;
+
+// Entity state in world units
+typedef struct _ENTITY_VALUES
+{
+    float field[snapshotNS::FIELDS];
+    bool active;
+} ENTITY_VALUES;
+
+typedef struct _SNAPSHOT
+{
+    Uint16 sequence;            // set by SnapshotSender::write()
+    int count;
+    ENTITY_STATE entities[snapshotNS::MAX_ENTITIES];
+} SNAPSHOT;
+
+// Server side, one per client
+class SnapshotSender
+{
+    // SnapshotSender properties
+private:
+    SNAPSHOT* history;          // HISTORY snapshots, by sequence
+    Uint16  sequence;           // next sequence
+    Uint16  baseline;           // newest acked
+    bool    acked;          // the client acked a snapshot still in history
+
+    // Not copyable, the history is owned
+    SnapshotSender(const SnapshotSender&);
+    SnapshotSender& operator=(const SnapshotSender&);
+
+public:
+    // Constructor
+    SnapshotSender();
+
+    // Destructor
+    virtual ~SnapshotSender();
+
+    //=============================================================================
+    // Quantise count entities into snapshot
+    //=============================================================================
+    static void capture(Entity* const* entities, int count, SNAPSHOT& snapshot);
+
+    //=============================================================================
+    // Write snapshot as a delta against the acked baseline, or whole if there
+    // is none. snapshot.sequence is set and the snapshot kept for later acks.
+    //
+    //   Returns the number of bytes written, -1 if it doesn't fit in size.
+    //=============================================================================
+    int write(SNAPSHOT& snapshot, char* data, int size);
+
+    //=============================================================================
+    // The client received the snapshot with sequence, use it as the baseline
+    //=============================================================================
+    void ack(Uint16 sequence);
+
+    // Forget the history, the next snapshot is sent whole
+    void reset();
+};
+
+// Client side
+class SnapshotReceiver
+{
+    // SnapshotReceiver properties
+private:
+    SNAPSHOT* history;          // HISTORY snapshots, by sequence
+    bool*   valid;          // history slot holds a decoded snapshot
+
+    // Not copyable, the history is owned
+    SnapshotReceiver(const SnapshotReceiver&);
+    SnapshotReceiver& operator=(const SnapshotReceiver&);
+
+public:
+    // Constructor
+    SnapshotReceiver();
+
+    // Destructor
+    virtual ~SnapshotReceiver();
+
+    //=============================================================================
+    // Decode a snapshot written by SnapshotSender::write(). Send
+    // snapshot.sequence back to the server as the ack.
+    //
+    //   Returns false if data is malformed or its baseline is not known.
+    //=============================================================================
+    bool read(const char* data, int size, SNAPSHOT& snapshot);
+
+    //=============================================================================
+    // Set count entities from snapshot
+    //=============================================================================
+    static void apply(const SNAPSHOT& snapshot, Entity* const* entities, int count);
+
+    // Dequantise state into values
+    static void unpack(const ENTITY_STATE& state, ENTITY_VALUES& values);
+
+    // Set one entity from values
+    static void apply(const ENTITY_VALUES& values, Entity* entity);
+
+    // Forget the history
+    void reset();
+};
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <stdlib.h>
+#include "test.h"
+#include "../bitStream.h"
+
+//-----------------------------------------------------------------------------
+// A message with every field type is written and read back, then every
+// shorter copy of it and every value the writer could not have produced
+// must be rejected by the reader.
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    const int NAME_LENGTH = 15;
+
+    typedef struct _TEST_MESSAGE
+    {
+        Uint32 bits;
+        bool flag;
+        Sint32 small;
+        Sint32 wide;
+        float x;
+        Uint32 count;
+        Sint32 delta;
+        char name[NAME_LENGTH + 1];
+
+        template <typename Stream> bool serialize(Stream& stream)
+        {
+            return stream.serializeBits(bits, 13) &&
+                stream.serializeBool(flag) &&
+                stream.serializeInt(small, -3, 5) &&
+                stream.serializeInt(wide, SDL_MIN_SINT32, SDL_MAX_SINT32) &&
+                stream.serializeFloat(x, -100.0f, 100.0f, 16) &&
+                stream.serializeVarint(count) &&
+                stream.serializeSignedVarint(delta) &&
+                stream.serializeString(name, NAME_LENGTH);
+        }
+    } TEST_MESSAGE;
+
+    TEST_MESSAGE randomMessage()
+    {
+        TEST_MESSAGE message;
+
+        message.bits = rand() & 0x1FFF;
+        message.flag = (rand() & 1) != 0;
+        message.small = rand() % 9 - 3;
+        message.wide = (Sint32)((Uint32)rand() << 17 ^ (Uint32)rand());
+        message.x = (float)(rand() % 20001 - 10000) / 100.0f;
+        message.count = (Uint32)rand() >> (rand() % 31);
+        message.delta = rand() % 2001 - 1000;
+
+        const int length = rand() % (NAME_LENGTH + 1);
+
+        for (int i = 0; i < length; i++)
+        {
+            message.name[i] = (char)('a' + rand() % 26);
+        }
+
+        message.name[length] = '\0';
+
+        return message;
+    }
+
+    bool equal(const TEST_MESSAGE& a, const TEST_MESSAGE& b)
+    {
+        return a.bits == b.bits && a.flag == b.flag && a.small == b.small &&
+            a.wide == b.wide && SDL_fabsf(a.x - b.x) <= 200.0f / 65535.0f &&
+            a.count == b.count && a.delta == b.delta &&
+            strcmp(a.name, b.name) == 0;
+    }
+
+    // Read one varint from bytes
+    bool readVarint(const Uint8* bytes, int size, Uint32& value)
+    {
+        BitReader reader(bytes, size);
+
+        return reader.readVarint(value);
+    }
+}
+
+//=============================================================================
+// Round trip messages and reject malformed ones
+//=============================================================================
+void testBitStream()
+{
+    srand(1);
+
+    Uint8 data[64];
+
+    for (int n = 0; n < 1000; n++)
+    {
+        TEST_MESSAGE sent = randomMessage();
+        TEST_MESSAGE received;
+        const int size = writeMessage(sent, data, sizeof(data));
+
+        CHECK(size > 0);
+        CHECK(readMessage(received, data, size));
+        CHECK(equal(sent, received));
+
+        // the last byte holds at least one bit of the message
+        for (int cut = 0; cut < size; cut++)
+        {
+            CHECK(readMessage(received, data, cut) == false);
+        }
+
+        // too small a buffer to write into
+        CHECK(writeMessage(sent, data, size - 1) == -1);
+    }
+
+    // ints out of their range
+    for (Uint32 raw = 0; raw < 16; raw++)
+    {
+        BitWriter writer(data, sizeof(data));
+        Sint32 value = 0;
+
+        writer.writeBits(raw, bitsRequired(-3, 5));
+        writer.flush();
+
+        BitReader reader(data, sizeof(data));
+
+        CHECK(reader.readInt(value, -3, 5) == (raw <= 8));
+        CHECK(value == ((raw <= 8) ? (Sint32)raw - 3 : 0));
+        CHECK(reader.getError() == (raw > 8));
+    }
+
+    // a string longer than its maximum, both lengths take 5 bits
+    {
+        BitWriter writer(data, sizeof(data));
+        char name[17];
+
+        writer.writeString("abcdefghijklmnopq", 20);
+
+        BitReader reader(data, writer.flush());
+
+        CHECK(reader.readString(name, 16) == false);
+        CHECK(name[0] == '\0');
+    }
+
+    // varints, the longest one that fits in 32 bits and two that don't
+    const Uint8 largest[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+    const Uint8 tooWide[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x10 };
+    const Uint8 tooLong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+    Uint32 value = 0;
+
+    CHECK(readVarint(largest, sizeof(largest), value) && value == 0xFFFFFFFF);
+    CHECK(readVarint(tooWide, sizeof(tooWide), value) == false && value == 0);
+    CHECK(readVarint(tooLong, sizeof(tooLong), value) == false && value == 0);
+    CHECK(readVarint(largest, sizeof(largest) - 1, value) == false);
+
+    // signed varints at the ends of the range
+    const Sint32 extremes[] = { 0, -1, 1, SDL_MIN_SINT32, SDL_MAX_SINT32 };
+
+    for (int i = 0; i < (int)SDL_arraysize(extremes); i++)
+    {
+        BitWriter writer(data, sizeof(data));
+        Sint32 delta = 0;
+
+        writer.writeSignedVarint(extremes[i]);
+
+        BitReader reader(data, writer.flush());
+
+        CHECK(reader.readSignedVarint(delta) && delta == extremes[i]);
+    }
+
+    // a read after an error fails even if data is left
+    {
+        BitReader reader(data, sizeof(data));
+        Sint32 small = 0;
+        bool flag = false;
+
+        data[0] = 0xFF;
+        CHECK(reader.readInt(small, -3, 5) == false);
+        CHECK(reader.getBitsRemaining() > 0);
+        CHECK(reader.readBool(flag) == false);
+    }
+}
@@ -0,0 +1,203 @@
+#include <vector>
+#include "test.h"
+#include "../netLink.h"
+#include "../transport.h"
+
+//-----------------------------------------------------------------------------
+// Client and server in one process over LoopbackTransports, with a
+// SimulatorTransport on each end running on a clock the test moves. The
+// simulator alone must give the same run for the same seed, and a reliable
+// channel through Net must deliver every message once and in order.
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    const unsigned short SENDER_PORT = 40000;
+    const unsigned short RECEIVER_PORT = 40001;
+    const unsigned short SERVER_PORT = 40002;
+    const unsigned short CLIENT_PORT = 40003;
+    const Uint64 TICK = 10000000;           // nanoseconds, 10 ms
+    const int DATAGRAMS = 500;
+    const int MESSAGES = 200;
+    const int MAX_TICKS = 2000;
+    const int CHANNEL_TYPES[] = { netLinkNS::RELIABLE_ORDERED };
+
+    const SIMULATOR_CONFIG CONDITIONS = {
+        50.0f,          // latency
+        20.0f,          // jitter
+        0.1f,           // loss
+        0.05f,          // duplicate
+        0.1f,           // reorder
+    };
+
+    typedef struct _ARRIVAL
+    {
+        int sent;           // tick sent and datagram number
+        int received;           // tick received
+    } ARRIVAL;
+
+    // Send one datagram a tick through a simulator, returns what arrived when
+    std::vector<ARRIVAL> simulate(Uint64 seed, Uint32& dropped, Uint32& duplicated)
+    {
+        LoopbackTransport sender(SENDER_PORT);
+        LoopbackTransport receiver(RECEIVER_PORT);
+        SimulatorTransport simulator(&sender, CONDITIONS, seed);
+        std::vector<ARRIVAL> arrivals;
+        NET_PACKET packet;
+
+        simulator.setTime(0);
+
+        for (int tick = 0; tick < DATAGRAMS + 100; tick++)
+        {
+            if (tick < DATAGRAMS)
+            {
+                simulator.send(NULL, RECEIVER_PORT, &tick, sizeof(tick));
+            }
+
+            simulator.advance(TICK);
+
+            while (receiver.receive(packet) > 0)
+            {
+                ARRIVAL arrival;
+
+                SDL_memcpy(&arrival.sent, packet.data, sizeof(arrival.sent));
+                arrival.received = tick + 1;
+                arrivals.push_back(arrival);
+                SDLNet_UnrefAddress(packet.addr);
+            }
+        }
+
+        dropped = simulator.getDropped();
+        duplicated = simulator.getDuplicated();
+
+        return arrivals;
+    }
+
+    // Let the worker threads send what was queued and take what arrived
+    void settle(LoopbackTransport& a, LoopbackTransport& b)
+    {
+        SDL_Delay(2);
+
+        for (int i = 0; i < 100 && (a.wait(0) > 0 || b.wait(0) > 0); i++)
+        {
+            SDL_Delay(1);
+        }
+
+        SDL_Delay(1);
+    }
+}
+
+//=============================================================================
+// Run the simulator and a client and server over loopback
+//=============================================================================
+void testLoopback()
+{
+    // the same seed gives the same drops, duplicates and delays
+    Uint32 dropped = 0;
+    Uint32 duplicated = 0;
+    Uint32 dropped2 = 0;
+    Uint32 duplicated2 = 0;
+    const std::vector<ARRIVAL> run = simulate(1234, dropped, duplicated);
+    const std::vector<ARRIVAL> again = simulate(1234, dropped2, duplicated2);
+
+    CHECK(dropped == dropped2 && duplicated == duplicated2);
+    CHECK(dropped > 0 && duplicated > 0);
+    CHECK((int)run.size() == DATAGRAMS - (int)dropped + (int)duplicated);
+    CHECK(run.size() == again.size());
+
+    for (size_t i = 0; i < run.size() && i < again.size(); i++)
+    {
+        CHECK(run[i].sent == again[i].sent && run[i].received == again[i].received);
+
+        // no sooner than the latency, no later than latency and 3 jitters
+        const float delay = (run[i].received - run[i].sent) * TICK / 1000000.0f;
+
+        CHECK(delay >= CONDITIONS.latency);
+        CHECK(delay <= CONDITIONS.latency + 3.0f * CONDITIONS.jitter + TICK / 1000000.0f);
+    }
+
+    // a reliable channel from client to server, one message a tick
+    LoopbackTransport serverPort(SERVER_PORT);
+    LoopbackTransport clientPort(CLIENT_PORT);
+    SimulatorTransport serverSimulator(&serverPort, CONDITIONS, 1);
+    SimulatorTransport clientSimulator(&clientPort, CONDITIONS, 2);
+    Net server;
+    Net client;
+    NetLink serverLink;
+    NetLink clientLink;
+    char host[] = "localhost";          // never resolved on a transport
+    bool serverReady = false;
+    int sent = 0;
+    int received = 0;
+    Uint64 now = 0;
+
+    serverSimulator.setTime(now);
+    clientSimulator.setTime(now);
+    server.setTransport(&serverSimulator);
+    client.setTransport(&clientSimulator);
+    CHECK(server.createServer(SERVER_PORT, netNS::UDP) == netNS::NET_OK);
+    CHECK(client.createClient(host, SERVER_PORT, netNS::UDP) == netNS::NET_OK);
+    CHECK(clientLink.initialize(&client, NULL, SERVER_PORT, CHANNEL_TYPES, 1));
+
+    for (int tick = 0; tick < MAX_TICKS && received < MESSAGES; tick++)
+    {
+        if (sent < MESSAGES && clientLink.send(0, &sent, sizeof(sent)))
+        {
+            sent++;
+        }
+
+        CHECK(clientLink.update(now) == netNS::NET_OK);
+
+        if (serverReady)
+        {
+            CHECK(serverLink.update(now) == netNS::NET_OK);
+        }
+
+        settle(serverPort, clientPort);
+        now += TICK;
+        serverSimulator.advance(TICK);
+        clientSimulator.advance(TICK);
+        settle(serverPort, clientPort);
+
+        for (const NET_PACKET* packet = server.receive(); packet != NULL;
+            packet = server.receive())
+        {
+            CHECK(packet->port == CLIENT_PORT);
+
+            // the server's link to the client starts with its first packet
+            if (serverReady == false)
+            {
+                CHECK(serverLink.initialize(&server, packet->addr, packet->port,
+                    CHANNEL_TYPES, 1));
+                serverReady = true;
+            }
+
+            serverLink.processPacket(packet->data, packet->size, packet->ticks);
+        }
+
+        for (const NET_PACKET* packet = client.receive(); packet != NULL;
+            packet = client.receive())
+        {
+            CHECK(packet->port == SERVER_PORT);
+            clientLink.processPacket(packet->data, packet->size, packet->ticks);
+        }
+
+        int channel = -1;
+        const char* message = NULL;
+        int size = 0;
+
+        while (serverLink.receive(channel, message, size))
+        {
+            int number = -1;
+
+            CHECK(channel == 0 && size == sizeof(number));
+            SDL_memcpy(&number, message, sizeof(number));
+            CHECK(number == received);
+            received++;
+        }
+    }
+
+    CHECK(received == MESSAGES);
+    CHECK(clientLink.getMessagesResent() > 0);          // some were lost
+    CHECK(clientLink.getRTT() >= 2.0f * CONDITIONS.latency);
+}
@@ -0,0 +1,27 @@
+#include "test.h"
+
+int testFailures = 0;
+
+//=============================================================================
+// Run every test group
+//=============================================================================
+int main()
+{
+    testPixelConvert();
+    testBitStream();
+    testNetLink();
+    testLoopback();
+    testSnapshot();
+    testPrediction();
+
+    if (testFailures == 0)
+    {
+        printf("All tests passed\n");
+    }
+    else
+    {
+        printf("%d checks failed\n", testFailures);
+    }
+
+    return testFailures;
+}
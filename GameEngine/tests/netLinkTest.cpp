@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include "test.h"
+#include "../netLink.h"
+
+//-----------------------------------------------------------------------------
+// processPacket checks a whole datagram before it uses any of it, so a
+// packet that is cut short or malformed anywhere delivers nothing.
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    const int TYPES[] = { netLinkNS::UNRELIABLE, netLinkNS::SEQUENCED,
+        netLinkNS::RELIABLE_ORDERED };
+    const int CHANNELS = 3;
+
+    void write16(char* p, Uint16 value)
+    {
+        p[0] = (char)(value & 0xFF);
+        p[1] = (char)(value >> 8);
+    }
+
+    // Start a packet, returns its size
+    int writeHeader(char* packet, Uint16 sequence)
+    {
+        write16(&packet[0], sequence);
+        write16(&packet[2], 0);
+        SDL_memset(&packet[4], 0, 4);
+
+        return netLinkNS::PACKET_HEADER;
+    }
+
+    // Add a message, returns the new size
+    int writeMessage(char* packet, int size, int channel, Uint16 id,
+        const char* data, int length)
+    {
+        packet[size] = (char)channel;
+        write16(&packet[size + 1], id);
+        write16(&packet[size + 3], (Uint16)length);
+        SDL_memcpy(&packet[size + netLinkNS::MESSAGE_HEADER], data, length);
+
+        return size + netLinkNS::MESSAGE_HEADER + length;
+    }
+
+    // Take every delivered message, returns how many there were
+    int receiveAll(NetLink& link, char* first = NULL)
+    {
+        int channel = -1;
+        const char* message = NULL;
+        int size = 0;
+        int count = 0;
+
+        while (link.receive(channel, message, size))
+        {
+            CHECK(channel >= 0 && channel < CHANNELS);
+            CHECK(size >= 0 && size <= netLinkNS::MAX_MESSAGE);
+
+            if (count == 0 && first != NULL && size > 0)
+            {
+                *first = message[0];
+            }
+
+            count++;
+        }
+
+        return count;
+    }
+}
+
+//=============================================================================
+// Feed NetLink well formed, cut short and malformed packets
+//=============================================================================
+void testNetLink()
+{
+    Net net;            // never set up, processPacket sends nothing
+    NetLink link;
+    char packet[netLinkNS::MAX_PACKET];
+    Uint16 sequence = 1;
+
+    CHECK(link.processPacket(packet, netLinkNS::PACKET_HEADER, 0) == false);
+    CHECK(link.initialize(&net, NULL, 0, TYPES, CHANNELS));
+    CHECK(link.processPacket(NULL, 0, 0) == false);
+
+    // every cut is rejected unless it falls between messages
+    int size = writeHeader(packet, 0);
+    const int first = writeMessage(packet, size, 0, 0, "one", 3);
+    const int full = writeMessage(packet, first, 2, 0, "two", 3);
+
+    for (int cut = 0; cut <= full; cut++)
+    {
+        const bool boundary = (cut == netLinkNS::PACKET_HEADER || cut == first ||
+            cut == full);
+
+        write16(&packet[0], sequence++);
+        CHECK(link.processPacket(packet, cut, 0) == boundary);
+        CHECK(receiveAll(link) == ((cut == full) ? 2 : (cut == first) ? 1 : 0));
+    }
+
+    // a bad message after a good one, neither is delivered
+    size = writeHeader(packet, sequence++);
+    size = writeMessage(packet, size, 0, 1, "ok", 2);
+    const int good = size;
+    size = writeMessage(packet, size, CHANNELS, 1, "bad", 3);
+    CHECK(link.processPacket(packet, size, 0) == false);
+    CHECK(receiveAll(link) == 0);
+
+    // a message longer than MAX_MESSAGE
+    char big[netLinkNS::MAX_MESSAGE + 1] = { 0 };
+    size = writeMessage(packet, good, 0, 2, big, sizeof(big));
+    CHECK(link.processPacket(packet, size, 0) == false);
+    CHECK(receiveAll(link) == 0);
+
+    // a duplicate packet is accepted once
+    size = writeHeader(packet, sequence++);
+    size = writeMessage(packet, size, 0, 3, "dup", 3);
+    CHECK(link.processPacket(packet, size, 0));
+    CHECK(receiveAll(link) == 1);
+    CHECK(link.processPacket(packet, size, 0));
+    CHECK(receiveAll(link) == 0);
+
+    // reliable messages are delivered in order, older sequenced ones dropped
+    char c = 0;
+    size = writeHeader(packet, sequence++);
+    size = writeMessage(packet, size, 2, 2, "c", 1);
+    size = writeMessage(packet, size, 1, 9, "x", 1);
+    CHECK(link.processPacket(packet, size, 0));
+    CHECK(receiveAll(link, &c) == 1 && c == 'x');
+
+    size = writeHeader(packet, sequence++);
+    size = writeMessage(packet, size, 2, 1, "b", 1);
+    size = writeMessage(packet, size, 1, 8, "y", 1);
+    CHECK(link.processPacket(packet, size, 0));
+    CHECK(receiveAll(link, &c) == 2 && c == 'b');
+
+    // random bytes never deliver anything out of range
+    srand(1);
+
+    for (int n = 0; n < 10000; n++)
+    {
+        size = rand() % 64;
+
+        for (int i = 0; i < size; i++)
+        {
+            packet[i] = (char)(rand() & 0xFF);
+        }
+
+        if (size > netLinkNS::PACKET_HEADER && (n & 1))
+        {
+            packet[netLinkNS::PACKET_HEADER] &= 0x03;           // channel in range more often
+            packet[netLinkNS::PACKET_HEADER + 4] = 0;
+        }
+
+        link.processPacket(packet, size, 0);
+        receiveAll(link);
+    }
+}
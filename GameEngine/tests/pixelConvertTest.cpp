@@ -0,0 +1,261 @@
+#include <vector>
+#include <stdlib.h>
+#include "test.h"
+#include "../pixelConvert.h"
+
+//-----------------------------------------------------------------------------
+// The public functions run the SIMD kernel for the CPU and finish the tail
+// with the scalar loop. They are compared against the scalar versions below
+// for every count up to MAX_COUNT, which covers each kernel's block size
+// and every tail its loop guard leaves behind (RGBToRGBA stops 2 pixels
+// short of the end, SwapRB24 1 pixel short).
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    const size_t MAX_COUNT = 100;
+    const size_t GUARD = 64;            // bytes past the output that must not change
+    const uint8_t FILL = 0xCD;
+
+    void luminanceToRGB(const uint8_t* src, uint8_t* dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[i*3+0] = dst[i*3+1] = dst[i*3+2] = src[i];
+        }
+    }
+
+    void luminanceToRGBA(const uint8_t* src, uint8_t* dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[i*4+0] = dst[i*4+1] = dst[i*4+2] = src[i];
+            dst[i*4+3] = 0xFF;
+        }
+    }
+
+    void luminanceAlphaToRGBA(const uint8_t* src, uint8_t* dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[i*4+0] = dst[i*4+1] = dst[i*4+2] = src[i*2+0];
+            dst[i*4+3] = src[i*2+1];
+        }
+    }
+
+    void rgbToRGBA(const uint8_t* src, uint8_t* dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[i*4+0] = src[i*3+0];
+            dst[i*4+1] = src[i*3+1];
+            dst[i*4+2] = src[i*3+2];
+            dst[i*4+3] = 0xFF;
+        }
+    }
+
+    void swapRB(const uint8_t* src, uint8_t* dst, size_t count, int bytes)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t r = src[i*bytes+0];
+
+            for (int c = 1; c < bytes; c++)
+            {
+                dst[i*bytes+c] = src[i*bytes+c];
+            }
+
+            dst[i*bytes+0] = src[i*bytes+2];
+            dst[i*bytes+2] = r;
+        }
+    }
+
+    void colorKey(uint32_t* pixels, size_t count, uint32_t key, uint32_t mask)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if ((pixels[i] & mask) == (key & mask))
+            {
+                pixels[i] = 0;
+            }
+        }
+    }
+
+    void premultiplyAlpha(uint8_t* pixels, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t a = pixels[i*4+3];
+
+            for (int c = 0; c < 3; c++)
+            {
+                // round to nearest, ties can't happen for x / 255
+                pixels[i*4+c] = (uint8_t)((pixels[i*4+c] * a * 2 + 255) / 510);
+            }
+        }
+    }
+
+    std::vector<uint8_t> randomBytes(size_t size)
+    {
+        std::vector<uint8_t> bytes(size);
+
+        for (size_t i = 0; i < size; i++)
+        {
+            bytes[i] = (uint8_t)(rand() & 0xFF);
+        }
+
+        return bytes;
+    }
+
+    // 2x2 box filter, a 1 pixel edge uses its only row or column twice
+    void boxFilterHalf(const uint8_t* src, uint8_t* dst, int width, int height)
+    {
+        const int w = (width > 1) ? width / 2 : 1;
+        const int h = (height > 1) ? height / 2 : 1;
+
+        for (int y = 0; y < h; y++)
+        {
+            const int y0 = y * 2;
+            const int y1 = (height > 1) ? y0 + 1 : y0;
+
+            for (int x = 0; x < w; x++)
+            {
+                const int x0 = x * 2;
+                const int x1 = (width > 1) ? x0 + 1 : x0;
+
+                for (int c = 0; c < 4; c++)
+                {
+                    const int sum = src[(y0 * width + x0) * 4 + c] +
+                        src[(y0 * width + x1) * 4 + c] +
+                        src[(y1 * width + x0) * 4 + c] +
+                        src[(y1 * width + x1) * 4 + c];
+
+                    dst[(y * w + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    typedef void (*CONVERT)(const uint8_t* src, uint8_t* dst, size_t count);
+
+    // Compare a conversion from srcBytes to dstBytes per pixel
+    void compare(CONVERT simd, CONVERT scalar, int srcBytes, int dstBytes)
+    {
+        for (size_t count = 0; count <= MAX_COUNT; count++)
+        {
+            const std::vector<uint8_t> src = randomBytes(count * srcBytes + GUARD);
+            std::vector<uint8_t> expected(count * dstBytes + GUARD, FILL);
+            std::vector<uint8_t> actual(count * dstBytes + GUARD, FILL);
+
+            scalar(src.data(), expected.data(), count);
+            simd(src.data(), actual.data(), count);
+            CHECK(actual == expected);
+        }
+    }
+
+    void swapRB24(const uint8_t* src, uint8_t* dst, size_t count)
+    {
+        swapRB(src, dst, count, 3);
+    }
+
+    void swapRB32(const uint8_t* src, uint8_t* dst, size_t count)
+    {
+        swapRB(src, dst, count, 4);
+    }
+
+    // Swaps may run in place
+    void compareInPlace(CONVERT simd, CONVERT scalar, int bytes)
+    {
+        for (size_t count = 0; count <= MAX_COUNT; count++)
+        {
+            std::vector<uint8_t> expected = randomBytes(count * bytes + GUARD);
+            std::vector<uint8_t> actual = expected;
+
+            scalar(expected.data(), expected.data(), count);
+            simd(actual.data(), actual.data(), count);
+            CHECK(actual == expected);
+        }
+    }
+}
+
+//=============================================================================
+// Compare every SIMD kernel with its scalar version
+//=============================================================================
+void testPixelConvert()
+{
+    srand(1);
+
+    compare(PixelLuminanceToRGB, luminanceToRGB, 1, 3);
+    compare(PixelLuminanceToRGBA, luminanceToRGBA, 1, 4);
+    compare(PixelLuminanceAlphaToRGBA, luminanceAlphaToRGBA, 2, 4);
+    compare(PixelRGBToRGBA, rgbToRGBA, 3, 4);
+    compare(PixelSwapRB24, swapRB24, 3, 3);
+    compare(PixelSwapRB32, swapRB32, 4, 4);
+    compareInPlace(PixelSwapRB24, swapRB24, 3);
+    compareInPlace(PixelSwapRB32, swapRB32, 4);
+
+    // colour key, with about half the pixels matching
+    const uint32_t key = 0x00FF00FF;
+    const uint32_t mask = 0x00FFFFFF;
+
+    for (size_t count = 0; count <= MAX_COUNT; count++)
+    {
+        std::vector<uint32_t> expected(count + GUARD);
+
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            expected[i] = (rand() & 1) ? (key | ((uint32_t)rand() << 24)) :
+                ((uint32_t)rand() << 16 ^ (uint32_t)rand());
+        }
+
+        std::vector<uint32_t> actual = expected;
+
+        colorKey(expected.data(), count, key, mask);
+        PixelColorKey(actual.data(), count, key, mask);
+        CHECK(actual == expected);
+    }
+
+    // premultiplied alpha, every colour and alpha pair
+    std::vector<uint8_t> expected(256 * 256 * 4);
+
+    for (size_t i = 0; i < 256 * 256; i++)
+    {
+        expected[i*4+0] = (uint8_t)(i & 0xFF);
+        expected[i*4+1] = (uint8_t)(255 - (i & 0xFF));
+        expected[i*4+2] = (uint8_t)(i * 7);
+        expected[i*4+3] = (uint8_t)(i >> 8);
+    }
+
+    for (size_t count = 0; count <= MAX_COUNT; count++)
+    {
+        std::vector<uint8_t> tail(expected.begin(),
+            expected.begin() + (count + 16) * 4);
+        std::vector<uint8_t> actual = tail;
+
+        premultiplyAlpha(tail.data(), count);
+        PixelPremultiplyAlpha(actual.data(), count);
+        CHECK(actual == tail);
+    }
+
+    std::vector<uint8_t> actual = expected;
+
+    premultiplyAlpha(expected.data(), 256 * 256);
+    PixelPremultiplyAlpha(actual.data(), 256 * 256);
+    CHECK(actual == expected);
+
+    // box filter, odd sizes drop the last row or column, also in place
+    for (int height = 1; height <= 9; height++)
+    {
+        for (int width = 1; width <= 9; width++)
+        {
+            const std::vector<uint8_t> src = randomBytes(width * height * 4);
+            const size_t size = (size_t)SDL_max(width / 2, 1) * SDL_max(height / 2, 1) * 4;
+            std::vector<uint8_t> reduced(size);
+            std::vector<uint8_t> inPlace = src;
+
+            boxFilterHalf(src.data(), reduced.data(), width, height);
+            PixelBoxFilterHalf32(inPlace.data(), inPlace.data(), width, height);
+            CHECK(SDL_memcmp(inPlace.data(), reduced.data(), size) == 0);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "test.h"
+#include "../prediction.h"
+
+//-----------------------------------------------------------------------------
+// Player input must survive its wire format without a drift at rest, and
+// remote entities must turn the short way between two snapshots.
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    SNAPSHOT before, after;
+
+    // Distance between two angles, the short way round
+    float angleDistance(float a, float b)
+    {
+        const float d = SDL_fmodf(SDL_fabsf(a - b), 2.0f * (float)G_PI);
+
+        return SDL_min(d, 2.0f * (float)G_PI - d);
+    }
+
+    // Angle drawn at time t between angle a at time 0 and angle b at time 1
+    float interpolate(float a, float b, float t)
+    {
+        Entity entity;
+        Entity* entities[] = { &entity };
+        SnapshotBuffer buffer;
+
+        entity.setAngle(a);
+        SnapshotSender::capture(entities, 1, before);
+        entity.setAngle(b);
+        SnapshotSender::capture(entities, 1, after);
+
+        buffer.setDelay(1.0f - t);
+        buffer.add(before, 0.0);
+        buffer.add(after, 1.0);
+        buffer.update(0.0f);
+        buffer.apply(entities, 1);
+
+        return entity.getAngle();
+    }
+}
+
+//=============================================================================
+// Round input through the wire and interpolate angles
+//=============================================================================
+void testPrediction()
+{
+    // no input stays exactly none, full input stays full
+    PLAYER_INPUT input = {};
+
+    input.frameTime = 1.0f / 60.0f;
+    Predictor::quantise(input);
+    CHECK(input.moveX == 0.0f && input.moveY == 0.0f && input.turn == 0.0f);
+
+    input.moveX = 1.0f;
+    input.moveY = -1.0f;
+    input.turn = 0.5f;
+    Predictor::quantise(input);
+    CHECK(input.moveX == 1.0f && input.moveY == -1.0f);
+    CHECK(SDL_fabsf(input.turn - 0.5f) <= 0.5f / predictionNS::AXIS_STEPS);
+
+    // an idle player doesn't drift or turn
+    Entity player;
+    Predictor predictor;
+    PLAYER_INPUT idle = {};
+
+    idle.frameTime = 1.0f / 60.0f;
+    player.setX(100.0f);
+    player.setY(200.0f);
+    player.setAngle(1.0f);
+
+    for (int i = 0; i < 600; i++)
+    {
+        predictor.predict(player, idle);
+    }
+
+    CHECK(player.getX() == 100.0f && player.getY() == 200.0f);
+    CHECK(player.getAngle() == 1.0f);
+
+    // every cut of an input is rejected
+    char data[32];
+    const int size = writeMessage(input, data, sizeof(data));
+
+    CHECK(size > 0);
+
+    for (int cut = 0; cut < size; cut++)
+    {
+        PLAYER_INPUT received;
+
+        CHECK(readMessage(received, data, cut) == false);
+    }
+
+    // angles move linearly, and across 0 the short way
+    const float step = 2.0f * (float)G_PI / ((1 << snapshotNS::ANGLE_BITS) - 1);
+
+    CHECK(angleDistance(interpolate(1.0f, 2.0f, 0.25f), 1.25f) <= step);
+    CHECK(angleDistance(interpolate(1.0f, 2.0f, 0.75f), 1.75f) <= step);
+    CHECK(angleDistance(interpolate(6.2f, 0.1f, 0.5f), 0.0084f) <= step);
+    CHECK(angleDistance(interpolate(0.1f, 6.2f, 0.5f), 0.0084f) <= step);
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include "test.h"
+#include "../bitStream.h"
+#include "../snapshot.h"
+
+//-----------------------------------------------------------------------------
+// Snapshots are sent over many ticks with some acks lost, so both whole and
+// delta snapshots are read. Every cut of each one, a delta against a
+// baseline the receiver never had and random bytes must all be rejected
+// without touching the receiver's history.
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    const int ENTITIES = 100;
+    const int TICKS = 40;
+
+    SNAPSHOT sent;
+    SNAPSHOT received;
+
+    // Angle and scale fields are 12 bits, keep every field in range
+    const Uint16 FIELD_MASK = 0x0FFF;
+
+    void randomSnapshot(SNAPSHOT& snapshot, int count)
+    {
+        snapshot.count = count;
+
+        for (int i = 0; i < count; i++)
+        {
+            for (int f = 0; f < snapshotNS::FIELDS; f++)
+            {
+                snapshot.entities[i].field[f] = (Uint16)(rand() & FIELD_MASK);
+            }
+
+            snapshot.entities[i].active = (rand() & 1) != 0;
+        }
+    }
+
+    // Move some entities a little and a few a lot
+    void step(SNAPSHOT& snapshot)
+    {
+        for (int i = 0; i < snapshot.count; i++)
+        {
+            const int f = rand() % snapshotNS::FIELDS;
+
+            switch (rand() % 4)
+            {
+            case 0:
+                break;
+            case 3:
+                snapshot.entities[i].field[f] = (Uint16)(rand() & FIELD_MASK);
+                break;
+            default:
+                snapshot.entities[i].field[f] = (Uint16)((snapshot.entities[i].field[f] +
+                    rand() % 9 - 4) & FIELD_MASK);
+            }
+        }
+    }
+
+    bool sameEntities(const SNAPSHOT& a, const SNAPSHOT& b)
+    {
+        if (a.count != b.count)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < a.count; i++)
+        {
+            if (a.entities[i].active != b.entities[i].active ||
+                SDL_memcmp(a.entities[i].field, b.entities[i].field,
+                sizeof(a.entities[i].field)) != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+//=============================================================================
+// Send snapshots through SnapshotSender and SnapshotReceiver
+//=============================================================================
+void testSnapshot()
+{
+    SnapshotSender sender;
+    SnapshotReceiver receiver;
+    char data[8192];
+    int size = 0;
+
+    srand(1);
+    randomSnapshot(sent, ENTITIES);
+
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+        step(sent);
+        size = sender.write(sent, data, sizeof(data));
+        CHECK(size > 0);
+
+        for (int cut = 0; cut < size; cut++)
+        {
+            CHECK(receiver.read(data, cut, received) == false);
+        }
+
+        CHECK(receiver.read(data, size, received));
+        CHECK(received.sequence == sent.sequence);
+        CHECK(sameEntities(sent, received));
+
+        if (tick % 3 != 2)          // some acks are lost
+        {
+            sender.ack(received.sequence);
+        }
+    }
+
+    // a delta against a baseline this receiver never had
+    SnapshotReceiver fresh;
+
+    step(sent);
+    size = sender.write(sent, data, sizeof(data));
+    CHECK(size > 0);
+    CHECK(fresh.read(data, size, received) == false);
+    CHECK(receiver.read(data, size, received));
+
+    // more entities than a snapshot holds
+    BitWriter writer(data, sizeof(data));
+
+    writer.writeBits(0, snapshotNS::SEQUENCE_BITS);
+    writer.writeBool(false);
+    writer.writeBits(snapshotNS::MAX_ENTITIES + 1, bitsRequired(0, snapshotNS::MAX_ENTITIES));
+
+    for (int i = 0; i <= snapshotNS::MAX_ENTITIES; i++)
+    {
+        writer.writeBool(false);            // unchanged, so only the count is wrong
+    }
+
+    size = writer.flush();
+    CHECK(size > 0);
+    CHECK(fresh.read(data, size, received) == false);
+
+    // too small a buffer to write into
+    CHECK(sender.write(sent, data, 4) == -1);
+
+    // random bytes never give more entities than fit
+    for (int n = 0; n < 10000; n++)
+    {
+        size = rand() % 64;
+
+        for (int i = 0; i < size; i++)
+        {
+            data[i] = (char)(rand() & 0xFF);
+        }
+
+        if (fresh.read(data, size, received))
+        {
+            CHECK(received.count >= 0 && received.count <= snapshotNS::MAX_ENTITIES);
+        }
+    }
+}
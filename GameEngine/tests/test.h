@@ -0,0 +1,32 @@
+#pragma once
+#include <stdio.h>
+
+//-----------------------------------------------------------------------------
+//
+// TESTS
+//
+// Console program built by tests.vcxproj. Each group below checks one engine
+// module without a window or renderer. The program prints every failed check
+// and returns the number of failures, so 0 means everything passed.
+//
+//-----------------------------------------------------------------------------
+
+extern int testFailures;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+// Test groups, one per source file
+void testPixelConvert();
+void testBitStream();
+void testNetLink();
+void testLoopback();
+void testSnapshot();
+void testPrediction();
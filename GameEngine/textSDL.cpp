@@ -41,7 +41,7 @@ bool TextSDL::initialize(Graphics* pGraphics, int height, bool bold,
 
     // create SDL font
     if (Create(graphics, height, bold, italic,
-        DEFAULT_QUALITY, fontName.c_str(), &font) == false)
+        SDF_FONTS ? SDF_QUALITY : DEFAULT_QUALITY, fontName.c_str(), &font) == false)
     {
         return false;
     }
@@ -55,6 +55,14 @@ bool TextSDL::initialize(Graphics* pGraphics, int height, bool bold,
 // Print text inside rectangle using SDL text format
 //=============================================================================
 int TextSDL::print(const std::string& str, rect_t& rect, unsigned int format)
+{
+    return print(str.c_str(), (int)str.length(), rect, format);
+}
+
+//=============================================================================
+// Print count characters inside rectangle using SDL text format
+//=============================================================================
+int TextSDL::print(const char* str, int count, rect_t& rect, unsigned int format)
 {
     if (graphics == NULL)
     {
@@ -66,8 +74,113 @@ int TextSDL::print(const std::string& str, rect_t& rect, unsigned int format)
         Vector2(1.0f, 1.0f), Vector2(), 0.0f, Vector2());
     graphics->setTransform(matrix, TRANSFORMTYPE_TRANSFORM);
 
-    return font->DrawText(graphics, str.c_str(), (int)str.length(),
-        &rect, format, fontColor);
+    return font->DrawText(graphics, str, count, &rect, format, fontColor);
+}
+
+//=============================================================================
+// Measure text inside rectangle using SDL text format
+//=============================================================================
+int TextSDL::measure(const std::string& str, rect_t& rect, unsigned int format)
+{
+    if (graphics == NULL)
+    {
+        return 0;
+    }
+
+    return font->Measure(graphics, str.c_str(), (int)str.length(), &rect,
+        format);
+}
+
+//=============================================================================
+// Print text inside rectangle from a baked texture, re-bake when changed
+//=============================================================================
+int TextSDL::printBaked(BAKED_TEXT& baked, const std::string& str,
+    const rect_t& rect, unsigned int format)
+{
+    if (graphics == NULL)
+    {
+        return 0;
+    }
+
+    const int width = (int)SDL_ceilf(rect.max.x - rect.min.x);
+    const int height = (int)SDL_ceilf(rect.max.y - rect.min.y);
+
+    if (width <= 0 || height <= 0)
+    {
+        return 0;
+    }
+
+    format &= ~CALCRECT;
+
+    // Setup matrix to not rotate text
+    const matrix4_t matrix = Transformation2DMatrix4(Vector2(),
+        Vector2(1.0f, 1.0f), Vector2(), 0.0f, Vector2());
+    graphics->setTransform(matrix, TRANSFORMTYPE_TRANSFORM);
+
+    if (baked.texture != NULL && (baked.width != width || baked.height != height))
+    {
+        releaseBaked(baked);
+    }
+
+    if (baked.texture == NULL)
+    {
+        if (graphics->createRenderTarget(width, height, baked.texture) == false)
+        {
+            return 0;
+        }
+
+        baked.width = width;
+        baked.height = height;
+        baked.str.clear();
+        baked.result = 0;
+        baked.generation = graphics->getTargetGeneration() - 1;         // force bake
+    }
+
+    if (baked.generation != graphics->getTargetGeneration() ||
+        baked.format != format || baked.str != str ||
+        baked.color.r != fontColor.r || baked.color.g != fontColor.g ||
+        baked.color.b != fontColor.b || baked.color.a != fontColor.a)
+    {
+        rect_t textRect = { 0 };
+        textRect.max.x = (float)width;
+        textRect.max.y = (float)height;
+
+        if (graphics->beginRenderTarget(baked.texture) == false)
+        {
+            return 0;
+        }
+
+        baked.result = font->DrawText(graphics, str.c_str(), (int)str.length(),
+            &textRect, format, fontColor);
+        graphics->endRenderTarget();            // back to the caller's target
+
+        baked.str = str;
+        baked.color = fontColor;
+        baked.format = format;
+        baked.generation = graphics->getTargetGeneration();
+    }
+
+    const vector3_t p0 = { rect.min.x, rect.min.y, 1 };
+    const vector3_t p1 = { rect.min.x + width, rect.min.y, 1 };
+    const vector3_t p2 = { rect.min.x + width, rect.min.y + height, 1 };
+    const vector3_t p3 = { rect.min.x, rect.min.y + height, 1 };
+    graphics->batchSprite(baked.texture, NULL, p0, p1, p2, p3, graphicsNS::WHITE);
+
+    return baked.result;
+}
+
+//=============================================================================
+// Release the texture of baked text
+//=============================================================================
+void TextSDL::releaseBaked(BAKED_TEXT& baked)
+{
+    if (graphics != NULL && baked.texture != NULL)
+    {
+        graphics->freeTexture(baked.texture);
+        baked.texture = NULL;
+    }
+
+    baked.str.clear();
 }
 
 //=============================================================================
@@ -123,6 +236,20 @@ COLOR_ARGB TextSDL::getFontColor() const
     return fontColor;
 }
 
+//=============================================================================
+// Returns the layout cache hit and miss counts
+//=============================================================================
+void TextSDL::getLayoutStats(unsigned long& hits, unsigned long& misses) const
+{
+    hits = 0;
+    misses = 0;
+
+    if (font != NULL)
+    {
+        font->GetLayoutStats(&hits, &misses);
+    }
+}
+
 //=============================================================================
 // Set rotation angle in degrees.
 //=============================================================================
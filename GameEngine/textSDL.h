@@ -3,6 +3,22 @@
 #include "graphics.h"
 #include "font.h"
 
+// Text drawn once into its own texture, see TextSDL::printBaked()
+typedef struct _BAKED_TEXT
+{
+    LP_TEXTURE texture;         // NULL until first baked
+    std::string str;
+    COLOR_ARGB color;
+    unsigned int format;
+    int width;                  // size of the rect the text was laid out in
+    int height;
+    int result;                 // height of text when baked
+    unsigned int generation;    // Graphics::getTargetGeneration() when baked
+
+    _BAKED_TEXT() : texture(NULL), color(), format(0), width(0), height(0),
+        result(0), generation(0) {}
+} BAKED_TEXT;
+
 class TextSDL
 {
     // SDL Text properties
@@ -37,6 +53,25 @@ public:
     // Return 0 on fail, height of text on success
     int print(const std::string& str, rect_t& rect, unsigned int format);
 
+    // Print count characters of str inside rect using format.
+    // Return 0 on fail, height of text on success
+    int print(const char* str, int count, rect_t& rect, unsigned int format);
+
+    // Size rect to fit str using format, nothing is drawn. The line breaks
+    // are kept for the next print of str at the same width and format.
+    // Return 0 on fail, height of text on success
+    int measure(const std::string& str, rect_t& rect, unsigned int format);
+
+    // Print inside rect using format as one sprite. The text is drawn into
+    // the texture of baked the first time and again only when str, the font
+    // color or the rect size changes. Release with releaseBaked().
+    // Return 0 on fail, height of text on success
+    int printBaked(BAKED_TEXT& baked, const std::string& str,
+        const rect_t& rect, unsigned int format);
+
+    // Release the texture of baked text
+    void releaseBaked(BAKED_TEXT& baked);
+
     // Return rotation angle in degrees.
     float getDegrees() const;
 
@@ -46,6 +81,9 @@ public:
     // Returns font color
     COLOR_ARGB getFontColor() const;
 
+    // Returns the layout cache hit and miss counts
+    void getLayoutStats(unsigned long& hits, unsigned long& misses) const;
+
     // Set rotation angle in degrees.
     // 0 degrees is up. Angles progress clockwise.
     void setDegrees(float deg);
@@ -1,4 +1,10 @@
 #include "textureManager.h"
+#include <algorithm>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 //=============================================================================
 // default constructor
@@ -11,6 +17,13 @@ TextureManager::TextureManager()
     texture.clear();
     fileNames.clear();
     initialized = false;            // set true when successfully initialized
+    watcher = NULL;
+    SDL_SetAtomicInt(&watching, 0);
+    pendingLock = SDL_CreateMutex();
+    pending.clear();
+    reloadReduction = 0;
+    reloadPremultiplied = false;
+    getManagers().push_back(this);
 }
 
 //=============================================================================
@@ -18,6 +31,13 @@ TextureManager::TextureManager()
 //=============================================================================
 TextureManager::~TextureManager()
 {
+    stopHotReload();
+    SDL_DestroyMutex(pendingLock);
+
+    std::vector<TextureManager*>& managers = getManagers();
+    managers.erase(std::remove(managers.begin(), managers.end(), this),
+        managers.end());
+
     for (unsigned int i = 0; i < texture.size(); i++)
         safeReleaseTexture(texture[i]);
 }
@@ -128,16 +148,19 @@ bool TextureManager::initialize(Graphics* pGraphics, std::string file)
     // load texture files
     for (unsigned int i = 0; i < fileNames.size(); i++)
     {
-        bool result = graphics->loadTexture(fileNames[i].c_str(),
-            graphicsNS::TRANSCOLOR, width[i], height[i], texture[i]);
-        if (result == false)
+        if (loadTexture(i) == false)
         {
             success = false;            // at least one texture failed to load
         }
     }
 
     initialized = true;
-    
+
+    if (TEXTURE_HOT_RELOAD)
+    {
+        startHotReload();
+    }
+
     return success;
 }
 
@@ -168,15 +191,22 @@ void TextureManager::onResetDevice()
     // load texture files
     for (unsigned int i = 0; i < fileNames.size(); i++)
     {
-        bool result = graphics->loadTexture(fileNames[i].c_str(),
-            graphicsNS::TRANSCOLOR, width[i], height[i], texture[i]);
-        if (result == false)
+        if (loadTexture(i) == false)
         {
             safeReleaseTexture(texture[i]);
         }
     }
 }
 
+//=============================================================================
+// Load texture n from fileNames[n]
+//=============================================================================
+bool TextureManager::loadTexture(unsigned int n)
+{
+    return graphics->loadTexture(fileNames[n].c_str(), graphicsNS::TRANSCOLOR,
+        width[n], height[n], texture[n]);
+}
+
 //=============================================================================
 // Safely release texture
 //=============================================================================
@@ -188,3 +218,341 @@ void TextureManager::safeReleaseTexture(LP_TEXTURE& ptr)
         ptr = NULL;
     }
 }
+
+//=============================================================================
+// Start watching the texture files for changes
+//=============================================================================
+bool TextureManager::startHotReload()
+{
+    if (!initialized || watcher != NULL)
+    {
+        return false;
+    }
+
+    copyReloadSettings();
+    SDL_SetAtomicInt(&watching, 1);
+
+    watcher = SDL_CreateThread(watchThread, "TextureWatcher", this);
+    if (watcher == NULL)
+    {
+        SDL_SetAtomicInt(&watching, 0);
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Stop watching the texture files, reloads not yet uploaded are dropped
+//=============================================================================
+void TextureManager::stopHotReload()
+{
+    if (watcher == NULL)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&watching, 0);
+    SDL_WaitThread(watcher, NULL);
+    watcher = NULL;
+
+    for (unsigned int i = 0; i < pending.size(); i++)
+    {
+        graphics->freeDecodedImage(pending[i].decoded);
+    }
+
+    pending.clear();
+}
+
+//=============================================================================
+// Swap in textures reloaded since the last call
+// Only textures that changed are uploaded, the rest are left untouched.
+//=============================================================================
+void TextureManager::update()
+{
+    std::vector<PENDING_TEXTURE> ready;
+
+    copyReloadSettings();
+
+    SDL_LockMutex(pendingLock);
+    ready.swap(pending);
+    SDL_UnlockMutex(pendingLock);
+
+    for (unsigned int i = 0; i < ready.size(); i++)
+    {
+        const unsigned int n = ready[i].n;
+        const unsigned int w = ready[i].decoded.width;
+        const unsigned int h = ready[i].decoded.height;
+        LP_TEXTURE reloaded = NULL;
+
+        if (graphics->uploadTexture(ready[i].decoded, SDL_TEXTUREACCESS_STATIC,
+            reloaded) == false)
+        {
+            continue;           // keep the old texture
+        }
+
+        safeReleaseTexture(texture[n]);
+        texture[n] = reloaded;
+        width[n] = w;
+        height[n] = h;
+    }
+}
+
+//=============================================================================
+// Copy the Graphics texture settings for the watcher thread
+// Called on the game thread, which is the only one that changes them.
+//=============================================================================
+void TextureManager::copyReloadSettings()
+{
+    if (graphics == NULL)
+    {
+        return;
+    }
+
+    SDL_LockMutex(pendingLock);
+    reloadReduction = graphics->getTextureReduction();
+    reloadPremultiplied = graphics->getPremultipliedAlpha();
+    SDL_UnlockMutex(pendingLock);
+}
+
+//=============================================================================
+// Return every texture manager
+// A function-local static is built on first use, so texture managers that
+// are globals themselves can register from their constructors.
+//=============================================================================
+std::vector<TextureManager*>& TextureManager::getManagers()
+{
+    static std::vector<TextureManager*> managers;
+
+    return managers;
+}
+
+//=============================================================================
+// Call update() on every texture manager that is hot reloading
+//=============================================================================
+void TextureManager::updateAll()
+{
+    const std::vector<TextureManager*>& managers = getManagers();
+
+    for (unsigned int i = 0; i < managers.size(); i++)
+    {
+        if (managers[i]->watcher != NULL)
+        {
+            managers[i]->update();
+        }
+    }
+}
+
+//=============================================================================
+// Return the bytes used by the textures at full resolution and as loaded
+//=============================================================================
+void TextureManager::getMemoryUsage(size_t& fullBytes, size_t& residentBytes) const
+{
+    fullBytes = 0;
+    residentBytes = 0;
+
+    for (unsigned int i = 0; i < texture.size(); i++)
+    {
+        if (texture[i] == NULL)
+        {
+            continue;
+        }
+
+        const size_t bpp = SDL_BYTESPERPIXEL(texture[i]->format);
+        float w = 0.0f;
+        float h = 0.0f;
+
+        SDL_GetTextureSize(texture[i], &w, &h);
+        fullBytes += (size_t)width[i] * height[i] * bpp;
+        residentBytes += (size_t)w * (size_t)h * bpp;
+    }
+}
+
+//=============================================================================
+// Return the bytes used by every texture manager at full resolution and as
+// loaded, compares full and reduced (low-memory) mode.
+//=============================================================================
+void TextureManager::memoryReport(size_t& fullBytes, size_t& residentBytes)
+{
+    const std::vector<TextureManager*>& managers = getManagers();
+
+    fullBytes = 0;
+    residentBytes = 0;
+
+    for (unsigned int i = 0; i < managers.size(); i++)
+    {
+        size_t full = 0;
+        size_t resident = 0;
+
+        managers[i]->getMemoryUsage(full, resident);
+        fullBytes += full;
+        residentBytes += resident;
+    }
+}
+
+//=============================================================================
+// Decode texture n and queue it for upload at the next frame boundary
+// Called on the watcher thread.
+//=============================================================================
+void TextureManager::queueReload(unsigned int n)
+{
+    PENDING_TEXTURE reload = { 0 };
+
+    reload.n = n;
+
+    // Graphics is owned by the game thread, use the copied settings
+    SDL_LockMutex(pendingLock);
+    const unsigned int reduction = reloadReduction;
+    const bool premultiplied = reloadPremultiplied;
+    SDL_UnlockMutex(pendingLock);
+
+    // the file may still be half written, the next change will retry
+    if (graphics->decodeTexture(fileNames[n].c_str(), graphicsNS::TRANSCOLOR,
+        reload.decoded, reduction, premultiplied) == false)
+    {
+        return;
+    }
+
+    SDL_LockMutex(pendingLock);
+
+    // a newer decode replaces one that was never uploaded
+    for (unsigned int i = 0; i < pending.size(); i++)
+    {
+        if (pending[i].n == n)
+        {
+            graphics->freeDecodedImage(pending[i].decoded);
+            pending.erase(pending.begin() + i);
+            break;
+        }
+    }
+
+    pending.push_back(reload);
+
+    SDL_UnlockMutex(pendingLock);
+}
+
+//=============================================================================
+// Watcher thread entry point
+//=============================================================================
+int SDLCALL TextureManager::watchThread(void* data)
+{
+    TextureManager* textureM = (TextureManager*)data;
+
+#ifdef __linux__
+    textureM->watchNotify();
+#else
+    textureM->watchPoll();
+#endif
+
+    return 0;
+}
+
+//=============================================================================
+// Watch the texture directories with inotify, falls back to polling
+//=============================================================================
+void TextureManager::watchNotify()
+{
+#ifdef __linux__
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        watchPoll();
+        return;
+    }
+
+    std::vector<int> watch(fileNames.size(), -1);           // watch per file
+    std::vector<std::string> baseNames(fileNames.size());
+
+    for (unsigned int i = 0; i < fileNames.size(); i++)
+    {
+        std::string dir = fileNames[i];
+        std::replace(dir.begin(), dir.end(), '\\', '/');
+
+        size_t slash = dir.rfind('/');
+        if (slash == std::string::npos)
+        {
+            baseNames[i] = dir;
+            dir = ".";
+        }
+        else
+        {
+            baseNames[i] = dir.substr(slash + 1);
+            dir.erase(slash);
+        }
+
+        // watching the directory catches editors that save by rename
+        watch[i] = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    }
+
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (SDL_GetAtomicInt(&watching) != 0)
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+
+        if (poll(&pfd, 1, textureManagerNS::POLL_INTERVAL) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const struct inotify_event* event =
+                (const struct inotify_event*)(buffer + offset);
+
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            for (unsigned int i = 0; i < fileNames.size(); i++)
+            {
+                if (watch[i] == event->wd && baseNames[i] == event->name)
+                {
+                    queueReload(i);
+                }
+            }
+        }
+    }
+
+    close(fd);          // also removes the watches
+#else
+    watchPoll();
+#endif
+}
+
+//=============================================================================
+// Watch the texture files by polling their modification time
+//=============================================================================
+void TextureManager::watchPoll()
+{
+    std::vector<SDL_Time> modified(fileNames.size(), 0);
+    SDL_PathInfo info;
+
+    for (unsigned int i = 0; i < fileNames.size(); i++)
+    {
+        if (SDL_GetPathInfo(fileNames[i].c_str(), &info))
+        {
+            modified[i] = info.modify_time;
+        }
+    }
+
+    while (SDL_GetAtomicInt(&watching) != 0)
+    {
+        SDL_Delay(textureManagerNS::POLL_INTERVAL);
+
+        for (unsigned int i = 0; i < fileNames.size(); i++)
+        {
+            if (SDL_GetPathInfo(fileNames[i].c_str(), &info) &&
+                info.modify_time != modified[i])
+            {
+                modified[i] = info.modify_time;
+                queueReload(i);
+            }
+        }
+    }
+}
@@ -4,6 +4,18 @@
 #include "constants.h"
 #include "graphics.h"
 
+namespace textureManagerNS
+{
+    const unsigned int POLL_INTERVAL = 250;     // milliseconds between file checks
+}
+
+// Decoded texture waiting to replace texture n at the next frame boundary
+typedef struct _PENDING_TEXTURE
+{
+    unsigned int n;
+    DECODED_IMAGE decoded;
+} PENDING_TEXTURE;
+
 class TextureManager
 {
     // TextureManager properties
@@ -18,11 +30,36 @@ private:
     std::vector<std::string> fileNames;
     bool initialized;
 
+    // Hot reload
+    SDL_Thread* watcher;                    // watches fileNames for changes
+    SDL_AtomicInt watching;                 // cleared to stop the watcher
+    SDL_Mutex* pendingLock;                 // guards pending and the reload settings
+    std::vector<PENDING_TEXTURE> pending;   // decoded by the watcher, not yet uploaded
+    unsigned int reloadReduction;           // Graphics settings copied for the watcher
+    bool reloadPremultiplied;
+
+    // every texture manager, built on first use so global managers are safe
+    static std::vector<TextureManager*>& getManagers();
+
     // (For internal use only. No user serviceable parts inside.)
 
     // extract characters from stream until end of line
     bool getLine(SDL_IOStream* iostream, std::string& str);
 
+    // load texture n from fileNames[n]
+    bool loadTexture(unsigned int n);
+
+    // copy the Graphics texture settings for the watcher thread
+    void copyReloadSettings();
+
+    // decode texture n on the watcher thread and queue it for upload
+    void queueReload(unsigned int n);
+
+    // watcher thread, uses inotify where available, otherwise polls
+    static int SDLCALL watchThread(void* data);
+    void watchNotify();
+    void watchPoll();
+
 public:
     // Constructor
     TextureManager();
@@ -50,5 +87,25 @@ public:
 
     // Safely release texture
     void safeReleaseTexture(LP_TEXTURE& ptr);
+
+    // Start watching the texture files, changed textures are reloaded.
+    bool startHotReload();
+
+    // Stop watching the texture files.
+    void stopHotReload();
+
+    // Swap in textures reloaded since the last call.
+    // Call between frames, uses the same load path as onResetDevice.
+    void update();
+
+    // Call update() on every texture manager that is hot reloading.
+    static void updateAll();
+
+    // Return the bytes used by the textures at full resolution and as loaded.
+    void getMemoryUsage(size_t& fullBytes, size_t& residentBytes) const;
+
+    // Return the bytes used by all texture managers at full resolution and as
+    // loaded (reduced in low-memory mode).
+    static void memoryReport(size_t& fullBytes, size_t& residentBytes);
 };
 
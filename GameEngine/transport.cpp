@@ -0,0 +1,487 @@
+#include "transport.h"
+
+std::vector<LoopbackTransport*> LoopbackTransport::ports;
+SDL_SpinLock LoopbackTransport::portsLock = 0;
+SDLNet_Address* LoopbackTransport::loopbackAddr = NULL;
+
+//=============================================================================
+// Destructor
+//=============================================================================
+Transport::~Transport()
+{}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SocketTransport::SocketTransport()
+{
+    socket = NULL;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SocketTransport::~SocketTransport()
+{
+    SDLNet_DestroyDatagramSocket(socket);
+}
+
+//=============================================================================
+// Create the socket
+//=============================================================================
+bool SocketTransport::initialize(SDLNet_Address* addr, unsigned short port)
+{
+    socket = SDLNet_CreateDatagramSocket(addr, port);
+
+    return (socket != NULL);
+}
+
+//=============================================================================
+// Send a datagram
+//=============================================================================
+int SocketTransport::send(SDLNet_Address* addr, unsigned short port,
+    const void* data, int size)
+{
+    return SDLNet_SendDatagram(socket, addr, port, data, size);
+}
+
+//=============================================================================
+// Read one datagram
+//=============================================================================
+int SocketTransport::receive(NET_PACKET& packet)
+{
+    SDLNet_Datagram* dgram = NULL;
+
+    if (SDLNet_ReceiveDatagram(socket, &dgram) != 0)
+    {
+        return -1;
+    }
+
+    if (dgram == NULL)
+    {
+        return 0;
+    }
+
+    packet.ticks = SDL_GetTicksNS();
+    packet.addr = SDLNet_RefAddress(dgram->addr);
+    packet.port = dgram->port;
+    packet.size = SDL_min(dgram->buflen, netNS::BUFFER_LENGTH);
+    SDL_memcpy(packet.data, dgram->buf, packet.size);
+
+    SDLNet_DestroyDatagram(dgram);
+
+    return 1;
+}
+
+//=============================================================================
+// Wait for a datagram
+//=============================================================================
+int SocketTransport::wait(Sint32 timeout)
+{
+    return SDLNet_WaitUntilInputAvailable((void**)&socket, 1, timeout);
+}
+
+//=============================================================================
+// Constructor
+// The first loopback port resolves the shared loopback address, so SDL_net
+// is kept initialized while any exist.
+//=============================================================================
+LoopbackTransport::LoopbackTransport(unsigned short port)
+{
+    this->port = port;
+    queue = new NET_PACKET[transportNS::LOOPBACK_QUEUE];
+    head = 0;
+    count = 0;
+    lock = SDL_CreateMutex();
+    arrived = SDL_CreateCondition();
+
+    SDL_LockSpinlock(&portsLock);
+
+    if (ports.empty())
+    {
+        SDLNet_Init();
+        loopbackAddr = SDLNet_ResolveHostname(transportNS::LOOPBACK_IP);
+
+        if (loopbackAddr != NULL)
+        {
+            SDLNet_WaitUntilResolved(loopbackAddr, -1);
+        }
+    }
+
+    ports.push_back(this);
+    SDL_UnlockSpinlock(&portsLock);
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+LoopbackTransport::~LoopbackTransport()
+{
+    SDL_LockSpinlock(&portsLock);
+
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        if (ports[i] == this)
+        {
+            ports.erase(ports.begin() + i);
+            break;
+        }
+    }
+
+    if (ports.empty())
+    {
+        SDLNet_UnrefAddress(loopbackAddr);
+        loopbackAddr = NULL;
+        SDLNet_Quit();
+    }
+
+    SDL_UnlockSpinlock(&portsLock);
+
+    // datagrams nobody read
+    for (int i = 0; i < count; i++)
+    {
+        SDLNet_UnrefAddress(queue[(head + i) % transportNS::LOOPBACK_QUEUE].addr);
+    }
+
+    delete[] queue;
+    SDL_DestroyCondition(arrived);
+    SDL_DestroyMutex(lock);
+}
+
+//=============================================================================
+// Queue a datagram from port from
+//=============================================================================
+bool LoopbackTransport::deliver(unsigned short from, const void* data, int size)
+{
+    SDL_LockMutex(lock);
+
+    if (count == transportNS::LOOPBACK_QUEUE)
+    {
+        SDL_UnlockMutex(lock);
+        return false;
+    }
+
+    NET_PACKET& packet = queue[(head + count) % transportNS::LOOPBACK_QUEUE];
+
+    packet.addr = SDLNet_RefAddress(loopbackAddr);
+    packet.port = from;
+    packet.size = SDL_min(size, netNS::BUFFER_LENGTH);
+    SDL_memcpy(packet.data, data, packet.size);
+    count++;
+
+    SDL_SignalCondition(arrived);
+    SDL_UnlockMutex(lock);
+
+    return true;
+}
+
+//=============================================================================
+// Send a datagram to the loopback transport on port
+// Like UDP, a datagram for a port nobody listens on, or one whose queue is
+// full, is lost without an error.
+//=============================================================================
+int LoopbackTransport::send(SDLNet_Address* addr, unsigned short port,
+    const void* data, int size)
+{
+    SDL_LockSpinlock(&portsLock);
+
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        if (ports[i]->port == port)
+        {
+            ports[i]->deliver(this->port, data, size);
+            break;
+        }
+    }
+
+    SDL_UnlockSpinlock(&portsLock);
+
+    return 0;
+}
+
+//=============================================================================
+// Read one datagram
+//=============================================================================
+int LoopbackTransport::receive(NET_PACKET& packet)
+{
+    SDL_LockMutex(lock);
+
+    if (count == 0)
+    {
+        SDL_UnlockMutex(lock);
+        return 0;
+    }
+
+    const NET_PACKET& queued = queue[head];
+
+    packet.ticks = SDL_GetTicksNS();
+    packet.addr = queued.addr;          // the queue's ref goes to the caller
+    packet.port = queued.port;
+    packet.size = queued.size;
+    SDL_memcpy(packet.data, queued.data, queued.size);
+
+    head = (head + 1) % transportNS::LOOPBACK_QUEUE;
+    count--;
+
+    SDL_UnlockMutex(lock);
+
+    return 1;
+}
+
+//=============================================================================
+// Wait for a datagram
+//=============================================================================
+int LoopbackTransport::wait(Sint32 timeout)
+{
+    SDL_LockMutex(lock);
+
+    if (count == 0 && timeout != 0)
+    {
+        SDL_WaitConditionTimeout(arrived, lock, timeout);
+    }
+
+    const int waiting = count;
+
+    SDL_UnlockMutex(lock);
+
+    return waiting;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SimulatorTransport::SimulatorTransport(Transport* transport,
+    const SIMULATOR_CONFIG& config, Uint64 seed)
+{
+    this->transport = transport;
+    lock = SDL_CreateMutex();
+    time = 0;
+    manualTime = false;
+    setConfig(config, seed);
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SimulatorTransport::~SimulatorTransport()
+{
+    for (size_t i = 0; i < delayed.size(); i++)
+    {
+        SDLNet_UnrefAddress(delayed[i].addr);
+    }
+
+    SDL_DestroyMutex(lock);
+}
+
+//=============================================================================
+// Change the conditions
+//=============================================================================
+void SimulatorTransport::setConfig(const SIMULATOR_CONFIG& config, Uint64 seed)
+{
+    SDL_LockMutex(lock);
+    this->config = config;
+    state = (seed != 0) ? seed : 1;         // xorshift never leaves 0
+    dropped = 0;
+    duplicated = 0;
+    SDL_UnlockMutex(lock);
+}
+
+//=============================================================================
+// Return a random number from 0 to 1 (xorshift64)
+//=============================================================================
+float SimulatorTransport::random()
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return (float)(state >> 40) / (float)(1 << 24);
+}
+
+//=============================================================================
+// Run on the caller's clock, starting at ns
+//=============================================================================
+void SimulatorTransport::setTime(Uint64 ns)
+{
+    SDL_LockMutex(lock);
+    time = ns;
+    manualTime = true;
+    SDL_UnlockMutex(lock);
+
+    flush();
+}
+
+//=============================================================================
+// Move the caller's clock on by ns and send what fell due
+//=============================================================================
+void SimulatorTransport::advance(Uint64 ns)
+{
+    SDL_LockMutex(lock);
+    time += ns;
+    manualTime = true;
+    SDL_UnlockMutex(lock);
+
+    flush();
+}
+
+//=============================================================================
+// Return the simulator time in nanoseconds
+//=============================================================================
+Uint64 SimulatorTransport::now() const
+{
+    return manualTime ? time : SDL_GetTicksNS();
+}
+
+//=============================================================================
+// Delay, drop or duplicate a datagram
+//=============================================================================
+int SimulatorTransport::send(SDLNet_Address* addr, unsigned short port,
+    const void* data, int size)
+{
+    SDL_LockMutex(lock);
+
+    if (random() < config.loss)
+    {
+        dropped++;
+        SDL_UnlockMutex(lock);
+        flush();
+        return 0;           // lost on the way, not an error
+    }
+
+    const int copies = (random() < config.duplicate) ? 2 : 1;
+    const Uint64 sent = now();
+
+    duplicated += copies - 1;
+
+    for (int i = 0; i < copies; i++)
+    {
+        float delay = config.latency + config.jitter * random();
+
+        if (random() < config.reorder)
+        {
+            delay += 2.0f * config.jitter;          // let later datagrams pass it
+        }
+
+        DELAYED_PACKET packet;
+
+        packet.due = sent + (Uint64)(SDL_max(delay, 0.0f) * 1000000.0f);
+        packet.addr = (addr != NULL) ? SDLNet_RefAddress(addr) : NULL;
+        packet.port = port;
+        packet.data.assign((const char*)data, (const char*)data + size);
+        delayed.push_back(packet);
+    }
+
+    SDL_UnlockMutex(lock);
+
+    flush();
+
+    return 0;
+}
+
+//=============================================================================
+// Send the delayed datagrams that are due, in the order they fall due
+//=============================================================================
+void SimulatorTransport::flush()
+{
+    SDL_LockMutex(lock);
+
+    const Uint64 due = now();
+
+    for (;;)
+    {
+        size_t next = delayed.size();
+
+        for (size_t i = 0; i < delayed.size(); i++)
+        {
+            if (delayed[i].due <= due &&
+                (next == delayed.size() || delayed[i].due < delayed[next].due))
+            {
+                next = i;
+            }
+        }
+
+        if (next == delayed.size())
+        {
+            break;
+        }
+
+        DELAYED_PACKET& packet = delayed[next];
+
+        transport->send(packet.addr, packet.port,
+            packet.data.empty() ? NULL : &packet.data[0], (int)packet.data.size());
+        SDLNet_UnrefAddress(packet.addr);
+        delayed.erase(delayed.begin() + next);
+    }
+
+    SDL_UnlockMutex(lock);
+}
+
+//=============================================================================
+// Read one datagram
+//=============================================================================
+int SimulatorTransport::receive(NET_PACKET& packet)
+{
+    flush();
+
+    const int status = transport->receive(packet);
+
+    SDL_LockMutex(lock);
+
+    if (status > 0 && manualTime)
+    {
+        packet.ticks = time;            // on the clock the delays use
+    }
+
+    SDL_UnlockMutex(lock);
+
+    return status;
+}
+
+//=============================================================================
+// Wait for a datagram, no longer than until the next delayed send
+// On the caller's clock nothing falls due while waiting, advance() sends it.
+//=============================================================================
+int SimulatorTransport::wait(Sint32 timeout)
+{
+    flush();
+
+    SDL_LockMutex(lock);
+
+    if (delayed.empty() == false && manualTime == false)
+    {
+        const Uint64 time = now();
+        Uint64 due = delayed[0].due;
+
+        for (size_t i = 1; i < delayed.size(); i++)
+        {
+            due = SDL_min(due, delayed[i].due);
+        }
+
+        const Sint32 untilDue = (due > time) ? (Sint32)((due - time) / 1000000 + 1) : 0;
+
+        if (timeout < 0 || untilDue < timeout)
+        {
+            timeout = untilDue;
+        }
+    }
+
+    SDL_UnlockMutex(lock);
+
+    return transport->wait(timeout);
+}
+
+//=============================================================================
+// Return the number of datagrams dropped
+//=============================================================================
+Uint32 SimulatorTransport::getDropped() const
+{
+    return dropped;
+}
+
+//=============================================================================
+// Return the number of datagrams sent twice
+//=============================================================================
+Uint32 SimulatorTransport::getDuplicated() const
+{
+    return duplicated;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <vector>
+#include <SDL3_net\SDL_net.h>
+#include "net.h"
+
+//-----------------------------------------------------------------------------
+//
+// TRANSPORT
+//
+// Where Net's datagrams go. SocketTransport is the UDP socket,
+// LoopbackTransport delivers to other LoopbackTransports in the same
+// process and SimulatorTransport adds latency, jitter, loss, duplication
+// and reordering to another transport. Give one to Net::setTransport()
+// before createServer() or createClient().
+//
+// Functions return 0 on success and < 0 on error, like SDL_net.
+//
+//-----------------------------------------------------------------------------
+
+namespace transportNS
+{
+    const char LOOPBACK_IP[] = "127.0.0.1";         // sender address of loopback datagrams
+    const int LOOPBACK_QUEUE = 1024;            // datagrams waiting per loopback port
+}
+
+class Transport
+{
+public:
+    virtual ~Transport();
+
+    // Send size bytes to addr and port
+    virtual int send(SDLNet_Address* addr, unsigned short port,
+        const void* data, int size) = 0;
+
+    //=============================================================================
+    // Read one datagram into packet. packet.addr holds a ref for the caller.
+    // Returns 1 if a datagram was read, 0 if none is waiting, < 0 on error.
+    //=============================================================================
+    virtual int receive(NET_PACKET& packet) = 0;
+
+    // Wait up to timeout milliseconds for a datagram. Returns > 0 if one is waiting.
+    virtual int wait(Sint32 timeout) = 0;
+};
+
+// UDP socket
+class SocketTransport : public Transport
+{
+private:
+    SDLNet_DatagramSocket* socket;
+
+public:
+    SocketTransport();
+    virtual ~SocketTransport();
+
+    // Create the socket. Returns false on error.
+    bool initialize(SDLNet_Address* addr, unsigned short port);
+
+    virtual int send(SDLNet_Address* addr, unsigned short port,
+        const void* data, int size);
+    virtual int receive(NET_PACKET& packet);
+    virtual int wait(Sint32 timeout);
+};
+
+// In-process datagrams, addressed by port only
+class LoopbackTransport : public Transport
+{
+private:
+    unsigned short port;
+    NET_PACKET* queue;          // LOOPBACK_QUEUE datagrams sent to this port
+    int     head;
+    int     count;
+    SDL_Mutex* lock;
+    SDL_Condition* arrived;
+
+    static std::vector<LoopbackTransport*> ports;
+    static SDL_SpinLock portsLock;          // a plain int, nothing to create or destroy
+    static SDLNet_Address* loopbackAddr;
+
+    // Queue a datagram from port from. Returns false if the queue is full.
+    bool deliver(unsigned short from, const void* data, int size);
+
+public:
+    // Listen on port
+    LoopbackTransport(unsigned short port);
+    virtual ~LoopbackTransport();
+
+    virtual int send(SDLNet_Address* addr, unsigned short port,
+        const void* data, int size);
+    virtual int receive(NET_PACKET& packet);
+    virtual int wait(Sint32 timeout);
+};
+
+// Network conditions, applied to datagrams as they are sent
+typedef struct _SIMULATOR_CONFIG
+{
+    float latency;          // milliseconds added to every datagram
+    float jitter;           // up to this many milliseconds more, at random
+    float loss;         // 0 to 1, chance a datagram is dropped
+    float duplicate;            // 0 to 1, chance a datagram is sent twice
+    float reorder;          // 0 to 1, chance a datagram is held back by 2 * jitter
+} SIMULATOR_CONFIG;
+
+typedef struct _DELAYED_PACKET
+{
+    Uint64 due;         // simulator time when it is sent
+    SDLNet_Address* addr;
+    unsigned short port;
+    std::vector<char> data;
+} DELAYED_PACKET;
+
+class SimulatorTransport : public Transport
+{
+private:
+    Transport* transport;           // where datagrams go after the delay
+    SIMULATOR_CONFIG config;
+    Uint64  state;          // random number generator
+    std::vector<DELAYED_PACKET> delayed;
+    SDL_Mutex* lock;
+    Uint32  dropped;
+    Uint32  duplicated;
+    Uint64  time;           // nanoseconds, set by setTime() and advance()
+    bool    manualTime;         // false runs on SDL_GetTicksNS()
+
+    // Return a random number from 0 to 1
+    float random();
+
+    // Return the simulator time in nanoseconds, call with lock held
+    Uint64 now() const;
+
+    // Send the delayed datagrams that are due
+    void flush();
+
+public:
+    // Wrap transport, which stays owned by the caller
+    SimulatorTransport(Transport* transport, const SIMULATOR_CONFIG& config,
+        Uint64 seed);
+    virtual ~SimulatorTransport();
+
+    // Change the conditions. The same seed gives the same drops and delays.
+    void setConfig(const SIMULATOR_CONFIG& config, Uint64 seed);
+
+    //=============================================================================
+    // Run on a clock the caller moves instead of SDL_GetTicksNS(), so the
+    // same seed and sends give the same run whenever the threads get to
+    // them. setTime() starts the clock at ns, advance() moves it on and
+    // sends what fell due. Received datagrams are stamped with this time.
+    //=============================================================================
+    void setTime(Uint64 ns);
+    void advance(Uint64 ns);
+
+    // Return the number of datagrams dropped
+    Uint32 getDropped() const;
+
+    // Return the number of datagrams sent twice
+    Uint32 getDuplicated() const;
+
+    virtual int send(SDLNet_Address* addr, unsigned short port,
+        const void* data, int size);
+    virtual int receive(NET_PACKET& packet);
+    virtual int wait(Sint32 timeout);
+};